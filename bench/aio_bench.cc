@@ -0,0 +1,133 @@
+// Random page reads through the synchronous FileHandle path versus the asynchronous backends.
+//
+// usage: aio_bench [--pages N] [--reads N] [--file NAME]
+//
+// Every run starts with a cold buffer pool and with the file evicted from the OS page cache, so the
+// numbers reflect device latency and how many requests each mode keeps in flight.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "src/include/pfm.h"
+#include "src/include/aio.h"
+
+namespace {
+
+    // Small enough that the buffer pool never turns a random read into a hit.
+    const unsigned COLD_POOL_FRAMES = 16;
+
+    void dropOSCache(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    void report(const char *mode, unsigned queueDepth, unsigned reads, double seconds) {
+        printf("%-12s  qd=%-3u  %10.0f IOPS  %8.1f MB/s  %8.1f us/read\n", mode, queueDepth, reads / seconds,
+               reads * (double) PAGE_SIZE / seconds / (1 << 20), seconds * 1e6 / reads);
+    }
+
+    double runSync(PeterDB::FileHandle &fileHandle, const std::vector<PeterDB::PageNum> &pages) {
+        char buffer[PAGE_SIZE];
+        auto start = std::chrono::steady_clock::now();
+        for (PeterDB::PageNum pageNum : pages) {
+            if (fileHandle.readPage(pageNum, buffer) != 0) {
+                fprintf(stderr, "readPage(%u) failed\n", pageNum);
+                exit(1);
+            }
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double runAsync(PeterDB::FileHandle &fileHandle, PeterDB::AsyncIOBackend &backend, unsigned queueDepth,
+                    const std::vector<PeterDB::PageNum> &pages) {
+        PeterDB::AsyncFileIO io(fileHandle, backend);
+        std::vector<char> buffers((size_t) queueDepth * PAGE_SIZE);
+        std::vector<void *> freeBuffers;
+        for (unsigned i = 0; i < queueDepth; i++) {
+            freeBuffers.push_back(&buffers[(size_t) i * PAGE_SIZE]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t next = 0;
+        while (next < pages.size() || io.getPending() > 0) {
+            while (next < pages.size() && !freeBuffers.empty()) {
+                void *buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+                if (io.submitRead(pages[next++], buffer, buffer) != 0) {
+                    fprintf(stderr, "submitRead failed\n");
+                    exit(1);
+                }
+            }
+            PeterDB::PageNum pageNum;
+            void *buffer;
+            if (io.waitForCompletion(pageNum, buffer) != 0) {
+                fprintf(stderr, "read of page %u failed\n", pageNum);
+                exit(1);
+            }
+            freeBuffers.push_back(buffer);
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    unsigned numPages = 16384;
+    unsigned numReads = 8192;
+    std::string fileName = "aio_bench_file";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pages") == 0) numPages = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--reads") == 0) numReads = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--file") == 0) fileName = argv[i + 1];
+    }
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    pfm.destroyFile(fileName);
+    PeterDB::FileHandle fileHandle;
+    if (pfm.createFile(fileName) != 0 || pfm.openFile(fileName, fileHandle) != 0) {
+        fprintf(stderr, "cannot create %s\n", fileName.c_str());
+        return 1;
+    }
+    char page[PAGE_SIZE];
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(page, (int) (i % 251), PAGE_SIZE);
+        fileHandle.appendPage(page);
+    }
+
+    std::mt19937 random(42);
+    std::vector<PeterDB::PageNum> pages(numReads);
+    for (PeterDB::PageNum &pageNum : pages) {
+        pageNum = random() % numPages;
+    }
+
+    printf("%u random reads over %u pages (%.1f MB)\n", numReads, numPages, numPages * (double) PAGE_SIZE / (1 << 20));
+
+    pfm.setBufferPoolSize(COLD_POOL_FRAMES);
+    dropOSCache(fileName);
+    report("sync", 1, numReads, runSync(fileHandle, pages));
+
+    const unsigned queueDepths[] = {1, 8, 32};
+    for (bool allowUring : {true, false}) {
+        for (unsigned queueDepth : queueDepths) {
+            PeterDB::AsyncIOBackend *backend = PeterDB::AsyncIOBackend::create(queueDepth, allowUring);
+            pfm.setBufferPoolSize(COLD_POOL_FRAMES);
+            dropOSCache(fileName);
+            report(backend->getName(), queueDepth, numReads, runAsync(fileHandle, *backend, queueDepth, pages));
+            delete backend;
+        }
+    }
+
+    pfm.closeFile(fileHandle);
+    pfm.destroyFile(fileName);
+    return 0;
+}
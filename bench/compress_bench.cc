@@ -0,0 +1,173 @@
+// Disk footprint and scan throughput of a raw versus a compressed record-based file.
+//
+// usage: compress_bench [--records N] [--file NAME]
+//
+// Both files are loaded with the same employee records (EmpName, Age, Height, Salary), generated the way the
+// rbfm tests build them. Each file is then scanned page by page twice: once with the OS page cache dropped
+// (cold) and once right after (warm), both times through a buffer pool too small to keep the file.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "src/include/rbfm.h"
+
+namespace {
+
+    const unsigned SCAN_POOL_FRAMES = 64;
+
+    void dropOSCache(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    long long fileSize(const std::string &fileName) {
+        struct stat st{};
+        return stat(fileName.c_str(), &st) == 0 ? (long long) st.st_size : -1;
+    }
+
+    std::vector<PeterDB::Attribute> employeeDescriptor() {
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        recordDescriptor.push_back(PeterDB::Attribute{"EmpName", PeterDB::TypeVarChar, 30});
+        recordDescriptor.push_back(PeterDB::Attribute{"Age", PeterDB::TypeInt, 4});
+        recordDescriptor.push_back(PeterDB::Attribute{"Height", PeterDB::TypeReal, 4});
+        recordDescriptor.push_back(PeterDB::Attribute{"Salary", PeterDB::TypeInt, 4});
+        return recordDescriptor;
+    }
+
+    // Null indicator, then the four fields in the rbfm record format.
+    unsigned prepareEmployee(std::mt19937 &random, char *record) {
+        static const char *names[] = {"Anteater", "Bison", "Cheetah", "Dolphin", "Elephant", "Flamingo", "Gazelle",
+                                      "Hippopotamus", "Ibex", "Jaguar"};
+        std::string name = std::string(names[random() % 10]) + std::to_string(random() % 1000);
+        int age = 20 + (int) (random() % 45);
+        float height = 150.0f + (float) (random() % 500) / 10;
+        int salary = 3000 + (int) (random() % 200) * 50;
+
+        unsigned offset = 0;
+        record[offset++] = 0;
+        int length = (int) name.size();
+        memcpy(record + offset, &length, sizeof(int));
+        offset += sizeof(int);
+        memcpy(record + offset, name.data(), name.size());
+        offset += name.size();
+        memcpy(record + offset, &age, sizeof(int));
+        offset += sizeof(int);
+        memcpy(record + offset, &height, sizeof(float));
+        offset += sizeof(float);
+        memcpy(record + offset, &salary, sizeof(int));
+        return offset + sizeof(int);
+    }
+
+    double load(const std::string &fileName, unsigned numRecords) {
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        PeterDB::FileHandle fileHandle;
+        if (rbfm.openFile(fileName, fileHandle) != 0) {
+            fprintf(stderr, "cannot open %s\n", fileName.c_str());
+            exit(1);
+        }
+        std::vector<PeterDB::Attribute> recordDescriptor = employeeDescriptor();
+        std::mt19937 random(42);
+        char record[128];
+        PeterDB::RID rid;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < numRecords; i++) {
+            prepareEmployee(random, record);
+            if (rbfm.insertRecord(fileHandle, recordDescriptor, record, rid) != 0) {
+                fprintf(stderr, "insertRecord failed\n");
+                exit(1);
+            }
+        }
+        fileHandle.flush();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        rbfm.closeFile(fileHandle);
+        return seconds;
+    }
+
+    double scan(const std::string &fileName, unsigned &numPages, unsigned long long &checksum) {
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        PeterDB::FileHandle fileHandle;
+        if (pfm.openFile(fileName, fileHandle) != 0) {
+            fprintf(stderr, "cannot open %s\n", fileName.c_str());
+            exit(1);
+        }
+        numPages = fileHandle.getNumberOfPages();
+        PeterDB::PageGuard guard;
+        auto start = std::chrono::steady_clock::now();
+        for (PeterDB::PageNum pageNum = 0; pageNum < numPages; pageNum++) {
+            if (fileHandle.pinPage(pageNum, guard) != 0) {
+                fprintf(stderr, "pinPage(%u) failed\n", pageNum);
+                exit(1);
+            }
+            for (unsigned i = 0; i < PAGE_SIZE; i += 64) checksum += (unsigned char) guard.data()[i];
+        }
+        guard.release();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        pfm.closeFile(fileHandle);
+        return seconds;
+    }
+
+    void run(const char *mode, const std::string &fileName, unsigned numRecords, long long rawSize) {
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        double loadSeconds = load(fileName, numRecords);
+        long long size = fileSize(fileName);
+        printf("%-10s  load %8.0f rec/s  size %8.1f MB  ratio %5.2f\n", mode, numRecords / loadSeconds,
+               size / (double) (1 << 20), rawSize > 0 ? (double) rawSize / size : 1.0);
+
+        // Evict the file from the file cache and the buffer pool before each scan.
+        for (const char *temperature : {"cold", "warm"}) {
+            pfm.setFileCacheSize(0);
+            pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE);
+            pfm.setBufferPoolSize(SCAN_POOL_FRAMES);
+            if (strcmp(temperature, "cold") == 0) dropOSCache(fileName);
+            unsigned numPages;
+            unsigned long long checksum = 0;
+            double seconds = scan(fileName, numPages, checksum);
+            printf("%-10s  %s scan %8.1f MB/s of pages  %8.1f MB/s from disk  %8.0f pages/s\n", mode, temperature,
+                   numPages * (double) PAGE_SIZE / seconds / (1 << 20), size / seconds / (1 << 20),
+                   numPages / seconds);
+            if (checksum == 0) fprintf(stderr, "%s holds no data\n", fileName.c_str());
+        }
+        pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES);
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    unsigned numRecords = 100000;
+    std::string fileName = "compress_bench_file";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--records") == 0) numRecords = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--file") == 0) fileName = argv[i + 1];
+    }
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+    std::string rawName = fileName + "_raw", compressedName = fileName + "_compressed";
+    pfm.destroyFile(rawName);
+    pfm.destroyFile(compressedName);
+    if (rbfm.createFile(rawName) != 0 || pfm.createCompressedFile(compressedName) != 0) {
+        fprintf(stderr, "cannot create the files\n");
+        return 1;
+    }
+
+    printf("%u employee records\n", numRecords);
+    run("raw", rawName, numRecords, 0);
+    run("compressed", compressedName, numRecords, fileSize(rawName));
+
+    pfm.destroyFile(rawName);
+    pfm.destroyFile(compressedName);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Sequential full-file scans through the buffer pool versus a read-only file mapping.
+//
+// usage: mmap_bench [--pages N] [--file NAME]
+//
+// Each mode scans every page once with the OS page cache dropped (cold) and once more right after (warm).
+// A scan pins each page in turn and sums one word per 64 bytes, the way a record scan touches a page.
+// The default is 1 GB; use --pages 1048576 or more for a multi-GB table.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "src/include/pfm.h"
+
+namespace {
+
+    const unsigned BUILD_BATCH_PAGES = 64;
+
+    void dropOSCache(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    double scan(PeterDB::FileHandle &fileHandle, unsigned long long &checksum) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned numPages = fileHandle.getNumberOfPages();
+        PeterDB::PageGuard guard;
+        for (PeterDB::PageNum pageNum = 0; pageNum < numPages; pageNum++) {
+            if (fileHandle.pinPage(pageNum, guard) != 0) {
+                fprintf(stderr, "pinPage(%u) failed\n", pageNum);
+                exit(1);
+            }
+            const char *page = guard.data();
+            for (unsigned offset = 0; offset < PAGE_SIZE; offset += 64) {
+                unsigned value;
+                memcpy(&value, page + offset, sizeof(value));
+                checksum += value;
+            }
+        }
+        guard.release();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const char *mode, const char *cache, unsigned numPages, double seconds, unsigned long long checksum) {
+        printf("%-9s %-5s %8.1f MB/s  %8.2f us/page  (checksum %llx)\n", mode, cache,
+               numPages * (double) PAGE_SIZE / seconds / (1 << 20), seconds * 1e6 / numPages, checksum);
+    }
+
+    void run(const char *mode, const std::string &fileName, bool mapped, unsigned numPages) {
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        dropOSCache(fileName);
+        for (const char *cache : {"cold", "warm"}) {
+            PeterDB::FileHandle fileHandle;
+            PeterDB::RC rc = mapped ? pfm.openFileMapped(fileName, fileHandle) : pfm.openFile(fileName, fileHandle);
+            if (rc != 0) {
+                fprintf(stderr, "cannot open %s\n", fileName.c_str());
+                exit(1);
+            }
+            unsigned long long checksum = 0;
+            double seconds = scan(fileHandle, checksum);
+            report(mode, cache, numPages, seconds, checksum);
+            pfm.closeFile(fileHandle);
+        }
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    unsigned numPages = 262144;
+    std::string fileName = "mmap_bench_file";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--pages") == 0) numPages = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--file") == 0) fileName = argv[i + 1];
+    }
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    pfm.destroyFile(fileName);
+    PeterDB::FileHandle fileHandle;
+    if (pfm.createFile(fileName) != 0 || pfm.openFile(fileName, fileHandle) != 0) {
+        fprintf(stderr, "cannot create %s\n", fileName.c_str());
+        return 1;
+    }
+    std::vector<char> batch((size_t) BUILD_BATCH_PAGES * PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i += BUILD_BATCH_PAGES) {
+        unsigned count = numPages - i < BUILD_BATCH_PAGES ? numPages - i : BUILD_BATCH_PAGES;
+        for (unsigned j = 0; j < count; j++) {
+            memset(&batch[(size_t) j * PAGE_SIZE], (int) ((i + j) % 251), PAGE_SIZE);
+        }
+        if (fileHandle.appendPages(count, batch.data()) != 0) {
+            fprintf(stderr, "appendPages failed\n");
+            return 1;
+        }
+    }
+    pfm.closeFile(fileHandle);
+
+    printf("sequential scan of %u pages (%.1f MB)\n", numPages, numPages * (double) PAGE_SIZE / (1 << 20));
+    run("buffered", fileName, false, numPages);
+    run("mapped", fileName, true, numPages);
+
+    pfm.destroyFile(fileName);
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Throughput and latency of the page layer through FileHandle, as JSON for tracking across builds.
+//
+// usage: pfm_bench [--file-size MB] [--page-size BYTES] [--cache pool|os|cold] [--ops N]
+//                  [--write-percent P] [--seed N] [--file NAME]
+//
+// Four workloads run in order on one file: sequential append (appendPage until the file has --file-size MB,
+// then flush), sequential read (readPage of every page), random read (--ops uniform readPage calls) and mixed
+// (--ops uniform calls, --write-percent of them writePage, then flush). Every call is timed on its own; the
+// report gives throughput and latency percentiles per workload, plus the buffer pool hits and misses.
+// --cache chooses where pages are found:
+//   pool  the buffer pool holds the whole file, so reads after the appends never leave the process
+//   os    a default-size pool, emptied before each workload; misses are served from the OS page cache
+//   cold  as os, and the OS page cache of the file is dropped before each workload
+// Page contents and the random page sequence depend only on --seed, so two builds run the same I/O.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+
+namespace {
+
+    typedef struct Workload {
+        const char *name;
+        unsigned long long ops;
+        unsigned long long bytes;
+        double seconds;
+        std::vector<unsigned> latencies;    // nanoseconds per call
+        unsigned hits;
+        unsigned misses;
+    } Workload;
+
+    typedef struct Config {
+        unsigned long long fileSize;
+        unsigned pageSize;
+        unsigned numPages;
+        std::string cache;
+        unsigned frames;
+        unsigned ops;
+        unsigned writePercent;
+        unsigned seed;
+    } Config;
+
+    void fail(const char *message) {
+        fprintf(stderr, "%s\n", message);
+        exit(1);
+    }
+
+    void dropOSCache(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    // Page pageNum, version version: the page number and version up front, then bytes derived from both.
+    void fillPage(char *page, unsigned pageSize, unsigned pageNum, unsigned version) {
+        memcpy(page, &pageNum, sizeof(unsigned));
+        memcpy(page + sizeof(unsigned), &version, sizeof(unsigned));
+        for (unsigned i = 2 * sizeof(unsigned); i < pageSize; i++) {
+            page[i] = (char) (pageNum * 31 + version * 7 + i);
+        }
+    }
+
+    unsigned elapsedNanoseconds(std::chrono::steady_clock::time_point start) {
+        return (unsigned) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Empty the buffer pool, and in cold mode the OS page cache, so each workload starts the same way.
+    void prepare(const Config &config, const std::string &fileName, PeterDB::FileHandle &fileHandle) {
+        if (config.cache == "pool") return;
+        if (fileHandle.flush() != 0) fail("flush failed");
+        PeterDB::PagedFileManager::instance().setBufferPoolSize(config.frames);
+        if (config.cache == "cold") dropOSCache(fileName);
+    }
+
+    void begin(Workload &workload, const char *name, unsigned long long ops, PeterDB::FileHandle &fileHandle) {
+        workload.name = name;
+        workload.ops = ops;
+        workload.bytes = 0;
+        workload.latencies.clear();
+        workload.latencies.reserve(ops);
+        fileHandle.collectCacheCounterValues(workload.hits, workload.misses);
+    }
+
+    void end(Workload &workload, std::chrono::steady_clock::time_point start, PeterDB::FileHandle &fileHandle) {
+        workload.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        unsigned hits, misses;
+        fileHandle.collectCacheCounterValues(hits, misses);
+        workload.hits = hits - workload.hits;
+        workload.misses = misses - workload.misses;
+    }
+
+    void sequentialAppend(const Config &config, PeterDB::FileHandle &fileHandle, Workload &workload) {
+        std::vector<char> page(config.pageSize);
+        begin(workload, "sequential_append", config.numPages, fileHandle);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned pageNum = 0; pageNum < config.numPages; pageNum++) {
+            fillPage(page.data(), config.pageSize, pageNum, 0);
+            auto call = std::chrono::steady_clock::now();
+            if (fileHandle.appendPage(page.data()) != 0) fail("appendPage failed");
+            workload.latencies.push_back(elapsedNanoseconds(call));
+        }
+        if (fileHandle.flush() != 0) fail("flush failed");
+        workload.bytes = (unsigned long long) config.numPages * config.pageSize;
+        end(workload, start, fileHandle);
+    }
+
+    void sequentialRead(const Config &config, PeterDB::FileHandle &fileHandle, Workload &workload) {
+        std::vector<char> page(config.pageSize);
+        begin(workload, "sequential_read", config.numPages, fileHandle);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned pageNum = 0; pageNum < config.numPages; pageNum++) {
+            auto call = std::chrono::steady_clock::now();
+            if (fileHandle.readPage(pageNum, page.data()) != 0) fail("readPage failed");
+            workload.latencies.push_back(elapsedNanoseconds(call));
+            unsigned stored;
+            memcpy(&stored, page.data(), sizeof(unsigned));
+            if (stored != pageNum) fail("sequential read returned the wrong page");
+        }
+        workload.bytes = (unsigned long long) config.numPages * config.pageSize;
+        end(workload, start, fileHandle);
+    }
+
+    // Random reads and mixed reads and writes draw the same kind of page sequence from the seed.
+    void randomAccess(const Config &config, PeterDB::FileHandle &fileHandle, Workload &workload, const char *name,
+                      unsigned writePercent, std::vector<unsigned> &versions) {
+        std::mt19937_64 random(config.seed + (writePercent == 0 ? 0 : 1));
+        std::vector<char> page(config.pageSize);
+        begin(workload, name, config.ops, fileHandle);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < config.ops; i++) {
+            unsigned pageNum = (unsigned) (random() % config.numPages);
+            bool write = random() % 100 < writePercent;
+            if (write) fillPage(page.data(), config.pageSize, pageNum, ++versions[pageNum]);
+            auto call = std::chrono::steady_clock::now();
+            PeterDB::RC rc = write ? fileHandle.writePage(pageNum, page.data())
+                                   : fileHandle.readPage(pageNum, page.data());
+            workload.latencies.push_back(elapsedNanoseconds(call));
+            if (rc != 0) fail(write ? "writePage failed" : "readPage failed");
+            unsigned stored, version;
+            memcpy(&stored, page.data(), sizeof(unsigned));
+            memcpy(&version, page.data() + sizeof(unsigned), sizeof(unsigned));
+            if (stored != pageNum || version != versions[pageNum]) fail("random access returned a stale page");
+        }
+        if (writePercent > 0 && fileHandle.flush() != 0) fail("flush failed");
+        workload.bytes = (unsigned long long) config.ops * config.pageSize;
+        end(workload, start, fileHandle);
+    }
+
+    double percentile(const std::vector<unsigned> &sorted, double fraction) {
+        if (sorted.empty()) return 0;
+        size_t index = (size_t) (fraction * (double) (sorted.size() - 1) + 0.5);
+        return sorted[index] / 1000.0;
+    }
+
+    void printWorkload(Workload &workload, bool last) {
+        std::sort(workload.latencies.begin(), workload.latencies.end());
+        double mean = 0;
+        for (unsigned latency : workload.latencies) {
+            mean += latency;
+        }
+        if (!workload.latencies.empty()) mean /= (double) workload.latencies.size() * 1000.0;
+        printf("    {\n");
+        printf("      \"name\": \"%s\",\n", workload.name);
+        printf("      \"ops\": %llu,\n", workload.ops);
+        printf("      \"seconds\": %.6f,\n", workload.seconds);
+        printf("      \"ops_per_second\": %.1f,\n", workload.ops / workload.seconds);
+        printf("      \"mb_per_second\": %.2f,\n", workload.bytes / workload.seconds / (1 << 20));
+        printf("      \"cache_hits\": %u,\n", workload.hits);
+        printf("      \"cache_misses\": %u,\n", workload.misses);
+        printf("      \"latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, "
+               "\"max\": %.3f}\n", mean, percentile(workload.latencies, 0.5), percentile(workload.latencies, 0.9),
+               percentile(workload.latencies, 0.99), percentile(workload.latencies, 0.999),
+               percentile(workload.latencies, 1.0));
+        printf("    }%s\n", last ? "" : ",");
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    Config config{256, PAGE_SIZE, 0, "os", BPM_DEFAULT_FRAMES, 200000, 30, 42};
+    std::string fileName = "pfm_bench_file";
+    const char *usage = "usage: pfm_bench [--file-size MB] [--page-size BYTES] [--cache pool|os|cold] [--ops N] "
+                        "[--write-percent P] [--seed N] [--file NAME]";
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) fail(usage);
+        if (strcmp(argv[i], "--file-size") == 0) config.fileSize = strtoull(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--page-size") == 0) config.pageSize = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--cache") == 0) config.cache = argv[i + 1];
+        else if (strcmp(argv[i], "--ops") == 0) config.ops = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--write-percent") == 0) config.writePercent = (unsigned) atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0) config.seed = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--file") == 0) fileName = argv[i + 1];
+        else fail(usage);
+    }
+    if (config.cache != "pool" && config.cache != "os" && config.cache != "cold") fail("--cache is pool, os or cold");
+    if (config.writePercent > 100) config.writePercent = 100;
+    config.numPages = (unsigned) (config.fileSize * (1 << 20) / config.pageSize);
+    if (config.numPages == 0) fail("--file-size is below one page");
+    // The pool budget counts PAGE_SIZE frames whatever the page size of the file.
+    if (config.cache == "pool") {
+        config.frames = (unsigned) (config.fileSize * (1 << 20) / PAGE_SIZE) + BPM_DEFAULT_FRAMES;
+    }
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    pfm.destroyFile(fileName);
+    PeterDB::FileHandle fileHandle;
+    if (pfm.createFile(fileName, config.pageSize) != 0 || pfm.openFile(fileName, fileHandle) != 0) {
+        fail("cannot create the file; the page size must be a power of two from 4096 to 65536");
+    }
+    pfm.setBufferPoolSize(config.frames);
+
+    std::vector<Workload> workloads(4);
+    std::vector<unsigned> versions(config.numPages, 0);
+    sequentialAppend(config, fileHandle, workloads[0]);
+    prepare(config, fileName, fileHandle);
+    sequentialRead(config, fileHandle, workloads[1]);
+    prepare(config, fileName, fileHandle);
+    randomAccess(config, fileHandle, workloads[2], "random_read", 0, versions);
+    prepare(config, fileName, fileHandle);
+    randomAccess(config, fileHandle, workloads[3], "mixed", config.writePercent, versions);
+
+    printf("{\n");
+    printf("  \"benchmark\": \"pfm_bench\",\n");
+    printf("  \"config\": {\"file_size_mb\": %llu, \"page_size\": %u, \"pages\": %u, \"cache\": \"%s\", "
+           "\"pool_frames\": %u, \"ops\": %u, \"write_percent\": %u, \"seed\": %u},\n", config.fileSize,
+           config.pageSize, config.numPages, config.cache.c_str(), config.frames, config.ops, config.writePercent,
+           config.seed);
+    printf("  \"workloads\": [\n");
+    for (size_t i = 0; i < workloads.size(); i++) {
+        printWorkload(workloads[i], i + 1 == workloads.size());
+    }
+    printf("  ]\n");
+    printf("}\n");
+
+    pfm.closeFile(fileHandle);
+    pfm.destroyFile(fileName);
+    return 0;
+}
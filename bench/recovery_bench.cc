@@ -0,0 +1,269 @@
+// Restart time after a crash in the middle of a logged insert load, by number of redo threads.
+//
+// usage: recovery_bench [--records N] [--files N] [--threads 1,2,4,8] [--checkpoint-bytes N]
+//                       [--flush-ms N] [--frames N] [--cold 0|1]
+//
+// A child process opens the log with asynchronous commits and inserts employee records round-robin into the
+// files, forcing the log every COMMIT_BATCH inserts and reporting the RIDs made durable. After the last insert
+// it kills itself with SIGKILL, so the buffer pool and the log buffer are lost. The parent keeps a copy of the
+// files and the log as the child left them, and for every thread count restores the copy, times
+// RecoveryManager::restart, and reads back every record the child saw committed.
+// --checkpoint-bytes 0 turns fuzzy checkpoints off, so the whole log is replayed; --cold 1 drops the OS cache of
+// the files before each restart.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "src/include/rbfm.h"
+#include "src/include/wal.h"
+#include "src/include/recovery.h"
+
+namespace {
+
+    const unsigned COMMIT_BATCH = 10000;
+    const char *LOG_NAME = "recovery_bench.wal";
+
+    std::string dataName(unsigned file) {
+        return "recovery_bench_" + std::to_string(file);
+    }
+
+    long long fileSize(const std::string &fileName) {
+        struct stat st{};
+        return stat(fileName.c_str(), &st) == 0 ? (long long) st.st_size : -1;
+    }
+
+    bool copyFile(const std::string &from, const std::string &to) {
+        int in = open(from.c_str(), O_RDONLY);
+        int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool copied = in >= 0 && out >= 0;
+        std::vector<char> buffer(1 << 20);
+        while (copied) {
+            ssize_t count = read(in, buffer.data(), buffer.size());
+            if (count <= 0) {
+                copied = count == 0;
+                break;
+            }
+            copied = write(out, buffer.data(), count) == count;
+        }
+        if (in >= 0) close(in);
+        if (out >= 0) close(out);
+        return copied;
+    }
+
+    void dropOSCache(const std::string &fileName) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    std::vector<PeterDB::Attribute> employeeDescriptor() {
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        recordDescriptor.push_back(PeterDB::Attribute{"EmpName", PeterDB::TypeVarChar, 30});
+        recordDescriptor.push_back(PeterDB::Attribute{"Age", PeterDB::TypeInt, 4});
+        recordDescriptor.push_back(PeterDB::Attribute{"Height", PeterDB::TypeReal, 4});
+        recordDescriptor.push_back(PeterDB::Attribute{"Salary", PeterDB::TypeInt, 4});
+        return recordDescriptor;
+    }
+
+    // Record i in the rbfm record format; the reader regenerates it to check what was recovered.
+    unsigned prepareEmployee(unsigned i, char *record) {
+        std::string name = "Employee" + std::to_string(i);
+        int age = 20 + (int) (i % 45);
+        float height = 150.0f + (float) (i % 500) / 10;
+        int salary = 3000 + (int) (i % 200) * 50;
+
+        unsigned offset = 0;
+        record[offset++] = 0;
+        int length = (int) name.size();
+        memcpy(record + offset, &length, sizeof(int));
+        offset += sizeof(int);
+        memcpy(record + offset, name.data(), name.size());
+        offset += name.size();
+        memcpy(record + offset, &age, sizeof(int));
+        offset += sizeof(int);
+        memcpy(record + offset, &height, sizeof(float));
+        offset += sizeof(float);
+        memcpy(record + offset, &salary, sizeof(int));
+        return offset + sizeof(int);
+    }
+
+    void fail(const char *message) {
+        fprintf(stderr, "%s\n", message);
+        exit(1);
+    }
+
+    // The crashing process: everything it reports through out is durable in the log.
+    void load(int out, unsigned numRecords, unsigned numFiles, unsigned long long checkpointBytes,
+              unsigned flushMs, unsigned frames) {
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        PeterDB::LogManager &log = PeterDB::LogManager::instance();
+        pfm.setBufferPoolSize(frames);
+        pfm.bufferPool().setFlushInterval(flushMs);
+        log.setCheckpointInterval(checkpointBytes);
+        if (PeterDB::RecoveryManager::instance().restart(LOG_NAME, false) != 0) fail("cannot open the log");
+
+        std::vector<PeterDB::FileHandle> fileHandles(numFiles);
+        for (unsigned file = 0; file < numFiles; file++) {
+            if (rbfm.createFile(dataName(file)) != 0 || rbfm.openFile(dataName(file), fileHandles[file]) != 0) {
+                fail("cannot create the data files");
+            }
+        }
+        std::vector<PeterDB::Attribute> recordDescriptor = employeeDescriptor();
+        std::vector<PeterDB::RID> rids;
+        char record[128];
+        for (unsigned i = 0; i < numRecords; i++) {
+            PeterDB::RID rid;
+            prepareEmployee(i, record);
+            if (rbfm.insertRecord(fileHandles[i % numFiles], recordDescriptor, record, rid) != 0) {
+                fail("insertRecord failed");
+            }
+            rids.push_back(rid);
+            if (rids.size() == COMMIT_BATCH) {
+                if (log.sync() != 0) fail("cannot force the log");
+                if (write(out, rids.data(), rids.size() * sizeof(PeterDB::RID)) < 0) fail("cannot report");
+                rids.clear();
+            }
+        }
+        kill(getpid(), SIGKILL);
+    }
+
+    bool verify(const std::vector<PeterDB::RID> &rids, unsigned numFiles) {
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        std::vector<PeterDB::FileHandle> fileHandles(numFiles);
+        for (unsigned file = 0; file < numFiles; file++) {
+            if (rbfm.openFile(dataName(file), fileHandles[file]) != 0) return false;
+        }
+        std::vector<PeterDB::Attribute> recordDescriptor = employeeDescriptor();
+        char expected[128], actual[128];
+        bool verified = true;
+        for (unsigned i = 0; verified && i < rids.size(); i++) {
+            unsigned length = prepareEmployee(i, expected);
+            verified = rbfm.readRecord(fileHandles[i % numFiles], recordDescriptor, rids[i], actual) == 0 &&
+                       memcmp(expected, actual, length) == 0;
+        }
+        for (unsigned file = 0; file < numFiles; file++) {
+            rbfm.closeFile(fileHandles[file]);
+        }
+        return verified;
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    unsigned numRecords = 1000000, numFiles = 8, flushMs = 100, frames = 32768;
+    unsigned long long checkpointBytes = WAL_CHECKPOINT_INTERVAL;
+    std::string threadList = "1,2,4,8";
+    bool cold = false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--records") == 0) numRecords = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--files") == 0) numFiles = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0) threadList = argv[i + 1];
+        else if (strcmp(argv[i], "--checkpoint-bytes") == 0) checkpointBytes = strtoull(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--flush-ms") == 0) flushMs = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--frames") == 0) frames = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--cold") == 0) cold = strcmp(argv[i + 1], "0") != 0;
+    }
+    if (numFiles == 0) numFiles = 1;
+
+    std::vector<std::string> names;
+    for (unsigned file = 0; file < numFiles; file++) {
+        names.push_back(dataName(file));
+    }
+    names.push_back(LOG_NAME);
+    for (const std::string &name : names) {
+        unlink(name.c_str());
+    }
+
+    // No singleton may exist before the fork: the buffer pool and the log run threads.
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0) fail("cannot create a pipe");
+    auto loadStart = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child < 0) fail("cannot fork");
+    if (child == 0) {
+        close(pipeFds[0]);
+        load(pipeFds[1], numRecords, numFiles, checkpointBytes, flushMs, frames);
+        _exit(1);
+    }
+    close(pipeFds[1]);
+    std::vector<PeterDB::RID> rids;
+    PeterDB::RID batch[1024];
+    ssize_t count;
+    while ((count = read(pipeFds[0], batch, sizeof(batch))) > 0) {
+        rids.insert(rids.end(), batch, batch + count / sizeof(PeterDB::RID));
+    }
+    close(pipeFds[0]);
+    int status;
+    waitpid(child, &status, 0);
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGKILL) fail("the loader did not crash as planned");
+
+    for (const std::string &name : names) {
+        if (!copyFile(name, name + ".crash")) fail("cannot keep a copy of the crashed files");
+    }
+    PeterDB::LSN redoLsn = WAL_HEADER_SIZE;
+    {
+        PeterDB::LogReader reader;
+        PeterDB::LogRecordHeader header{};
+        const char *record;
+        std::unordered_map<unsigned, std::string> fileNames;
+        if (reader.open(LOG_NAME) == 0 && reader.getCheckpointLsn() != 0 &&
+            reader.load(reader.getCheckpointLsn()) == 0 && (record = reader.next(header)) != nullptr) {
+            PeterDB::decodeCheckpoint(record + sizeof(header), header.length - sizeof(header), redoLsn, fileNames);
+        }
+    }
+    long long logSize = fileSize(LOG_NAME);
+    printf("%u records inserted in %.1f s into %u files, %zu committed before the crash\n", numRecords, loadSeconds,
+           numFiles, rids.size());
+    printf("log %.1f MB, %.1f MB to replay from the last checkpoint\n", logSize / (double) (1 << 20),
+           (logSize - (long long) redoLsn) / (double) (1 << 20));
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    PeterDB::LogManager &log = PeterDB::LogManager::instance();
+    PeterDB::RecoveryManager &recovery = PeterDB::RecoveryManager::instance();
+    pfm.setBufferPoolSize(frames);
+    for (size_t start = 0; start < threadList.size();) {
+        size_t end = threadList.find(',', start);
+        if (end == std::string::npos) end = threadList.size();
+        unsigned numThreads = (unsigned) strtoul(threadList.substr(start, end - start).c_str(), nullptr, 10);
+        start = end + 1;
+
+        for (const std::string &name : names) {
+            if (!copyFile(name + ".crash", name)) fail("cannot restore the crashed files");
+            if (cold) dropOSCache(name);
+        }
+        auto restartStart = std::chrono::steady_clock::now();
+        PeterDB::RC rc = recovery.restart(LOG_NAME, true, numThreads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - restartStart).count();
+        log.close();
+        if (rc != 0) fail("restart failed");
+
+        unsigned recordCount, redoCount, skipCount, pageCount;
+        recovery.collectCounterValues(recordCount, redoCount, skipCount, pageCount);
+        bool verified = verify(rids, numFiles);
+        printf("%2u threads  restart %8.3f s  %8u records  %8u redone  %8u skipped  %6u pages  %s\n", numThreads,
+               seconds, recordCount, redoCount, skipCount, pageCount, verified ? "verified" : "RECORDS MISSING");
+        pfm.setBufferPoolSize(frames);
+    }
+
+    for (const std::string &name : names) {
+        unlink(name.c_str());
+        unlink((name + ".crash").c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+// Throughput of RecordBasedFileManager::scan over a wide table, projected to few and to all columns, of
+// summing one column through row-at-a-time and column batch scans, and of a selective condition on a column
+// that grows along the file, where the zone maps let the scan pass over most pages.
+//
+// usage: scan_bench [--records N] [--fields N] [--repeat N] [--file NAME]
+//
+// The table has --fields columns: every eighth a VarChar of 8 to 23 characters, the others Ints and Reals,
+// loaded with insertRecords; the first column of record n is n. Each scan runs --repeat times with the file
+// in the buffer pool, and the best run is reported, so the numbers measure the scan itself rather than I/O.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "src/include/rbfm.h"
+
+namespace {
+
+    void fail(const char *message) {
+        fprintf(stderr, "%s\n", message);
+        exit(1);
+    }
+
+    std::vector<PeterDB::Attribute> wideDescriptor(unsigned numFields) {
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        for (unsigned i = 0; i < numFields; i++) {
+            PeterDB::AttrType type = i % 8 == 7 ? PeterDB::TypeVarChar : i % 2 == 0 ? PeterDB::TypeInt
+                                                                                    : PeterDB::TypeReal;
+            recordDescriptor.push_back(PeterDB::Attribute{"f" + std::to_string(i), type,
+                                                          type == PeterDB::TypeVarChar ? 32u : 4u});
+        }
+        return recordDescriptor;
+    }
+
+    // A record in the rbfm format; field i of record n is NULL when (n + i) % 29 == 0.
+    void prepareRecord(const std::vector<PeterDB::Attribute> &recordDescriptor, unsigned n, std::mt19937 &random,
+                       std::vector<char> &record) {
+        unsigned nullBytes = (recordDescriptor.size() + 7) / 8;
+        record.assign(nullBytes, 0);
+        for (unsigned i = 0; i < recordDescriptor.size(); i++) {
+            if ((n + i) % 29 == 0) {
+                record[i / 8] |= (char) (0x80 >> (i % 8));
+                continue;
+            }
+            char value[sizeof(unsigned) + 32];
+            unsigned length = sizeof(int);
+            if (recordDescriptor[i].type == PeterDB::TypeVarChar) {
+                unsigned chars = 8 + random() % 16;
+                memcpy(value, &chars, sizeof(unsigned));
+                for (unsigned c = 0; c < chars; c++) value[sizeof(unsigned) + c] = (char) ('a' + random() % 26);
+                length = sizeof(unsigned) + chars;
+            } else if (recordDescriptor[i].type == PeterDB::TypeInt) {
+                int intValue = i == 0 ? (int) n : (int) (random() % 100000);
+                memcpy(value, &intValue, sizeof(int));
+            } else {
+                float realValue = (float) (random() % 100000) / 10;
+                memcpy(value, &realValue, sizeof(float));
+            }
+            record.insert(record.end(), value, value + length);
+        }
+    }
+
+    void load(PeterDB::FileHandle &fileHandle, const std::vector<PeterDB::Attribute> &recordDescriptor,
+              unsigned numRecords) {
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        std::mt19937 random(42);
+        std::vector<std::vector<char> > records(1000);
+        std::vector<const void *> batch;
+        std::vector<PeterDB::RID> rids;
+        for (unsigned first = 0; first < numRecords; first += records.size()) {
+            batch.clear();
+            for (unsigned n = first; n < numRecords && n < first + records.size(); n++) {
+                prepareRecord(recordDescriptor, n, random, records[n - first]);
+                batch.push_back(records[n - first].data());
+            }
+            if (rbfm.insertRecords(fileHandle, recordDescriptor, batch, rids) != 0) fail("insertRecords failed");
+        }
+        if (fileHandle.flush() != 0) fail("flush failed");
+    }
+
+    // The best of repeat scans, in seconds; rows is the number of records the scan returned, and skipped the
+    // pages it did not read.
+    double scan(PeterDB::FileHandle &fileHandle, const std::vector<PeterDB::Attribute> &recordDescriptor,
+                const std::vector<PeterDB::AttributeCondition> &conditions,
+                const std::vector<std::string> &attributeNames, unsigned repeat, unsigned &rows, unsigned &skipped) {
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        std::vector<char> data(PAGE_SIZE);
+        double best = 0;
+        for (unsigned r = 0; r < repeat; r++) {
+            PeterDB::RBFM_ScanIterator iterator;
+            PeterDB::RID rid;
+            rows = 0;
+            auto start = std::chrono::steady_clock::now();
+            if (rbfm.scan(fileHandle, recordDescriptor, conditions, attributeNames, iterator) != 0) fail("scan failed");
+            while (iterator.getNextRecord(rid, data.data()) != RBFM_EOF) rows++;
+            skipped = iterator.getSkippedPages();
+            iterator.close();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (r == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+    // The best of repeat sums of one Int column, row by row through getNextRecord or a column at a time
+    // through getNextBatch.
+    double sumColumn(PeterDB::FileHandle &fileHandle, const std::vector<PeterDB::Attribute> &recordDescriptor,
+                     const std::string &attributeName, bool batched, unsigned repeat, long long &sum) {
+        PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+        std::vector<char> data(PAGE_SIZE);
+        PeterDB::RecordBatch batch;
+        double best = 0;
+        for (unsigned r = 0; r < repeat; r++) {
+            PeterDB::RBFM_ScanIterator iterator;
+            PeterDB::RID rid;
+            sum = 0;
+            auto start = std::chrono::steady_clock::now();
+            if (rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {attributeName}, iterator) != 0) {
+                fail("scan failed");
+            }
+            if (batched) {
+                while (iterator.getNextBatch(batch) != RBFM_EOF) {
+                    const std::vector<int> &values = batch.columns[0].ints;
+                    for (unsigned row = 0; row < batch.rows; row++) sum += values[row];
+                }
+            } else {
+                while (iterator.getNextRecord(rid, data.data()) != RBFM_EOF) {
+                    int value;
+                    memcpy(&value, data.data() + 1, sizeof(int));
+                    if (data[0] == 0) sum += value;
+                }
+            }
+            iterator.close();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (r == 0 || seconds < best) best = seconds;
+        }
+        return best;
+    }
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+    unsigned numRecords = 200000;
+    unsigned numFields = 64;
+    unsigned repeat = 5;
+    std::string fileName = "scan_bench_file";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--records") == 0) numRecords = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--fields") == 0) numFields = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--repeat") == 0) repeat = (unsigned) strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--file") == 0) fileName = argv[i + 1];
+    }
+    if (numFields < 2) fail("--fields is at least 2");
+    if (repeat == 0) repeat = 1;
+
+    PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+    PeterDB::RecordBasedFileManager &rbfm = PeterDB::RecordBasedFileManager::instance();
+    rbfm.destroyFile(fileName);
+    PeterDB::FileHandle fileHandle;
+    if (rbfm.createFile(fileName) != 0 || rbfm.openFile(fileName, fileHandle) != 0) fail("cannot create the file");
+    std::vector<PeterDB::Attribute> recordDescriptor = wideDescriptor(numFields);
+    load(fileHandle, recordDescriptor, numRecords);
+    // Keep the whole file in the shared pool; a scan would otherwise move to a scan ring and reread it.
+    pfm.setBufferPoolSize(fileHandle.getNumberOfPages() + BPM_DEFAULT_FRAMES);
+    fileHandle.setAccessPattern(PeterDB::PFM_ACCESS_RANDOM);
+
+    std::vector<std::string> all;
+    for (const PeterDB::Attribute &attribute : recordDescriptor) all.push_back(attribute.name);
+    const std::vector<std::pair<const char *, std::vector<std::string> > > projections = {
+            {"1 column",  {recordDescriptor[numFields / 2].name}},
+            {"2 columns", {recordDescriptor[numFields - 1].name, recordDescriptor[1].name}},
+            {"all",       all}};
+
+    printf("%u records, %u fields, %u pages\n", numRecords, numFields, fileHandle.getNumberOfPages());
+    for (const auto &projection : projections) {
+        unsigned rows, skipped;
+        scan(fileHandle, recordDescriptor, {}, projection.second, 1, rows, skipped);
+        double seconds = scan(fileHandle, recordDescriptor, {}, projection.second, repeat, rows, skipped);
+        printf("%-10s  %8.3f s  %10.0f rows/s  %u rows\n", projection.first, seconds, rows / seconds, rows);
+    }
+    {
+        int limit = (int) (numRecords / 100);
+        unsigned rows, skipped;
+        double seconds = scan(fileHandle, recordDescriptor, {{recordDescriptor[0].name, PeterDB::LT_OP, &limit}},
+                              {recordDescriptor[1].name}, repeat, rows, skipped);
+        printf("%-10s  %8.3f s  %10.0f rows/s  %u rows, %u pages skipped\n", "f0 < 1%", seconds,
+               numRecords / seconds, rows, skipped);
+    }
+    for (bool batched : {false, true}) {
+        long long sum;
+        double seconds = sumColumn(fileHandle, recordDescriptor, recordDescriptor[0].name, batched, repeat, sum);
+        printf("%-10s  %8.3f s  %10.0f rows/s  sum %lld\n", batched ? "sum batch" : "sum rows", seconds,
+               numRecords / seconds, sum);
+    }
+
+    rbfm.closeFile(fileHandle);
+    rbfm.destroyFile(fileName);
+    pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES);
+    return 0;
+}
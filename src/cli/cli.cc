@@ -10,6 +10,7 @@
 
 // CVS file read delimiters
 #define CVS_DELIMITERS ","
+#define LOAD_BATCH_SIZE (1 << 20)   // bytes of tuples load hands to insertTuples at once
 #define CLI_TABLES "cli_tables"
 #define CLI_COLUMNS "cli_columns"
 #define CLI_INDEXES "cli_indexes"
@@ -528,7 +529,8 @@ namespace PeterDB {
     }
 
     RC CLI::run(Iterator *it) {
-        void *data = malloc(PAGE_SIZE);
+        ArenaBuffer tuple;
+        void *data = tuple.data();
         std::vector <Attribute> attrs;
         std::vector <std::string> outputBuffer;
         it->getAttributes(attrs);
@@ -604,7 +606,7 @@ namespace PeterDB {
 
         Value value;
         value.type = attr.type;
-        value.data = malloc(PAGE_SIZE);
+        value.data = malloc(PFM_MAX_PAGE_SIZE);
         token = next();
         attribute = std::string(token);
 
@@ -947,7 +949,7 @@ namespace PeterDB {
         // Set up the iterator
         RM_ScanIterator rmsi;
         RID rid;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(PFM_MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
@@ -1001,7 +1003,7 @@ namespace PeterDB {
         // Set up the iterator
         Attribute attr;
         RM_ScanIterator rmsi;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(PFM_MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
@@ -1166,8 +1168,8 @@ namespace PeterDB {
         this->getAttributesFromCatalog(tableName, attributes);
         uint offset = 0, index = 0, keyIndex = 0;
         uint length;
-        void *buffer = malloc(PAGE_SIZE);
-        void *key = malloc(PAGE_SIZE);
+        ArenaBuffer tuple;
+        void *buffer = tuple.data();
         RID rid;
 
         // find out if there is any index for tableName
@@ -1175,7 +1177,7 @@ namespace PeterDB {
         for (uint i = 0; i < attributes.size(); i++) {
             if (this->checkAttribute(tableName, attributes.at(i).name, rid, false))
                 // add index to index-map
-                indexMap[i] = malloc(PAGE_SIZE);
+                indexMap[i] = FrameArena::instance().allocate(PFM_MAX_PAGE_SIZE);
         }
 
         // read file
@@ -1195,14 +1197,17 @@ namespace PeterDB {
         memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
 
         std::string line, token;
+        std::vector<char> lineBuffer;   // reused, so a line only allocates when it is the longest so far
+        std::vector<char> tuples;       // parsed tuples, inserted a batch at a time
+        std::vector<size_t> tupleOffsets;
         char *tokenizer;
         while (ifs.good()) {
             getline(ifs, line);
             if (line == "")
                 continue;
-            char *a = new char[line.size() + 1];
-            a[line.size()] = 0;
-            memcpy(a, line.c_str(), line.size());
+            lineBuffer.assign(line.begin(), line.end());
+            lineBuffer.push_back(0);
+            char *a = lineBuffer.data();
             index = 0, offset = 0;
 
             // Null-indicator for the fields
@@ -1248,22 +1253,27 @@ namespace PeterDB {
                 if (keyIndex == attributes.size())
                     keyIndex = 0;
             }
-            if (this->insertTupleToDB(tableName, attributes, buffer, indexMap) != 0) {
-                return error("error while inserting tuple");
+            tupleOffsets.push_back(tuples.size());
+            tuples.insert(tuples.end(), (char *) buffer, (char *) buffer + offset);
+            if (tuples.size() >= LOAD_BATCH_SIZE) {
+                if (this->insertTuplesToDB(tableName, tuples, tupleOffsets) != 0)
+                    return error("error while inserting tuples");
+                tuples.clear();
+                tupleOffsets.clear();
             }
 
-            delete[] a;
             // prepare tuple for addition
             // for (std::vector<Attribute>::iterator it = attrs.begin() ; it != attrs.end(); ++it)
             // totalLength += it->length;
         }
+        if (!tupleOffsets.empty() && this->insertTuplesToDB(tableName, tuples, tupleOffsets) != 0)
+            return error("error while inserting tuples");
+
         // clear up indexMap
         for (auto & it : indexMap) {
-            free(it.second);
+            FrameArena::instance().release(it.second, PFM_MAX_PAGE_SIZE);
         }
 
-        free(buffer);
-        free(key);
         ifs.close();
         return 0;
     }
@@ -1285,9 +1295,9 @@ namespace PeterDB {
         this->getAttributesFromCatalog(tableName, attributes);
         int offset = 0, index = 0;
         int length;
-        void *buffer = malloc(PAGE_SIZE);
-        memset(buffer, 0, PAGE_SIZE);
-        void *key = malloc(PAGE_SIZE);
+        ArenaBuffer tuple;
+        void *buffer = tuple.data();
+        memset(buffer, 0, PFM_MAX_PAGE_SIZE);
         RID rid;
 
         // find out if there is any index for tableName
@@ -1295,7 +1305,7 @@ namespace PeterDB {
         for (uint i = 0; i < attributes.size(); i++) {
             if (this->checkAttribute(tableName, attributes.at(i).name, rid, false))
                 // add index to index-map
-                indexMap[i] = malloc(PAGE_SIZE);
+                indexMap[i] = FrameArena::instance().allocate(PFM_MAX_PAGE_SIZE);
         }
 
         // Assume that we don't have any NULL values when inserting data.
@@ -1359,11 +1369,9 @@ namespace PeterDB {
 
         // clear up indexMap
         for (auto it = indexMap.begin(); it != indexMap.end(); ++it) {
-            free(it->second);
+            FrameArena::instance().release(it->second, PFM_MAX_PAGE_SIZE);
         }
 
-        free(buffer);
-        free(key);
         return 0;
     }
 
@@ -1378,6 +1386,21 @@ namespace PeterDB {
         return 0;
     }
 
+    // Bulk loading inserts many tuples per call, so the record layer fills and writes whole pages.
+    RC CLI::insertTuplesToDB(const std::string& tableName, const std::vector<char>& tuples,
+                             const std::vector<size_t>& offsets) {
+        std::vector<const void *> batch;
+        batch.reserve(offsets.size());
+        for (size_t offset : offsets)
+            batch.push_back(tuples.data() + offset);
+
+        std::vector<RID> rids;
+        if (rm.insertTuples(tableName, batch, rids) != 0)
+            return error("error CLI::load in rm.insertTuples");
+
+        return 0;
+    }
+
     RC CLI::printAttributes() {
         char *tokenizer = next();
         if (tokenizer == NULL) {
@@ -1425,11 +1448,11 @@ namespace PeterDB {
 
         std::vector <std::string> outputBuffer;
         RID rid;
-        char key[PAGE_SIZE];
+        ArenaBuffer key;
 
         outputBuffer.emplace_back("PageNum");
         outputBuffer.emplace_back("SlotNum");
-        while (rmisi.getNextEntry(rid, key) == 0) {
+        while (rmisi.getNextEntry(rid, key.data()) == 0) {
             outputBuffer.push_back(std::to_string(rid.pageNum));
             outputBuffer.push_back(std::to_string(rid.slotNum));
         }
@@ -1736,7 +1759,7 @@ namespace PeterDB {
 
         // Set up the iterator
         RM_ScanIterator rmsi;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(PFM_MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
@@ -0,0 +1,144 @@
+#ifndef _aio_h_
+#define _aio_h_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "pfm.h"
+
+#define AIO_DEFAULT_QUEUE_DEPTH 32
+
+namespace PeterDB {
+
+    // One asynchronous read or write. The request must stay alive until it is returned by complete().
+    typedef struct IORequest {
+        int fd;
+        off_t offset;
+        void *buffer;
+        unsigned length;
+        bool write;
+        void *context;              // caller cookie, untouched by the backend
+        int result;                 // bytes transferred, or -errno, once completed
+        struct iovec iov;           // scratch space for the backend
+    } IORequest;
+
+    // AsyncIOBackend keeps many positional reads and writes in flight at once.
+    // submit() never blocks on I/O; complete() reaps finished requests, waiting for at least minCount of them.
+    class AsyncIOBackend {
+    public:
+        // io_uring when the kernel allows it, otherwise a pread/pwrite worker pool
+        static AsyncIOBackend *create(unsigned queueDepth = AIO_DEFAULT_QUEUE_DEPTH, bool allowUring = true);
+
+        virtual ~AsyncIOBackend() = default;
+
+        virtual RC submit(IORequest *const *requests, unsigned count) = 0;
+        virtual unsigned complete(IORequest **completed, unsigned maxCount, unsigned minCount) = 0;
+        virtual unsigned getQueueDepth() const = 0;
+        virtual const char *getName() const = 0;
+    };
+
+    // io_uring through the raw system calls, so there is no liburing dependency.
+    // One thread may submit while another reaps completions.
+    class IOUringBackend : public AsyncIOBackend {
+    public:
+        static IOUringBackend *create(unsigned queueDepth);
+
+        ~IOUringBackend() override;
+
+        RC submit(IORequest *const *requests, unsigned count) override;
+        unsigned complete(IORequest **completed, unsigned maxCount, unsigned minCount) override;
+        unsigned getQueueDepth() const override;
+        const char *getName() const override;
+
+    private:
+        int ringFd;
+        unsigned queueDepth;
+        std::atomic<unsigned> inFlight;
+        void *sqRing, *cqRing, *sqes;
+        size_t sqRingSize, cqRingSize, sqesSize;
+        unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+        unsigned *cqHead, *cqTail, *cqMask;
+        void *cqes;
+
+        IOUringBackend();
+        IOUringBackend(const IOUringBackend &);                             // Prevent construction by copying
+        IOUringBackend &operator=(const IOUringBackend &);                  // Prevent assignment
+    };
+
+    // Portable fallback: a fixed set of workers issuing blocking pread/pwrite calls.
+    class ThreadPoolIOBackend : public AsyncIOBackend {
+    public:
+        explicit ThreadPoolIOBackend(unsigned queueDepth);
+
+        ~ThreadPoolIOBackend() override;
+
+        RC submit(IORequest *const *requests, unsigned count) override;
+        unsigned complete(IORequest **completed, unsigned maxCount, unsigned minCount) override;
+        unsigned getQueueDepth() const override;
+        const char *getName() const override;
+
+    private:
+        unsigned queueDepth;
+        unsigned inFlight;
+        bool stopping;
+        std::mutex latch;
+        std::condition_variable submitted, finished;
+        std::deque<IORequest *> pending, done;
+        std::vector<std::thread> workers;
+
+        void work();
+
+        ThreadPoolIOBackend(const ThreadPoolIOBackend &);                   // Prevent construction by copying
+        ThreadPoolIOBackend &operator=(const ThreadPoolIOBackend &);        // Prevent assignment
+    };
+
+    class AsyncFileIO;
+
+    // A page-level request; io must stay the first member so completions can be mapped back.
+    typedef struct PageRequest {
+        IORequest io;
+        PageNum pageNum;
+        AsyncFileIO *owner;
+    } PageRequest;
+
+    // AsyncFileIO issues page reads and writes for one open FileHandle without blocking.
+    // It stays coherent with the buffer pool: cached pages are served from, or written into,
+    // their frames and complete immediately; only the remaining pages go to the backend.
+    // Several AsyncFileIOs may share one backend, e.g. one per GHJoin partition file. They must then all be
+    // driven from one thread: waitForCompletion reaps whatever the backend finished and hands other owners'
+    // completions to their queues without a latch, and a second thread blocked on the backend could wait
+    // forever for a completion the first one took.
+    // A page must not be read through the buffer pool while an asynchronous write to it is in flight.
+    class AsyncFileIO {
+    public:
+        AsyncFileIO(FileHandle &fileHandle, AsyncIOBackend &backend);
+        ~AsyncFileIO();
+
+        RC submitRead(PageNum pageNum, void *data, void *context);          // Queue a page read
+        RC submitWrite(PageNum pageNum, const void *data, void *context);   // Queue a page write
+        RC waitForCompletion(PageNum &pageNum, void *&context);             // Reap one finished request
+        unsigned getPending() const;                                        // Submitted but not yet reaped
+
+    private:
+        FileHandle &fileHandle;
+        AsyncIOBackend &backend;
+        std::vector<PageRequest *> freeRequests;
+        std::deque<PageRequest *> ready;                                    // completed, not yet reaped
+        unsigned pending;
+
+        PageRequest *takeRequest(PageNum pageNum, void *data, bool write, void *context);
+        RC submitRequest(PageRequest *request);
+
+        AsyncFileIO(const AsyncFileIO &);                                   // Prevent construction by copying
+        AsyncFileIO &operator=(const AsyncFileIO &);                        // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _aio_h_
@@ -0,0 +1,85 @@
+#ifndef _arena_h_
+#define _arena_h_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+#include "pfm.h"
+
+#define ARENA_HUGE_PAGE_SIZE (2 << 20)      // regions of at least this size are backed by huge pages when possible
+#define ARENA_THREAD_CACHE 16               // freed buffers of each size a thread keeps for itself
+#define ARENA_SIZE_CLASSES 5                // PFM_MIN_PAGE_SIZE, doubling up to PFM_MAX_PAGE_SIZE
+
+namespace PeterDB {
+
+    // FrameArena hands out page-aligned memory for page frames and operator scratch buffers.
+    // Regions (allocateRegion) are mapped directly, with MAP_HUGETLB when the system has huge pages reserved
+    // and as transparent huge pages otherwise, so a large buffer pool costs a few TLB entries instead of one
+    // per 4 KB page. Buffers (allocate) are carved from huge-page chunks in power-of-two sizes between
+    // PFM_MIN_PAGE_SIZE and PFM_MAX_PAGE_SIZE; a released buffer goes to a free list of the releasing thread
+    // and is reused without locking, and only a thread whose list runs empty or overflows takes the arena latch.
+    // Chunks are never returned to the system. Larger buffers are mapped as regions of their own.
+    class FrameArena {
+    public:
+        static FrameArena &instance();                                      // Access to the singleton instance
+
+        void *allocate(size_t size);                                        // Page-aligned buffer of size bytes
+        void release(void *buffer, size_t size);                            // Return a buffer, size as allocated
+        void *allocateRegion(size_t size);                                  // Page-aligned memory mapped on its own
+        void releaseRegion(void *region, size_t size);                      // Unmap a region, size as allocated
+
+        // Buffers handed out, allocations that missed the thread's free list, regions and chunks mapped, and
+        // the mappings backed by reserved huge pages.
+        RC collectCounterValues(unsigned &allocateCount, unsigned &refillCount, unsigned &mapCount,
+                                unsigned &hugeMapCount);
+
+        static int sizeClass(size_t size);                                  // -1 if too large for a free list
+        static size_t classSize(int sizeClass);
+
+    private:
+        friend struct ThreadCache;
+
+        std::mutex latch;
+        std::vector<void *> freeLists[ARENA_SIZE_CLASSES];                  // buffers returned by exiting threads
+                                                                            // or overflowing thread lists
+        char *chunks[ARENA_SIZE_CLASSES];                                   // the chunk each size is carved from
+        size_t chunkUsed[ARENA_SIZE_CLASSES];
+        std::atomic<unsigned> allocateCount;
+        std::atomic<unsigned> refillCount;
+        std::atomic<unsigned> mapCount;
+        std::atomic<unsigned> hugeMapCount;
+
+        void *refill(int sizeClass, std::vector<void *> &threadList);      // Move a batch into a thread list
+        void drain(int sizeClass, std::vector<void *> &threadList, size_t keep);
+
+    protected:
+        FrameArena();                                                       // Prevent construction
+        ~FrameArena();                                                      // Prevent unwanted destruction
+        FrameArena(const FrameArena &);                                     // Prevent construction by copying
+        FrameArena &operator=(const FrameArena &);                          // Prevent assignment
+    };
+
+    // ArenaBuffer owns one FrameArena buffer for the lifetime of an operator or a command, in place of a
+    // malloc(PFM_MAX_PAGE_SIZE) that has to be freed on every return path. It throws std::bad_alloc when the
+    // arena cannot map the memory.
+    class ArenaBuffer {
+    public:
+        explicit ArenaBuffer(size_t size = PFM_MAX_PAGE_SIZE);
+        ~ArenaBuffer();
+
+        char *data() const { return buffer; }
+        size_t size() const { return length; }
+
+    private:
+        char *buffer;
+        size_t length;
+
+        ArenaBuffer(const ArenaBuffer &);                                   // Prevent construction by copying
+        ArenaBuffer &operator=(const ArenaBuffer &);                        // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _arena_h_
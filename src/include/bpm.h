@@ -0,0 +1,236 @@
+#ifndef _bpm_h_
+#define _bpm_h_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+#include <sys/types.h>
+
+#include "pfm.h"
+#include "aio.h"
+#include "arena.h"
+#include "wal.h"
+#include "compress.h"
+
+#define BPM_DEFAULT_FRAMES 1024
+#define BPM_PREFETCH_QUEUE 256
+#define BPM_FLUSH_INTERVAL_MS 1000
+#define BPM_FLUSH_MAX_RUN 64
+#define BPM_MIN_POOL_FRAMES 8
+#define BPM_EXTENT_SIZE (1 << 20)
+#define BPM_HOT_PERCENT 75
+#define BPM_RING_FRAMES (2 * PFM_READ_AHEAD_MAX)
+#define BPM_ALL_FILES ((unsigned) -1)
+
+namespace PeterDB {
+
+    // A frame holds one cached page of a registered file.
+    typedef struct Frame {
+        unsigned fileId;            // owner file, meaningful only when valid
+        PageNum pageNum;            // page number within the owner file
+        bool valid;                 // the frame holds a page
+        bool dirty;                 // the cached copy is newer than the copy on disk
+        bool referenced;            // CLOCK reference bit
+        bool loading;               // a read is filling the frame without the latch; readers wait for it
+        bool flushing;              // the flusher is writing a copy of the frame; it cannot be evicted
+        bool hot;                   // in the protected region: reused after CLOCK cleared its reference bit
+        bool prefetched;            // loaded by read-ahead and not pinned yet, so its first pin is no reuse
+        unsigned ring;              // scan ring the frame is recycled in, 0 for the shared region
+        unsigned pinCount;          // the frame cannot be evicted while pinned
+        bool dropped;               // its file was closed while it was pinned; invalidated by the last unpin
+        unsigned pageSize;          // size of the frame, fixed by its FramePool
+        LSN lsn;                    // last logged change since the frame was clean, 0 if none
+        LSN recLsn;                 // log end at the first write pin since the frame was clean, 0 if none
+        char *data;                 // pageSize bytes inside the pool arena
+    } Frame;
+
+    // The frames of one page size. Files with different page sizes never share frames; every pool gets
+    // the same memory budget, so a pool of 64 KB pages has a sixteenth of the frames of the 4 KB pool.
+    typedef struct FramePool {
+        unsigned pageSize;
+        unsigned first;             // the pool owns frames [first, first + count)
+        unsigned count;
+        unsigned clockHand;
+        unsigned loading;           // frames of this pool being filled by read-ahead
+        unsigned hotCount;          // frames of this pool in the protected region
+        char *arena;                // frame memory, a FrameArena region
+    } FramePool;
+
+    // BufferPoolManager is the page cache beneath FileHandle::readPage/writePage/appendPage.
+    // It is owned by the PagedFileManager singleton and shared by every open FileHandle.
+    // Files are registered once per inode, so two handles opened on the same file see the same frames.
+    // Replacement is CLOCK split into two regions, in the spirit of 2Q: a page enters on probation and is
+    // promoted to the protected region when it is pinned again after the hand cleared its reference bit, i.e.
+    // reused outside a burst of correlated pins. The hand evicts probation frames first and demotes protected
+    // ones only while the protected region holds more than BPM_HOT_PERCENT of the pool.
+    // Sequential scans and spill files bypass both regions through a scan ring (createRing): a small FIFO
+    // of frames private to one operator, recycled page after page, so a big scan cannot flush the index and
+    // catalog pages other operators keep reusing. Dirty frames are written back when evicted, flushed, or
+    // when the last handle of their file is closed. Pinned frames are never evicted; see PageGuard.
+    // Read-ahead requests are queued per page and loaded asynchronously into frames; a background
+    // thread reaps their completions, and a reader that pins a page still being loaded waits for it.
+    // Demand reads, appends and vectored I/O on plain files do their pread/pwrite with the latch released, so
+    // a miss or an append on one file never holds up the others: a page being read is marked loading like a
+    // read-ahead, appends to one file take turns, and vectored calls pin the cached frames of their range.
+    // A flusher thread writes dirty, unpinned frames back in page order, one write per run of adjacent
+    // pages, then fdatasyncs every file written since its last sync. It runs on an interval and on sync();
+    // concurrent sync() callers share one cycle, so they share its fsyncs.
+    // Appends reserve disk space an extent at a time with fallocate(FALLOC_FL_KEEP_SIZE): the file size still
+    // counts only appended pages, but the blocks behind it are allocated in large contiguous chunks.
+    // Whatever is left of the last extent is released when the last handle of the file is closed.
+    // Pages of a compressed file are decompressed into frames when loaded and compressed again when written
+    // back; such files are neither read ahead nor preallocated, and vectored I/O on them goes page by page.
+    // While a LogManager is attached, a frame changed under a logged LSN is written back only once the log
+    // is durable up to that LSN; the flusher forces the log once per cycle, before any of its writes.
+    // Nobody waits for the log with the latch held: victim searches pass over frames whose log is not durable
+    // yet, and a pin that finds no other victim, or a flush, forces the log with the latch released first.
+    // Every change a frame missed on disk was logged at or after its recLsn, so after a cycle that wrote and
+    // synced everything, the smallest recLsn at its start is where redo would have to begin; the flusher
+    // passes it to LogManager::checkpointIfDue.
+    // Each pool's frames are one FrameArena region, so a large pool is backed by huge pages when available.
+    class BufferPoolManager {
+    public:
+        explicit BufferPoolManager(unsigned numFrames = BPM_DEFAULT_FRAMES);
+        ~BufferPoolManager();
+
+        RC resize(unsigned numFrames);                                      // Flush, drop and reallocate all frames
+        unsigned getNumFrames();                                            // Number of frames in the pool
+
+        RC registerFile(int fd, unsigned pageSize, unsigned &fileId,
+                        bool compressed = false);                           // Start caching an open file
+        RC unregisterFile(unsigned fileId);                                 // Flush and forget a file on its last close
+
+        RC pinPage(unsigned fileId, PageNum pageNum, unsigned &frameId, char *&data, bool &hit, unsigned ring = 0,
+                   bool forWrite = false);
+        void unpinPage(unsigned frameId, bool dirty, LSN lsn = 0);          // Drop one pin, optionally marking dirty
+        RC writePage(unsigned fileId, PageNum pageNum, const void *data, unsigned ring = 0);
+        RC appendPage(unsigned fileId, const void *data, PageNum &pageNum, unsigned &extents, unsigned ring = 0);
+        RC readPages(unsigned fileId, PageNum pageNum, unsigned count, void *data, unsigned &hits);
+        RC writePages(unsigned fileId, PageNum pageNum, unsigned count, const void *data);
+        RC appendPages(unsigned fileId, unsigned count, const void *data, PageNum &pageNum, unsigned &extents);
+        unsigned getNumberOfPages(unsigned fileId);
+        unsigned getReservedPages(unsigned fileId);                         // Preallocated pages past the last one
+        void setExtentSize(unsigned bytes);                                 // Preallocation unit, 0 = off
+
+        bool readIfCached(unsigned fileId, PageNum pageNum, void *data);   // Copy a cached page, never load it
+        bool writeIfCached(unsigned fileId, PageNum pageNum, const void *data); // Overwrite a cached page only
+
+        RC prefetch(unsigned fileId, PageNum pageNum, unsigned count, unsigned ring = 0); // Queue read-ahead
+        void cancelPrefetch(unsigned fileId);                               // Drop queued read-ahead of a file
+
+        unsigned createRing();                                              // A new scan ring for one operator
+        void dropRing(unsigned ring);                                       // Hand a ring's frames back to the pool
+
+        static off_t pageOffset(PageNum pageNum, unsigned pageSize);        // Position of a data page in its file
+
+        RC flushFile(unsigned fileId);                                      // Write back all dirty pages of a file
+        RC flushAll();                                                      // Write back all dirty pages
+        RC sync();                                                          // Flush and fsync everything, durably
+        void setFlushInterval(unsigned milliseconds);                       // 0 flushes only on sync()
+        void setLogManager(LogManager *log);                                // Write frames back after their log
+
+        // sync() calls and flusher cycles run; cycles well below calls mean concurrent callers shared them.
+        RC collectFlushCounterValues(unsigned &syncCount, unsigned &cycleCount);
+
+    private:
+        typedef struct FileEntry {
+            int fd;                 // private duplicate of the first opener's descriptor
+            dev_t dev;
+            ino_t ino;
+            unsigned refCount;      // number of open FileHandles on this file
+            unsigned numPages;      // number of data pages, excluding the hidden header page
+            unsigned pageSize;
+            unsigned capacity;      // data pages backed by allocated blocks, at least numPages
+            bool preallocate;       // cleared when the file system does not support fallocate
+            bool unsynced;          // written since the last fdatasync
+            bool appending;         // an append is writing without the latch; the next one waits for it
+            CompressedFile *compressed; // nullptr unless the pages are stored compressed
+        } FileEntry;
+
+        typedef struct Ring {
+            std::vector<unsigned> frames;   // in install order; entries the shared region took back are stale
+            unsigned next;                  // oldest frame, recycled next
+        } Ring;
+
+        typedef struct QueuedPrefetch {
+            unsigned fileId;
+            PageNum pageNum;
+            unsigned ring;
+        } QueuedPrefetch;
+
+        std::mutex latch;
+        std::vector<Frame> frames;
+        std::vector<FramePool> pools;
+        unsigned numFrames;                                             // the budget, in PAGE_SIZE frames
+        unsigned extentSize;                                            // bytes reserved per fallocate
+        unsigned nextFileId;
+        std::unordered_map<unsigned long long, unsigned> pageTable;     // (fileId, pageNum) -> frame
+        std::unordered_map<unsigned, FileEntry> files;                  // fileId -> file
+        std::unordered_map<unsigned, Ring> rings;                       // ring id -> scan ring
+        unsigned nextRingId;
+        LogManager *log;                                                // nullptr while nothing is logged
+
+        std::condition_variable loaded;                                 // a read into a loading frame finished
+        std::condition_variable appended;                               // an append cleared its file's appending
+        std::condition_variable prefetchSubmitted;                      // the reaper has work
+        AsyncIOBackend *prefetchBackend;                                // created on the first read-ahead
+        std::vector<IORequest> prefetchRequests;                        // one per frame
+        std::deque<QueuedPrefetch> prefetchQueue;                       // waiting for a slot
+        unsigned prefetchInFlight;
+        bool stopping;
+        std::thread reaper;
+
+        std::condition_variable flushWanted;                            // sync() was called or the interval changed
+        std::condition_variable flushDone;                              // a flush cycle finished
+        unsigned flushIntervalMs;
+        unsigned long long flushRequested;                              // latest sync() generation
+        unsigned long long flushCompleted;                              // generation covered by the last cycle
+        bool flushInProgress;                                           // the flusher writes outside the latch
+        RC flushResult;
+        unsigned syncCount;
+        unsigned cycleCount;
+        std::thread flusher;
+
+        static unsigned long long pageKey(unsigned fileId, PageNum pageNum);
+
+        RC allocateFrames();
+        FramePool *findPoolLocked(unsigned pageSize);
+        RC addPoolLocked(unsigned pageSize);
+        void releaseFrames();
+        RC findVictim(FramePool &pool, unsigned &frameId, LSN &logLsn);
+        RC findRingVictim(unsigned ring, FramePool &pool, unsigned &frameId, bool &inRing, LSN &logLsn);
+        RC evictFrameLocked(FramePool &pool, Frame &frame);
+        void touchFrameLocked(Frame &frame, unsigned ring);
+        RC installPage(unsigned fileId, PageNum pageNum, unsigned &frameId, unsigned ring, LSN &logLsn);
+        RC writeFrame(Frame &frame);
+        bool logPendingLocked(const Frame &frame);
+        RC flushLogLocked(std::unique_lock<std::mutex> &lock, LSN lsn);
+        RC forceLogLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, bool &waited);
+        RC loadFrameLocked(std::unique_lock<std::mutex> &lock, FileEntry &file, unsigned frameId);
+        RC appendLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, unsigned count, const void *data,
+                        PageNum &pageNum, unsigned &extents);
+        void pinFramesLocked(const std::vector<unsigned> &frameIds, bool pin);
+        RC writePageLocked(FileEntry &file, PageNum pageNum, const char *data);
+        RC flushFileLocked(unsigned fileId);
+        void dropFileLocked(unsigned fileId);
+        unsigned reserveLocked(FileEntry &file, unsigned numPages);
+        RC trimLocked(FileEntry &file);
+        void waitForLoadLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, PageNum pageNum,
+                               unsigned count);
+        void issuePrefetchesLocked();
+        void waitForPrefetchesLocked(std::unique_lock<std::mutex> &lock);
+        void reapPrefetches();
+        void runFlusher();
+        RC flushDirtyPages(std::unique_lock<std::mutex> &lock, LSN &redoLsn, bool &more);
+        void waitForFlusherLocked(std::unique_lock<std::mutex> &lock);
+
+        BufferPoolManager(const BufferPoolManager &);                       // Prevent construction by copying
+        BufferPoolManager &operator=(const BufferPoolManager &);            // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _bpm_h_
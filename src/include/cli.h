@@ -154,6 +154,9 @@ namespace PeterDB {
         insertTupleToDB(const std::string& tableName, const std::vector<PeterDB::Attribute>& attributes, const void *data,
                         const std::unordered_map<int, void *>& indexMap);
 
+        RC insertTuplesToDB(const std::string& tableName, const std::vector<char>& tuples,
+                            const std::vector<size_t>& offsets);
+
         RC getAttribute(const std::string& name, const std::vector<PeterDB::Attribute>& pool, PeterDB::Attribute &attr);
 
         PeterDB::RelationManager &rm = PeterDB::RelationManager::instance();
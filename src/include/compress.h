@@ -0,0 +1,69 @@
+#ifndef _compress_h_
+#define _compress_h_
+
+#include <vector>
+
+#include "pfm.h"
+
+#define PFM_COMPRESSED_HEADER_OFFSET 256    // the compressed file descriptor inside the hidden header page
+#define PFM_COMPRESSED_SLOT_ALIGN 64        // slots grow in these steps, so a slightly worse page still fits in place
+
+namespace PeterDB {
+
+    // PageCodec is a byte-oriented LZ77 block codec in the format family of LZ4: each sequence is a token
+    // (literal length, match length), the literals, and a two-byte backward offset of the match. It needs no
+    // entropy stage, so pages decompress at memory speed; runs of zeros, repeated field layouts and the
+    // unused middle of a slotted page shrink to a few bytes.
+    class PageCodec {
+    public:
+        static unsigned compress(const char *source, unsigned size, char *target,
+                                 unsigned capacity);                        // Compressed size, 0 if it does not fit
+        static RC decompress(const char *source, unsigned size, char *target,
+                             unsigned targetSize);                          // Fails unless exactly targetSize results
+
+    private:
+        PageCodec() = default;                                              // Prevent construction
+    };
+
+    // Where a page is stored in a compressed file.
+    typedef struct PageSlot {
+        unsigned long long offset;  // byte offset of the slot in the file
+        unsigned length;            // bytes used; pageSize means the page is stored uncompressed
+        unsigned capacity;          // bytes reserved, a multiple of PFM_COMPRESSED_SLOT_ALIGN
+    } PageSlot;
+
+    // CompressedFile stores the pages of one file compressed, in variable-size slots after the header page.
+    // The page-number-to-slot map lives in map blocks of one page each, chained from the header; every block
+    // covers a fixed range of page numbers and is rewritten in place, so the map costs one block write per
+    // range touched since the last sync. A page that no longer fits its slot moves to the end of the file.
+    // The buffer pool owns the CompressedFile of a registered file and calls it under its latch.
+    class CompressedFile {
+    public:
+        static RC format(int fd, unsigned pageSize);                        // Write an empty map into a new file
+        static CompressedFile *open(int fd, unsigned pageSize);             // Load the map, nullptr if invalid
+
+        unsigned getNumberOfPages() const;
+        RC readPage(PageNum pageNum, void *data);                           // Read and decompress a page
+        RC writePage(PageNum pageNum, const void *data);                    // Compress and store a page
+        RC appendPage(const void *data, PageNum &pageNum);                  // Add a page at the end
+        RC sync();                                                          // Write the changed parts of the map
+
+    private:
+        int fd;
+        unsigned pageSize;
+        unsigned slotsPerBlock;                                             // map entries per map block
+        unsigned long long dataEnd;                                         // where the next slot goes
+        std::vector<PageSlot> slots;                                        // one per page
+        std::vector<unsigned long long> mapBlocks;                          // offsets of the map blocks, in order
+        std::vector<bool> dirtyBlocks;
+        bool headerDirty;
+        std::vector<char> buffer;                                           // compressed image scratch space
+
+        CompressedFile(int fd, unsigned pageSize);
+        CompressedFile(const CompressedFile &);                             // Prevent construction by copying
+        CompressedFile &operator=(const CompressedFile &);                  // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _compress_h_
@@ -0,0 +1,62 @@
+#ifndef _fsm_h_
+#define _fsm_h_
+
+#include <string>
+#include <vector>
+
+#include "pfm.h"
+
+#define FSM_FILE_SUFFIX ".fsm"              // the map of a record-based file is stored next to it under this name
+#define FSM_CATEGORIES 256                  // free-space buckets per page, one byte of the map each
+
+namespace PeterDB {
+
+    // FreeSpaceMap records, for every page of a record-based file, how much room the page has left, so an
+    // insert finds a page that fits without probing pages one by one. A page's free space is kept as one of
+    // FSM_CATEGORIES buckets of pageSize / FSM_CATEGORIES bytes, rounded down, so a page in a bucket always
+    // has at least the room the bucket promises.
+    // The buckets are stored one byte per data page in the pages of a companion paged file (after its own
+    // header page), which keeps the data file's page numbers and page count unchanged. In memory they are the
+    // leaves of a max-tree: every inner node holds the largest bucket below it, so a fitting page is found,
+    // and a changed page propagated, in O(log n).
+    // The map is a hint: its pages are not logged, and an insert checks the page itself before using it.
+    // A map whose page count disagrees with the data file is rebuilt by the caller, see open.
+    class FreeSpaceMap {
+    public:
+        FreeSpaceMap();
+        ~FreeSpaceMap();
+
+        static std::string fileNameOf(const std::string &fileName);         // The map file of a data file
+
+        RC open(const std::string &fileName, unsigned pageSize, unsigned numPages,
+                bool &rebuild);                                             // Load a map; rebuild means it is
+                                                                            // empty and every page must be set
+        RC close();                                                         // Write the page count and close
+        bool isOpen() const;
+
+        RC findPage(unsigned length, PageNum &pageNum);                     // A page with length bytes free,
+                                                                            // the last page first; -1 if none
+        RC setFreeSpace(PageNum pageNum, unsigned freeBytes);               // A page past the end extends the map
+        unsigned getNumberOfPages() const;
+
+    private:
+        FileHandle mapHandle;                                               // the companion file
+        bool loaded;                                                        // open succeeded, close not yet called
+        unsigned pageSize;                                                  // of the data file
+        unsigned numPages;                                                  // data pages the map covers
+        unsigned leaves;                                                    // a power of two, at least numPages
+        std::vector<unsigned char> tree;                                    // node i has children 2i and 2i+1;
+                                                                            // leaves + p holds page p
+
+        unsigned category(unsigned freeBytes) const;
+        void grow(unsigned minLeaves);
+        RC writeHeader(bool clean);
+        RC writeEntry(PageNum pageNum, unsigned char entry);
+
+        FreeSpaceMap(const FreeSpaceMap &);                                 // Prevent construction by copying
+        FreeSpaceMap &operator=(const FreeSpaceMap &);                      // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _fsm_h_
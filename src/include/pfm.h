@@ -1,52 +1,214 @@
 #ifndef _pfm_h_
 #define _pfm_h_
 
-#define PAGE_SIZE 4096
+#define PAGE_SIZE 4096                      // default page size of new files
 
+#define PFM_MIN_PAGE_SIZE 4096              // a file may use any power of two in between, see createFile
+#define PFM_MAX_PAGE_SIZE 65536
+
+#define PFM_READ_AHEAD_MIN 4                // initial read-ahead window, in pages
+#define PFM_READ_AHEAD_MAX 64               // the window doubles up to this size while access stays sequential
+#define PFM_SCAN_RING_THRESHOLD 32          // pages pinned in order before a handle switches to its scan ring
+
+#define PFM_FILE_CACHE_SIZE 64              // closed files kept open for the next openFile of the same name
+
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <cstddef>
 
 namespace PeterDB {
 
     typedef unsigned PageNum;
+    typedef unsigned long long LSN;         // log sequence number: the offset of a record in the write-ahead log
     typedef int RC;
 
     class FileHandle;
 
+    class BufferPoolManager;
+
+    class AsyncFileIO;
+
+    struct OpenFileCache;
+
+    // Closing a file keeps it open in a cache of idle files, keyed by name and bounded by PFM_FILE_CACHE_SIZE,
+    // so reopening it skips open/read-header/close and its pages stay registered in the buffer pool. The
+    // header counters are written and the descriptor closed when the least recently closed file is evicted,
+    // when the file is destroyed, or when the manager shuts down.
     class PagedFileManager {
     public:
         static PagedFileManager &instance();                                // Access to the singleton instance
 
         RC createFile(const std::string &fileName);                         // Create a new file
+        RC createFile(const std::string &fileName, unsigned pageSize);      // Create a file with its own page size
+        RC createCompressedFile(const std::string &fileName,
+                                unsigned pageSize = PAGE_SIZE);             // Create a file of compressed pages
         RC destroyFile(const std::string &fileName);                        // Destroy a file
         RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a file
+        RC openFileMapped(const std::string &fileName, FileHandle &fileHandle); // Open a file read-only via mmap
         RC closeFile(FileHandle &fileHandle);                               // Close a file
 
+        BufferPoolManager &bufferPool();                                    // The page cache shared by all FileHandles
+        RC setBufferPoolSize(unsigned numFrames);                           // Flush and resize the page cache
+        RC setFlushInterval(unsigned milliseconds);                         // Background write-back period, 0 = off
+        RC setExtentSize(unsigned bytes);                                   // Space reserved per file growth, 0 = off
+        RC setFileCacheSize(unsigned numFiles);                             // Idle files kept open, 0 = off
+        RC collectFileCacheCounterValues(unsigned &openCount, unsigned &hitCount,
+                                         unsigned &evictCount);             // File opens, cache hits, evictions
+
     protected:
         PagedFileManager();                                                 // Prevent construction
         ~PagedFileManager();                                                // Prevent unwanted destruction
         PagedFileManager(const PagedFileManager &);                         // Prevent construction by copying
         PagedFileManager &operator=(const PagedFileManager &);              // Prevent assignment
 
+    private:
+        BufferPoolManager *bpm;
+        OpenFileCache *openFiles;
+
+        RC createFileWithFlags(const std::string &fileName, unsigned pageSize, unsigned flags);
+        RC evictFileLocked(unsigned fileId);
+        void forgetFileLocked(const std::string &fileName);
+        bool findFileLocked(const std::string &fileName, unsigned &fileId);
+
+    };
+
+    // PageGuard keeps a page pinned in the buffer pool and points directly into its cached frame,
+    // so callers can read the page in place instead of copying it into their own buffer.
+    // The page is unpinned when the guard is released, reassigned or destroyed.
+    class PageGuard {
+    public:
+        PageGuard();
+        ~PageGuard();
+        PageGuard(PageGuard &&other) noexcept;
+        PageGuard &operator=(PageGuard &&other) noexcept;
+
+        const char *data() const;                                           // The pinned page, a full page
+        PageNum getPageNum() const;                                         // The page number of the pinned page
+        bool isPinned() const;                                              // Whether the guard holds a page
+        void release();                                                     // Unpin the page early
+
+    protected:
+        friend class FileHandle;
+
+        char *frame;
+        PageNum pageNum;
+        unsigned frameId;
+        bool dirty;                                                         // Mark the frame dirty on release
+        bool mapped;                                                        // Points into a file mapping, no pin
+        LSN lsn;                                                            // Latest logged change, see setLsn
+
+        PageGuard(const PageGuard &);                                       // Prevent copying a pin
+        PageGuard &operator=(const PageGuard &);                            // Prevent copying a pin
+    };
+
+    // WritePageGuard is the write-intent variant: the frame may be modified in place and is marked dirty.
+    // A caller that logs its change passes the record's LSN to setLsn; the frame is then not written back
+    // before the log is durable up to it.
+    class WritePageGuard : public PageGuard {
+    public:
+        WritePageGuard() = default;
+        WritePageGuard(WritePageGuard &&other) noexcept = default;
+        WritePageGuard &operator=(WritePageGuard &&other) noexcept = default;
+
+        char *data();                                                       // The pinned page, a full page
+        void setLsn(LSN lsn);                                               // The change was logged at lsn
     };
 
+    // How a FileHandle's pages should be cached, see FileHandle::setAccessPattern.
+    typedef enum {
+        PFM_ACCESS_DEFAULT = 0,     // shared pool; a long sequential run moves to a scan ring
+        PFM_ACCESS_SEQUENTIAL,      // always a scan ring: table scans, sort runs, join partitions
+        PFM_ACCESS_RANDOM           // always the shared pool: B+tree nodes, catalog pages
+    } AccessPattern;
+
+    // Per-handle detector of sequential access that drives read-ahead into the buffer pool.
+    typedef struct ReadAheadState {
+        PageNum lastPageNum;        // page most recently pinned through the handle
+        PageNum nextPageNum;        // first page not yet requested by read-ahead
+        unsigned sequentialRun;     // consecutive pages pinned in order
+        unsigned window;            // pages kept requested ahead of the reader, 0 while idle
+    } ReadAheadState;
+
+    // An open FileHandle may be shared by several threads: all page I/O is positional and goes through the
+    // buffer pool, which serializes appends, and the counters are atomic. Opening and closing are not
+    // synchronized with other calls on the same handle.
     class FileHandle {
     public:
         // variables to keep the counter for each operation
-        unsigned readPageCounter;
-        unsigned writePageCounter;
-        unsigned appendPageCounter;
+        std::atomic<unsigned> readPageCounter;
+        std::atomic<unsigned> writePageCounter;
+        std::atomic<unsigned> appendPageCounter;
+
+        // variables to keep the buffer pool hit/miss counter for readPage
+        std::atomic<unsigned> cacheHitCounter;
+        std::atomic<unsigned> cacheMissCounter;
+
+        // variable to keep the number of pages requested by read-ahead
+        std::atomic<unsigned> prefetchPageCounter;
+
+        // variable to keep the number of extents preallocated for appends
+        std::atomic<unsigned> extentCounter;
 
         FileHandle();                                                       // Default constructor
         ~FileHandle();                                                      // Destructor
+        FileHandle(const FileHandle &other);                                // Copy the counters; the copy is closed
+        FileHandle &operator=(const FileHandle &other);                     // Assign the counters only
 
         RC readPage(PageNum pageNum, void *data);                           // Get a specific page
         RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
         RC appendPage(const void *data);                                    // Append a specific page
+        RC readPages(PageNum pageNum, unsigned count, void *data);          // Get consecutive pages in one read
+        RC writePages(PageNum pageNum, unsigned count, const void *data);   // Write consecutive pages in one write
+        RC appendPages(unsigned count, const void *data);                   // Append consecutive pages in one write
         unsigned getNumberOfPages();                                        // Get the number of pages in the file
+        unsigned getPageSize() const;                                       // Page size recorded in the file header
+        const std::string &getFileName() const;                             // The name the file was opened by
+        RC pinPage(PageNum pageNum, PageGuard &guard);                      // Pin a page for reading in place
+        RC pinPageForWrite(PageNum pageNum, WritePageGuard &guard);         // Pin a page for updating in place
+        RC pinPageNoReadAhead(PageNum pageNum, PageGuard &guard);           // As pinPage, for sorted lookups that
+                                                                            // read ahead would only waste
+        RC prefetchPage(PageNum pageNum);                                   // Hint the next page of a chain walk
+        RC setAccessPattern(AccessPattern pattern);                         // Choose how pages are cached
+        RC flush();                                                         // Make all written pages durable
         RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                                 unsigned &appendPageCount);                 // Put current counter values into variables
+        RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount,
+                                unsigned &extentCount,
+                                unsigned &reservedPageCount);               // Also report preallocated extents
+        RC collectCacheCounterValues(unsigned &hitCount,
+                                     unsigned &missCount);                  // Put buffer pool hit/miss counts into variables
+
+    private:
+        friend class PagedFileManager;
+        friend class AsyncFileIO;
+
+        int fd;                                                             // -1 when the handle is not open
+        unsigned fileId;                                                    // Key of this file in the buffer pool
+        std::string fileName;                                               // As passed to openFile
+        unsigned pageSize;                                                  // Bytes per page, from the file header
+        bool compressed;                                                    // Pages are stored compressed
+        std::mutex latch;                                                   // Guards readAhead, scanRing, mapping
+        ReadAheadState readAhead;
+        AccessPattern accessPattern;
+        unsigned scanRing;                                                  // Buffer pool ring, 0 until first needed
+
+        // Read-only mapped mode, see PagedFileManager::openFileMapped; the pool is bypassed.
+        bool mapped;                                                        // Fixed while the handle is open
+        char *mapping;                                                      // nullptr unless opened mapped
+        size_t mappingSize;
+        PageNum adviseNextPageNum;                                          // first page not yet hinted WILLNEED
+        std::vector<std::pair<char *, size_t> > retiredMappings;            // outgrown, unmapped on close
+
+        void copyCounters(const FileHandle &other);
+        RC pinFrame(PageNum pageNum, PageGuard &guard, bool forWrite, bool readAhead);
+        void detectSequentialAccess(PageNum pageNum);
+        unsigned scanRingLocked();
+        unsigned getNumberOfMappedPagesLocked();
+        const char *mappedPageLocked(PageNum pageNum);
     };
 
 } // namespace PeterDB
 
-#endif // _pfm_h_
\ No newline at end of file
+#endif // _pfm_h_
@@ -4,13 +4,16 @@
 #include <vector>
 #include <string>
 #include <limits>
+#include <cstring>
 
 #include "rm.h"
 #include "ix.h"
+#include "arena.h"
 
 namespace PeterDB {
 
 #define QE_EOF (-1)  // end of the index scan
+#define QE_INDEX_SCAN_BATCH 1024  // index entries IndexScan resolves with one RelationManager::readTuples
     typedef enum AggregateOp {
         MIN = 0, MAX, COUNT, SUM, AVG
     } AggregateOp;
@@ -45,6 +48,8 @@ namespace PeterDB {
 
     class TableScan : public Iterator {
         // A wrapper inheriting Iterator over RM_ScanIterator
+        // Conditions comparing an attribute with a value are pushed into the scan, where they are tested on
+        // the page, instead of filtering the full tuples above it.
     private:
         RelationManager &rm;
         RM_ScanIterator iter;
@@ -52,6 +57,17 @@ namespace PeterDB {
         std::vector<Attribute> attrs;
         std::vector<std::string> attrNames;
         RID rid;
+        std::vector<AttributeCondition> conditions;
+        std::vector<std::vector<char> > conditionValues;                    // owned copies the conditions point to
+
+        void startScan() {
+            if (conditions.empty()) {
+                rm.scan(tableName, "", NO_OP, NULL, attrNames, iter);
+            } else {
+                rm.scan(tableName, conditions, attrNames, iter);
+            }
+        };
+
     public:
         TableScan(RelationManager &rm, const std::string &tableName, const char *alias = NULL) : rm(rm) {
             //Set members
@@ -73,10 +89,42 @@ namespace PeterDB {
             if (alias) this->tableName = alias;
         };
 
+        // Scan only the tuples that satisfy all the conditions, each comparing an attribute of the table, named
+        // attr or rel.attr, with a value. A condition between two attributes is left to a Filter and ignored.
+        TableScan(RelationManager &rm, const std::string &tableName, const std::vector<Condition> &conditions,
+                  const char *alias = NULL) : rm(rm) {
+            this->tableName = tableName;
+            rm.getAttributes(tableName, attrs);
+            for (const Attribute &attr : attrs) {
+                attrNames.push_back(attr.name);
+            }
+
+            std::string prefix = std::string(alias ? alias : tableName.c_str()) + ".";
+            conditionValues.resize(conditions.size());
+            for (size_t i = 0; i < conditions.size(); i++) {
+                const Condition &condition = conditions[i];
+                if (condition.bRhsIsAttr) continue;
+                std::string name = condition.lhsAttr;
+                if (name.compare(0, prefix.size(), prefix) == 0) name = name.substr(prefix.size());
+
+                unsigned length = sizeof(int);
+                if (condition.rhsValue.type == TypeVarChar) {
+                    memcpy(&length, condition.rhsValue.data, sizeof(unsigned));
+                    length += sizeof(unsigned);
+                }
+                const char *value = (const char *) condition.rhsValue.data;
+                conditionValues[i].assign(value, value + length);
+                this->conditions.push_back(AttributeCondition{name, condition.op, conditionValues[i].data()});
+            }
+
+            startScan();
+            if (alias) this->tableName = alias;
+        };
+
         // Start a new iterator given the new compOp and value
         void setIterator() {
             iter.close();
-            rm.scan(tableName, "", NO_OP, NULL, attrNames, iter);
+            startScan();
         };
 
         RC getNextTuple(void *data) override {
@@ -101,14 +149,33 @@ namespace PeterDB {
 
     class IndexScan : public Iterator {
         // A wrapper inheriting Iterator over IX_IndexScan
+        // Index entries are collected QE_INDEX_SCAN_BATCH at a time and their tuples fetched with one
+        // readTuples call, which reads every heap page once instead of once per entry.
     private:
         RelationManager &rm;
         RM_IndexScanIterator iter;
         std::string tableName;
         std::string attrName;
         std::vector<Attribute> attrs;
-        char key[PAGE_SIZE];
+        ArenaBuffer key;
         RID rid;
+        std::vector<RID> rids;              // the entries of the current batch
+        std::vector<char> tuples;           // their tuples, see RelationManager::readTuples
+        std::vector<size_t> offsets;
+        size_t next = 0;                    // the next tuple of the batch to return
+        RC endRc = 0;                       // what the index iterator returned after the batch
+
+        // Collect the next batch of entries and fetch their tuples.
+        RC fetchBatch() {
+            rids.clear();
+            next = 0;
+            while (endRc == 0 && rids.size() < QE_INDEX_SCAN_BATCH) {
+                endRc = iter.getNextEntry(rid, key.data());
+                if (endRc == 0) rids.push_back(rid);
+            }
+            if (rids.empty()) return endRc;
+            return rm.readTuples(tableName, rids, tuples, offsets);
+        };
     public:
         IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName,
                   const char *alias = NULL) : rm(rm) {
@@ -130,14 +197,23 @@ namespace PeterDB {
         void setIterator(void *lowKey, void *highKey, bool lowKeyInclusive, bool highKeyInclusive) {
             iter.close();
             rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, iter);
+            rids.clear();
+            next = 0;
+            endRc = 0;
         };
 
         RC getNextTuple(void *data) override {
-            RC rc = iter.getNextEntry(rid, key);
-            if (rc == 0) {
-                rc = rm.readTuple(tableName, rid, data);
+            if (next == rids.size()) {
+                RC rc = fetchBatch();
+                if (rc != 0) {
+                    rids.clear();
+                    next = 0;
+                    return rc;
+                }
             }
-            return rc;
+            memcpy(data, tuples.data() + offsets[next], offsets[next + 1] - offsets[next]);
+            next++;
+            return 0;
         };
 
         RC getAttributes(std::vector<Attribute> &attributes) const override {
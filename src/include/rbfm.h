@@ -4,8 +4,19 @@
 #include <vector>
 
 #include "pfm.h"
+#include "wal.h"
+
+#define RBFM_BATCH_PAGES 64                 // pages insertRecords fills in memory before writing them at once
+#define RBFM_SCAN_REORDER_RECORDS 1024      // records a conjunctive scan tests between reorderings of its conditions
+#define RBFM_SCAN_BATCH_ROWS 1024           // rows a RecordBatch holds unless its capacity is set otherwise
 
 namespace PeterDB {
+    class FreeSpaceMap;
+
+    class ZoneMap;
+
+    struct FreeSpaceMaps;
+
     // Record ID
     typedef struct {
         unsigned pageNum;           // page number
@@ -52,6 +63,74 @@ namespace PeterDB {
     //  }
     //  rbfmScanIterator.close();
 
+    // Compares a stored field, length bytes at field, with the value of a scan condition; see ScanCondition.
+    typedef bool (*FieldComparator)(const char *field, unsigned length, const char *value);
+
+    // Whether no value from min to max, the bounds of an Int or Real attribute over a page, can satisfy a scan
+    // condition; see ZoneMap.
+    typedef bool (*ZoneTest)(const char *min, const char *max, const char *value);
+
+    // One condition of a conjunctive scan: attribute compOp value, value in the format of a record field.
+    typedef struct AttributeCondition {
+        std::string attribute;
+        CompOp compOp;
+        const void *value;
+    } AttributeCondition;
+
+    // A scan condition compiled once when the scan starts: the attribute is resolved to its field index and
+    // the comparison to a comparator specialised for the attribute type and operator, so records are tested
+    // on the page without looking anything up. A NULL field never qualifies.
+    // The conditions of a scan are tested cheapest-to-reject first: tested and passed start from an estimate
+    // for the operator and count the scan's own records, and every RBFM_SCAN_REORDER_RECORDS records the
+    // conditions are sorted again by how often they reject a record per unit of cost.
+    // A condition on an Int or Real attribute also has a test of the attribute's bounds over a page, which
+    // passes over pages the file's zone map shows have no qualifying record.
+    typedef struct ScanCondition {
+        unsigned field;                     // index of the condition attribute in the record descriptor
+        FieldComparator compare;
+        ZoneTest excludes;                  // nullptr for a VarChar
+        int zone;                           // of the attribute in the zone map; -1 when there is none
+        std::vector<char> value;            // the comparison value, in the format of a record field
+        unsigned fieldEndAt;                // where in a stored record the field's end offset is kept
+        unsigned cost;                      // relative cost of a test; VarChars compare bytes
+        unsigned tested;                    // records tested, including the estimate
+        unsigned passed;                    // of which qualified
+    } ScanCondition;
+
+    // One output field of a scan, resolved when the scan starts: where its null bit and end offset lie in a
+    // stored record, and which null bit it gets in the output, so it is copied straight from the page.
+    typedef struct ProjectedField {
+        unsigned field;                     // index in the record descriptor
+        bool varChar;                       // copied out with its length in front
+        unsigned nullByte;                  // null indicator in a stored record: byte and mask
+        unsigned char nullMask;
+        unsigned fieldEndAt;                // where in a stored record the field's end offset is kept
+        unsigned outNullByte;               // null indicator in the output: byte and mask
+        unsigned char outNullMask;
+    } ProjectedField;
+
+    // One projected attribute of a RecordBatch, as a column. Ints and Reals are dense arrays with an entry
+    // for every row, 0 for NULL; VarChar row r is bytes[offsets[r]] up to bytes[offsets[r + 1]], empty for
+    // NULL. Bit r of nulls, counted as in the record null indicators (0x80 >> r % 8 of byte r / 8), is set
+    // when row r is NULL.
+    typedef struct ColumnVector {
+        AttrType type;
+        std::vector<int> ints;              // TypeInt only
+        std::vector<float> reals;           // TypeReal only
+        std::vector<unsigned> offsets;      // TypeVarChar only, one more than the rows
+        std::vector<char> bytes;            // TypeVarChar only
+        std::vector<unsigned char> nulls;
+    } ColumnVector;
+
+    // Scanned records in columns, see RBFM_ScanIterator::getNextBatch: row r has RID rids[r], and its j-th
+    // projected attribute is in columns[j]. The vectors are reused from batch to batch.
+    typedef struct RecordBatch {
+        unsigned capacity = RBFM_SCAN_BATCH_ROWS;                           // rows getNextBatch fills at most
+        unsigned rows = 0;
+        std::vector<RID> rids;
+        std::vector<ColumnVector> columns;
+    } RecordBatch;
+
     class RBFM_ScanIterator {
     public:
         RBFM_ScanIterator() = default;;
@@ -61,9 +140,44 @@ namespace PeterDB {
         // Never keep the results in the memory. When getNextRecord() is called,
         // a satisfying record needs to be fetched from the file.
         // "data" follows the same format as RecordBasedFileManager::insertRecord().
-        RC getNextRecord(RID &rid, void *data) { return RBFM_EOF; };
-
-        RC close() { return -1; };
+        RC getNextRecord(RID &rid, void *data);
+
+        // Fill batch with the next batch.capacity qualifying records at most, copied column by column straight
+        // from the pages, so an operator can loop over a column instead of decoding rows one call at a time.
+        // Returns RBFM_EOF when no record is left. A batch of capacity 0 is given RBFM_SCAN_BATCH_ROWS.
+        RC getNextBatch(RecordBatch &batch);
+
+        unsigned getSkippedPages() const;                                   // Pages passed over unread so far
+
+        RC close();
+
+    private:
+        friend class RecordBasedFileManager;
+
+        FileHandle *fileHandle = nullptr;                                   // nullptr when closed
+        std::vector<Attribute> recordDescriptor;
+        unsigned fieldCount = 0;                                            // of the descriptor; records with
+                                                                            // other counts take the slow path
+        unsigned valuesAt = 0;                                              // where in such a record field 0 starts
+        std::vector<ScanCondition> conditions;                              // all must hold; none for NO_OP
+        unsigned untilReorder = 0;                                          // records until conditions are sorted
+        std::vector<ProjectedField> projection;
+        unsigned outNullBytes = 0;                                          // null indicators of the output
+        PageNum pageNum = 0;                                                // the page being scanned
+        unsigned slotNum = 0;                                               // the next slot to look at
+        PageGuard guard;                                                    // pins pageNum between calls
+        ZoneMap *zoneMap = nullptr;                                         // nullptr when the file's map is
+                                                                            // for another descriptor
+        unsigned skippedPages = 0;
+
+        RC pinScanPage();
+        bool skipPage() const;
+        RC rebuildZone();
+        RC slotRecord(unsigned current, const char *&record, PageGuard &moved);
+        bool qualifies(const char *record);
+        void reorderConditions();
+        void project(const char *record, char *data);
+        void append(const char *record, RecordBatch &batch);
     };
 
     class RecordBasedFileManager {
@@ -71,6 +185,7 @@ namespace PeterDB {
         static RecordBasedFileManager &instance();                          // Access to the singleton instance
 
         RC createFile(const std::string &fileName);                         // Create a new record-based file
+        RC createFile(const std::string &fileName, unsigned pageSize);      // Create one with larger pages
 
         RC destroyFile(const std::string &fileName);                        // Destroy a record-based file
 
@@ -97,10 +212,22 @@ namespace PeterDB {
         RC insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const void *data,
                         RID &rid);
 
+        // Insert a batch of records, each in the format above, for bulk loading. The records fill the last
+        // page and then new pages in memory, and every page is written once, new pages RBFM_BATCH_PAGES at a
+        // time; rids[i] is the RID of batch[i]. Nothing is written if a record is too large for a page.
+        RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                         const std::vector<const void *> &batch, std::vector<RID> &rids);
+
         // Read a record identified by the given rid.
         RC
         readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
 
+        // Read many records at once, as for the RIDs of an index range: every page is read once, however many
+        // of the RIDs it holds and in whatever order they come. Tuple i, in the format of readRecord, is
+        // data[offsets[i]] up to data[offsets[i + 1]]; offsets has one entry more than rids.
+        RC readRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                       const std::vector<RID> &rids, std::vector<char> &data, std::vector<size_t> &offsets);
+
         // Print the record that is passed to this utility method.
         // This method will be mainly used for debugging/testing.
         // The format is as follows:
@@ -133,12 +260,42 @@ namespace PeterDB {
                 const std::vector<std::string> &attributeNames, // a list of projected attributes
                 RBFM_ScanIterator &rbfm_ScanIterator);
 
+        // Scan for the records that satisfy all the conditions, tested on the page in the order that rejects
+        // records soonest, see ScanCondition. No conditions return every record. Pages that the zone map shows
+        // hold no qualifying record are not read; see RBFM_ScanIterator::getSkippedPages.
+        RC scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                const std::vector<AttributeCondition> &conditions, const std::vector<std::string> &attributeNames,
+                RBFM_ScanIterator &rbfm_ScanIterator);
+
+        // Recovery: reapply a logged change to a page pinned for write. A change the page already holds,
+        // judged by the page LSN, is skipped and applied is left false.
+        RC redoChange(char *page, unsigned pageSize, const LogRecordHeader &header, const char *payload,
+                      bool &applied);
+
+        LSN getPageLsn(const char *page, unsigned pageSize);                // LSN of the last change the page holds
+
+        // Insert finds a page with room through a free-space map kept next to the file, see FreeSpaceMap.
+        // The map is loaded by the first change to a file and closed with the file's last handle; recovery
+        // resets the map of a file it changed, and the next change rebuilds it from the pages.
+        RC resetFreeSpaceMap(const std::string &fileName);                  // Drop the map; rebuilt on next use
+
+        // Scans pass over pages through a zone map kept next to the file, see ZoneMap. It is for the descriptor
+        // of the latest change, is loaded like the free-space map, and learns about a page again when a scan
+        // reads it after a reset.
+        RC resetZoneMap(const std::string &fileName);                       // Drop the map; every page unknown
+
     protected:
         RecordBasedFileManager();                                                   // Prevent construction
         ~RecordBasedFileManager();                                                  // Prevent unwanted destruction
         RecordBasedFileManager(const RecordBasedFileManager &);                     // Prevent construction by copying
         RecordBasedFileManager &operator=(const RecordBasedFileManager &);          // Prevent assignment
 
+    private:
+        FreeSpaceMaps *spaceMaps;
+
+        RC freeSpaceMap(FileHandle &fileHandle, FreeSpaceMap *&map);
+        RC zoneMap(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, bool change,
+                   ZoneMap *&map);
     };
 
 } // namespace PeterDB
@@ -0,0 +1,49 @@
+#ifndef _recovery_h_
+#define _recovery_h_
+
+#include <string>
+
+#include "rbfm.h"
+#include "wal.h"
+
+namespace PeterDB {
+
+    // RecoveryManager brings record-based files back to the state of the log after a crash, then opens the
+    // log for new records. Changes are redone only: records are made durable when their operation returns,
+    // and there are no transactions to roll back.
+    // Analysis runs once over the log tail, from the redo LSN of the last checkpoint: it collects the file
+    // names and hands every page change to one of numThreads partitions by hashing (file, page), so all the
+    // changes of a page land in the same partition, in LSN order. The partitions are redone in parallel,
+    // each pinning a page once for all of its changes; a change the page LSN shows to be on disk already is
+    // skipped. The pages are then written back and synced, and a checkpoint marks the log as replayed.
+    class RecoveryManager {
+    public:
+        static RecoveryManager &instance();                                 // Access to the singleton instance
+
+        RC restart(const std::string &logFileName, bool syncCommit = true,
+                   unsigned numThreads = 0);                                // Recover, then open the log; 0 threads
+                                                                            // means one per hardware thread
+
+        // Of the last restart: page changes read from the log, those redone, those skipped because the page
+        // already held them or its file is gone, and the pages that had to be changed.
+        RC collectCounterValues(unsigned &recordCount, unsigned &redoCount, unsigned &skipCount,
+                                unsigned &pageCount);
+
+    protected:
+        RecoveryManager();                                                  // Prevent construction
+        ~RecoveryManager();                                                 // Prevent unwanted destruction
+        RecoveryManager(const RecoveryManager &);                           // Prevent construction by copying
+        RecoveryManager &operator=(const RecoveryManager &);                // Prevent assignment
+
+    private:
+        unsigned recordCount;
+        unsigned redoCount;
+        unsigned skipCount;
+        unsigned pageCount;
+
+        RC recover(const std::string &logFileName, unsigned numThreads);
+    };
+
+} // namespace PeterDB
+
+#endif // _recovery_h_
@@ -50,12 +50,21 @@ namespace PeterDB {
 
         RC insertTuple(const std::string &tableName, const void *data, RID &rid);
 
+        // Insert many tuples at once through RecordBasedFileManager::insertRecords; rids[i] belongs to
+        // tuples[i]. Used by bulk loading.
+        RC insertTuples(const std::string &tableName, const std::vector<const void *> &tuples, std::vector<RID> &rids);
+
         RC deleteTuple(const std::string &tableName, const RID &rid);
 
         RC updateTuple(const std::string &tableName, const void *data, const RID &rid);
 
         RC readTuple(const std::string &tableName, const RID &rid, void *data);
 
+        // Read the tuples of many RIDs through RecordBasedFileManager::readRecords; tuple i is data[offsets[i]]
+        // up to data[offsets[i + 1]]. Used by IndexScan to fetch the RIDs of an index range in batches.
+        RC readTuples(const std::string &tableName, const std::vector<RID> &rids, std::vector<char> &data,
+                      std::vector<size_t> &offsets);
+
         // Print a tuple that is passed to this utility method.
         // The format is the same as printRecord().
         RC printTuple(const std::vector<Attribute> &attrs, const void *data, std::ostream &out);
@@ -71,6 +80,13 @@ namespace PeterDB {
                 const std::vector<std::string> &attributeNames, // a list of projected attributes
                 RM_ScanIterator &rm_ScanIterator);
 
+        // Scan with a conjunction of conditions, all tested on the page through RecordBasedFileManager::scan,
+        // so a query like Age > 30 AND Salary < 9000 needs no Filter above the scan.
+        RC scan(const std::string &tableName,
+                const std::vector<AttributeCondition> &conditions,
+                const std::vector<std::string> &attributeNames,
+                RM_ScanIterator &rm_ScanIterator);
+
         // Extra credit work (10 points)
         RC addAttribute(const std::string &tableName, const Attribute &attr);
 
@@ -0,0 +1,158 @@
+#ifndef _wal_h_
+#define _wal_h_
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "pfm.h"
+
+#define WAL_HEADER_SIZE 512                 // the log header; the first record starts right after it
+#define WAL_FLUSH_INTERVAL_MS 10            // longest an asynchronous commit stays volatile
+#define WAL_BUFFER_SIZE (1 << 20)           // appended bytes that wake the log writer before its interval
+#define WAL_CHECKPOINT_INTERVAL (16 << 20)  // log bytes between fuzzy checkpoints
+#define WAL_RECLAIM_ALIGN 4096              // the log before a redo LSN is given back in blocks of this size
+
+namespace PeterDB {
+
+    typedef enum {
+        WAL_FILE = 1,               // payload: the name of the file logFileId stands for from here on; a
+                                    // later WAL_FILE of the name means the earlier file was destroyed
+        WAL_PAGE_FORMAT,            // the page was initialized empty
+        WAL_RECORD_INSERT,          // payload: the stored record placed in slotNum
+        WAL_RECORD_UPDATE,          // payload: the new stored record (or tombstone) in slotNum
+        WAL_RECORD_DELETE,          // slotNum was freed
+        WAL_PAGE_IMAGE,             // payload: the whole page, for changes spanning the page structure
+        WAL_CHECKPOINT              // payload: where redo starts and the file names, see encodeCheckpoint
+    } LogRecordType;
+
+    // Every record starts with this header; length covers header and payload, and checksum covers
+    // everything after the checksum field, so a torn or stale tail is recognized when the log is opened.
+    typedef struct LogRecordHeader {
+        unsigned length;
+        unsigned checksum;
+        LSN lsn;                    // the record's own offset, which rules out stale bytes of a reused log
+        unsigned short type;
+        unsigned short slotNum;
+        unsigned logFileId;         // see WAL_FILE
+        PageNum pageNum;
+        unsigned reserved;
+    } LogRecordHeader;
+
+    // LogManager is the write-ahead log beneath RecordBasedFileManager. Page changes are logged
+    // physiologically: a record names the page and describes the change within it (a slot that was
+    // filled, rewritten or freed), and the page stores the LSN of the last record applied to it.
+    // Records are appended to a memory buffer; a log writer thread writes the buffer out and fdatasyncs the
+    // log, so every session waiting in commit() at that moment is made durable by the same fsync (group
+    // commit). With synchronous commits, RecordBasedFileManager waits for its records before returning;
+    // otherwise they become durable within WAL_FLUSH_INTERVAL_MS.
+    // The buffer pool enforces write-ahead ordering: a dirty frame remembers the LSN of its last change
+    // (WritePageGuard::setLsn) and is written back only after the log is durable up to that LSN.
+    // Checkpoints are fuzzy: after a flush cycle the buffer pool passes the oldest LSN whose change may still
+    // be missing from the data files, and the checkpoint record stores it as the point where redo starts,
+    // without writing a single page. The log header points to the last durable checkpoint, and the log before
+    // its redo LSN, which no restart reads again, is punched out of the file. LSNs stay file offsets, so the
+    // file keeps its size while its disk space follows the records restart may still replay.
+    class LogManager {
+    public:
+        static LogManager &instance();                                      // Access to the singleton instance
+
+        RC open(const std::string &logFileName, bool syncCommit = true);   // Start logging into a log file
+        RC close();                                                         // Make the log durable and stop
+        bool isOpen();
+
+        RC append(LogRecordType type, const std::string &fileName, PageNum pageNum, unsigned short slotNum,
+                  const void *payload, unsigned length, LSN &lsn);          // Buffer a record about a page
+        RC forgetFile(const std::string &fileName);                         // The file is gone; a new one of
+                                                                            // the name gets a new logFileId
+        RC commit(LSN lsn);                                                 // Wait until lsn is durable
+        RC flush(LSN lsn);                                                  // The same, not counted as a commit
+        RC commitIfSync(LSN lsn);                                           // Wait only with synchronous commits
+        LSN getDurableLsn();                                                // Records before this one are durable
+        LSN getEndLsn();                                                    // The LSN the next record gets
+        RC sync();                                                          // Make every appended record durable
+
+        RC checkpoint(LSN redoLsn);                                         // Log where redo starts and point to it
+        RC checkpointIfDue(LSN redoLsn);                                    // The same, once per checkpoint interval
+        void setCheckpointInterval(unsigned long long bytes);               // 0 leaves checkpoints to the caller
+
+        // Records appended, commit() calls, and fsyncs of the log; fsyncs well below commits mean the
+        // commits were grouped.
+        RC collectCounterValues(unsigned &recordCount, unsigned &commitCount, unsigned &syncCount);
+        RC collectCheckpointCounterValues(unsigned &checkpointCount, LSN &checkpointLsn, LSN &redoLsn);
+
+    protected:
+        LogManager();                                                       // Prevent construction
+        ~LogManager();                                                      // Prevent unwanted destruction
+        LogManager(const LogManager &);                                     // Prevent construction by copying
+        LogManager &operator=(const LogManager &);                          // Prevent assignment
+
+    private:
+        std::mutex latch;
+        std::mutex checkpointLatch;                                         // one checkpoint at a time
+        int fd;                                                             // -1 while the log is closed
+        bool syncCommit;
+        std::vector<char> buffer;                                           // records from bufferLsn on
+        std::vector<char> writing;                                          // the batch the writer is writing
+        LSN bufferLsn;                                                      // LSN of the first buffered byte
+        LSN durableLsn;                                                     // end of the durable part of the log
+        LSN requestedLsn;                                                   // commit() callers wait up to here
+        bool failed;                                                        // a write or fsync of the log failed
+        bool stopping;
+        std::unordered_map<std::string, unsigned> logFileIds;               // name -> logFileId, kept by checkpoints
+        unsigned nextLogFileId;
+        unsigned long long checkpointInterval;
+        LSN checkpointLsn;                                                  // the last durable checkpoint, or 0
+        LSN redoLsn;                                                        // where that checkpoint starts redo
+        LSN reclaimedLsn;                                                   // the log before it is a hole
+        unsigned checkpointCount;
+        unsigned recordCount;
+        unsigned commitCount;
+        unsigned syncCount;
+        std::condition_variable flushWanted;
+        std::condition_variable flushDone;
+        std::thread writer;
+
+        RC appendLocked(LogRecordType type, unsigned logFileId, PageNum pageNum, unsigned short slotNum,
+                        const void *payload, unsigned length, LSN &lsn);
+        void runWriter();
+    };
+
+    unsigned logChecksum(const void *data, size_t length);                  // CRC-32 of log record bytes
+
+    // A checkpoint payload: the redo LSN, then every logFileId in use with its file name.
+    void encodeCheckpoint(LSN redoLsn, const std::unordered_map<std::string, unsigned> &logFileIds,
+                          std::vector<char> &payload);
+    RC decodeCheckpoint(const char *payload, unsigned length, LSN &redoLsn,
+                        std::unordered_map<unsigned, std::string> &fileNames);
+
+    // LogReader loads the valid records of a log file from some LSN on: the log manager reads the tail
+    // after the last checkpoint to find where to append, and recovery reads it to replay it.
+    class LogReader {
+    public:
+        LogReader();
+        ~LogReader();
+
+        RC open(const std::string &logFileName);                            // Read the header of a log
+        LSN getCheckpointLsn() const;                                       // 0 if the log has no checkpoint
+        RC load(LSN lsn);                                                   // Read the records from lsn on
+        LSN getEndLsn() const;                                              // Where the valid records stop
+        const char *next(LogRecordHeader &header);                          // The next record, nullptr at the end
+
+    private:
+        int fd;
+        LSN checkpointLsn;
+        LSN startLsn;                                                       // LSN of records[0]
+        std::vector<char> records;                                          // the valid records, in order
+        size_t position;                                                    // the next record in records
+
+        LogReader(const LogReader &);                                       // Prevent construction by copying
+        LogReader &operator=(const LogReader &);                            // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _wal_h_
@@ -0,0 +1,96 @@
+#ifndef _zonemap_h_
+#define _zonemap_h_
+
+#include <string>
+#include <vector>
+
+#include "pfm.h"
+#include "rbfm.h"
+
+#define ZONE_FILE_SUFFIX ".zmap"            // the zone map of a record-based file is stored next to it under this name
+#define ZONE_MAX_FIELDS 255                 // Int and Real fields a descriptor may have for the map to be kept
+
+namespace PeterDB {
+
+    // What a zone map entry says about its page.
+    typedef enum {
+        ZONE_UNKNOWN = 0,                   // nothing is known; the page must be read
+        ZONE_EXACT,                         // the counts and bounds are those of the page's records
+        ZONE_LOOSE                          // a record was deleted or updated since: still bounds, no longer tight
+    } ZoneState;
+
+    // The records of a page: those a scan returns at the page, so a moved record counts at its tombstone.
+    typedef struct PageZone {
+        unsigned records;                   // at most this many records
+        unsigned state;                     // a ZoneState
+    } PageZone;
+
+    // One fixed-width attribute over the records of a page. min and max hold the attribute's Int or Real
+    // bounds when values > 0. NULLs are counted and left out of the bounds, as they never qualify.
+    typedef struct FieldZone {
+        char min[sizeof(int)];
+        char max[sizeof(int)];
+        unsigned nulls;                     // at most this many NULLs
+        unsigned values;                    // at most this many values; 0 means the page has none
+    } FieldZone;
+
+    // ZoneMap keeps, for every page of a record-based file and every Int and Real attribute of the file's
+    // record descriptor, the smallest and largest value and the number of NULLs, so a scan can pass over a
+    // page whose records cannot satisfy its conditions without reading it.
+    // Entries are stored in the pages of a companion paged file after its header page, which holds the
+    // descriptor's field types, like the free-space map's. An entry is only ever widened: inserts and updates
+    // widen it with the new values, and deletes and updates mark it loose, since the bounds still hold. A scan
+    // that reads a loose or unknown page rebuilds its entry from the records it finds there.
+    // Unlike the free-space map, a wrong entry loses records, so a map left open by a crash, or written for
+    // a different descriptor, is opened with every page unknown; so is an entry that was never written, whose
+    // bytes are all 0.
+    class ZoneMap {
+    public:
+        ZoneMap();
+        ~ZoneMap();
+
+        static std::string fileNameOf(const std::string &fileName);         // The map file of a data file
+
+        RC open(const std::string &fileName, unsigned numPages);            // Load a map; pages it does not
+                                                                            // cover are unknown
+        RC close();                                                         // Write the page count and close
+        bool isOpen() const;
+
+        bool hasDescriptor() const;                                         // Set by the first change or scan
+        bool matches(const std::vector<Attribute> &recordDescriptor) const; // The descriptor the map is for
+        RC setDescriptor(const std::vector<Attribute> &recordDescriptor);   // Forget every page for another one
+        const std::vector<unsigned> &getFields() const;                     // Int and Real fields, by zone
+        int zoneOf(unsigned field) const;                                   // -1 for a VarChar
+
+        const PageZone *pageZone(PageNum pageNum) const;                    // nullptr when unknown
+        const FieldZone &fieldZone(PageNum pageNum, unsigned zone) const;   // of a page that is not unknown
+
+        void clear(PageNum pageNum);                                        // An exact entry without records
+        void widen(PageNum pageNum, const char *const *values, bool added); // By a record's value for each zone,
+                                                                            // nullptr for NULL; added counts it
+        void loosen(PageNum pageNum);                                       // Bounds hold, but not tightly
+        RC save(PageNum pageNum);                                           // Write the entry to the map file
+        unsigned getNumberOfPages() const;
+
+    private:
+        FileHandle mapHandle;                                               // the companion file
+        bool loaded;                                                        // open succeeded, close not yet called
+        std::vector<unsigned char> types;                                   // of the descriptor's fields
+        std::vector<unsigned> fields;                                       // the Int and Real ones
+        unsigned numPages;                                                  // data pages the map covers
+        std::vector<PageZone> pages;
+        std::vector<FieldZone> zones;                                       // fields.size() per page
+
+        unsigned entrySize() const;
+        void grow(unsigned minPages);
+        void forget();
+        RC recreate(const std::string &mapName);
+        RC writeHeader(bool clean);
+
+        ZoneMap(const ZoneMap &);                                           // Prevent construction by copying
+        ZoneMap &operator=(const ZoneMap &);                                // Prevent assignment
+    };
+
+} // namespace PeterDB
+
+#endif // _zonemap_h_
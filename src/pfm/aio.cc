@@ -0,0 +1,327 @@
+#include "src/include/aio.h"
+#include "src/include/bpm.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace PeterDB {
+
+    AsyncIOBackend *AsyncIOBackend::create(unsigned queueDepth, bool allowUring) {
+        if (queueDepth == 0) queueDepth = 1;
+        if (allowUring) {
+            AsyncIOBackend *uring = IOUringBackend::create(queueDepth);
+            if (uring != nullptr) return uring;
+        }
+        return new ThreadPoolIOBackend(queueDepth);
+    }
+
+    IOUringBackend::IOUringBackend()
+            : ringFd(-1), queueDepth(0), inFlight(0), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes(MAP_FAILED),
+              sqRingSize(0), cqRingSize(0), sqesSize(0), sqHead(nullptr), sqTail(nullptr), sqMask(nullptr),
+              sqArray(nullptr), cqHead(nullptr), cqTail(nullptr), cqMask(nullptr), cqes(nullptr) {}
+
+    IOUringBackend *IOUringBackend::create(unsigned queueDepth) {
+        struct io_uring_params params{};
+        int fd = (int) syscall(__NR_io_uring_setup, queueDepth, &params);
+        if (fd < 0) return nullptr;
+
+        auto *ring = new IOUringBackend();
+        ring->ringFd = fd;
+        ring->queueDepth = params.sq_entries;
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_SQ_RING);
+        ring->cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_CQ_RING);
+        ring->sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                          IORING_OFF_SQES);
+        if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+            delete ring;
+            return nullptr;
+        }
+
+        char *sq = (char *) ring->sqRing;
+        ring->sqHead = (unsigned *) (sq + params.sq_off.head);
+        ring->sqTail = (unsigned *) (sq + params.sq_off.tail);
+        ring->sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+        ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+        char *cq = (char *) ring->cqRing;
+        ring->cqHead = (unsigned *) (cq + params.cq_off.head);
+        ring->cqTail = (unsigned *) (cq + params.cq_off.tail);
+        ring->cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+        ring->cqes = cq + params.cq_off.cqes;
+        return ring;
+    }
+
+    IOUringBackend::~IOUringBackend() {
+        // Requests still in flight reference caller memory, so drain them before tearing the ring down.
+        IORequest *drained[AIO_DEFAULT_QUEUE_DEPTH];
+        while (inFlight > 0 && ringFd >= 0) {
+            if (complete(drained, AIO_DEFAULT_QUEUE_DEPTH, 1) == 0) break;
+        }
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    RC IOUringBackend::submit(IORequest *const *requests, unsigned count) {
+        if (inFlight + count > queueDepth) return -1;
+
+        unsigned tail = *sqTail;
+        for (unsigned i = 0; i < count; i++) {
+            IORequest *request = requests[i];
+            request->iov.iov_base = request->buffer;
+            request->iov.iov_len = request->length;
+
+            unsigned index = tail & *sqMask;
+            auto *sqe = (struct io_uring_sqe *) sqes + index;
+            memset(sqe, 0, sizeof(struct io_uring_sqe));
+            sqe->opcode = request->write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->fd = request->fd;
+            sqe->off = (unsigned long long) request->offset;
+            sqe->addr = (unsigned long long) &request->iov;
+            sqe->len = 1;
+            sqe->user_data = (unsigned long long) request;
+            sqArray[index] = index;
+            tail++;
+        }
+        // The kernel must observe the filled entries before it observes the new tail.
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+        // Count the requests before entering the kernel, so a concurrent reaper never sees more completions
+        // than requests in flight.
+        inFlight += count;
+        unsigned toSubmit = count;
+        while (toSubmit > 0) {
+            int submitted = (int) syscall(__NR_io_uring_enter, ringFd, toSubmit, 0, 0, nullptr, 0);
+            if (submitted < 0) {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                inFlight -= toSubmit;
+                return -1;
+            }
+            toSubmit -= submitted;
+        }
+        return 0;
+    }
+
+    unsigned IOUringBackend::complete(IORequest **completed, unsigned maxCount, unsigned minCount) {
+        if (minCount > inFlight) minCount = inFlight;
+        unsigned reaped = 0;
+        while (reaped < maxCount) {
+            unsigned head = *cqHead;
+            unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                if (reaped >= minCount) break;
+                int rc = (int) syscall(__NR_io_uring_enter, ringFd, 0, minCount - reaped, IORING_ENTER_GETEVENTS,
+                                       nullptr, 0);
+                if (rc < 0 && errno != EINTR && errno != EAGAIN) break;
+                continue;
+            }
+            while (head != tail && reaped < maxCount) {
+                auto *cqe = (struct io_uring_cqe *) cqes + (head & *cqMask);
+                auto *request = (IORequest *) cqe->user_data;
+                request->result = cqe->res;
+                completed[reaped++] = request;
+                head++;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        inFlight -= reaped;
+        return reaped;
+    }
+
+    unsigned IOUringBackend::getQueueDepth() const {
+        return queueDepth;
+    }
+
+    const char *IOUringBackend::getName() const {
+        return "io_uring";
+    }
+
+    ThreadPoolIOBackend::ThreadPoolIOBackend(unsigned queueDepth)
+            : queueDepth(queueDepth == 0 ? 1 : queueDepth), inFlight(0), stopping(false) {
+        // More workers than outstanding requests would only sleep.
+        unsigned numWorkers = this->queueDepth < 16 ? this->queueDepth : 16;
+        for (unsigned i = 0; i < numWorkers; i++) {
+            workers.emplace_back(&ThreadPoolIOBackend::work, this);
+        }
+    }
+
+    ThreadPoolIOBackend::~ThreadPoolIOBackend() {
+        {
+            std::unique_lock<std::mutex> lock(latch);
+            finished.wait(lock, [this] { return pending.empty() && done.size() == inFlight; });
+            stopping = true;
+        }
+        submitted.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPoolIOBackend::work() {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            submitted.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            IORequest *request = pending.front();
+            pending.pop_front();
+
+            lock.unlock();
+            ssize_t n = request->write ? pwrite(request->fd, request->buffer, request->length, request->offset)
+                                       : pread(request->fd, request->buffer, request->length, request->offset);
+            request->result = n < 0 ? -errno : (int) n;
+            lock.lock();
+
+            done.push_back(request);
+            finished.notify_all();
+        }
+    }
+
+    RC ThreadPoolIOBackend::submit(IORequest *const *requests, unsigned count) {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (inFlight + count > queueDepth) return -1;
+            for (unsigned i = 0; i < count; i++) {
+                pending.push_back(requests[i]);
+            }
+            inFlight += count;
+        }
+        submitted.notify_all();
+        return 0;
+    }
+
+    unsigned ThreadPoolIOBackend::complete(IORequest **completed, unsigned maxCount, unsigned minCount) {
+        std::unique_lock<std::mutex> lock(latch);
+        if (minCount > inFlight) minCount = inFlight;
+        finished.wait(lock, [this, minCount] { return done.size() >= minCount; });
+
+        unsigned reaped = 0;
+        while (reaped < maxCount && !done.empty()) {
+            completed[reaped++] = done.front();
+            done.pop_front();
+        }
+        inFlight -= reaped;
+        return reaped;
+    }
+
+    unsigned ThreadPoolIOBackend::getQueueDepth() const {
+        return queueDepth;
+    }
+
+    const char *ThreadPoolIOBackend::getName() const {
+        return "threadpool";
+    }
+
+    AsyncFileIO::AsyncFileIO(FileHandle &fileHandle, AsyncIOBackend &backend)
+            : fileHandle(fileHandle), backend(backend), pending(0) {}
+
+    AsyncFileIO::~AsyncFileIO() {
+        PageNum pageNum;
+        void *context;
+        while (pending > 0) {
+            waitForCompletion(pageNum, context);
+        }
+        for (PageRequest *request : freeRequests) {
+            delete request;
+        }
+    }
+
+    PageRequest *AsyncFileIO::takeRequest(PageNum pageNum, void *data, bool write, void *context) {
+        PageRequest *request;
+        if (freeRequests.empty()) {
+            request = new PageRequest();
+        } else {
+            request = freeRequests.back();
+            freeRequests.pop_back();
+        }
+        request->io.fd = fileHandle.fd;
+        request->io.offset = BufferPoolManager::pageOffset(pageNum, fileHandle.pageSize);
+        request->io.buffer = data;
+        request->io.length = fileHandle.pageSize;
+        request->io.write = write;
+        request->io.context = context;
+        request->io.result = 0;
+        request->pageNum = pageNum;
+        request->owner = this;
+        return request;
+    }
+
+    RC AsyncFileIO::submitRequest(PageRequest *request) {
+        IORequest *io = &request->io;
+        if (backend.submit(&io, 1) != 0) {
+            freeRequests.push_back(request);
+            return -1;
+        }
+        pending++;
+        return 0;
+    }
+
+    RC AsyncFileIO::submitRead(PageNum pageNum, void *data, void *context) {
+        // Mapped and compressed files have no page at a fixed offset to read or write directly.
+        if (fileHandle.fd < 0 || fileHandle.mapped || fileHandle.compressed) return -1;
+        if (pageNum >= fileHandle.getNumberOfPages()) return -1;
+
+        PageRequest *request = takeRequest(pageNum, data, false, context);
+        fileHandle.readPageCounter++;
+        if (PagedFileManager::instance().bufferPool().readIfCached(fileHandle.fileId, pageNum, data)) {
+            fileHandle.cacheHitCounter++;
+            request->io.result = fileHandle.pageSize;
+            ready.push_back(request);
+            pending++;
+            return 0;
+        }
+        fileHandle.cacheMissCounter++;
+        return submitRequest(request);
+    }
+
+    RC AsyncFileIO::submitWrite(PageNum pageNum, const void *data, void *context) {
+        if (fileHandle.fd < 0 || fileHandle.mapped || fileHandle.compressed) return -1;
+        if (pageNum >= fileHandle.getNumberOfPages()) return -1;
+
+        // A cached page absorbs the write, so a later eviction writes it back instead.
+        PageRequest *request = takeRequest(pageNum, (void *) data, true, context);
+        fileHandle.writePageCounter++;
+        if (PagedFileManager::instance().bufferPool().writeIfCached(fileHandle.fileId, pageNum, data)) {
+            request->io.result = fileHandle.pageSize;
+            ready.push_back(request);
+            pending++;
+            return 0;
+        }
+        return submitRequest(request);
+    }
+
+    RC AsyncFileIO::waitForCompletion(PageNum &pageNum, void *&context) {
+        if (pending == 0) return -1;
+
+        // Completions of other AsyncFileIOs sharing the backend are handed over to their owners.
+        while (ready.empty()) {
+            IORequest *io;
+            if (backend.complete(&io, 1, 1) != 1) return -1;
+            auto *request = (PageRequest *) io;
+            request->owner->ready.push_back(request);
+        }
+        PageRequest *request = ready.front();
+        ready.pop_front();
+        pending--;
+
+        pageNum = request->pageNum;
+        context = request->io.context;
+        RC rc = request->io.result == (int) request->io.length ? 0 : -1;
+        freeRequests.push_back(request);
+        return rc;
+    }
+
+    unsigned AsyncFileIO::getPending() const {
+        return pending;
+    }
+
+} // namespace PeterDB
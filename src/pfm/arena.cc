@@ -0,0 +1,192 @@
+#include "src/include/arena.h"
+
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+
+namespace PeterDB {
+
+    // The free lists of one thread. Its buffers go back to the arena when the thread exits.
+    struct ThreadCache {
+        std::vector<void *> lists[ARENA_SIZE_CLASSES];
+
+        ThreadCache() {
+            for (auto &list : lists) {
+                list.reserve(ARENA_THREAD_CACHE + 1);
+            }
+        }
+
+        ~ThreadCache();
+    };
+
+    static thread_local ThreadCache threadCache;
+    static thread_local bool threadCacheDestroyed = false;     // buffers released after that go to the arena
+
+    ThreadCache::~ThreadCache() {
+        threadCacheDestroyed = true;
+        for (int sizeClass = 0; sizeClass < ARENA_SIZE_CLASSES; sizeClass++) {
+            if (!lists[sizeClass].empty()) FrameArena::instance().drain(sizeClass, lists[sizeClass], 0);
+        }
+    }
+
+    // Regions that can use huge pages are rounded up to whole huge pages, the others to whole pages.
+    static size_t regionLength(size_t size) {
+        size_t unit = size >= ARENA_HUGE_PAGE_SIZE ? ARENA_HUGE_PAGE_SIZE : PFM_MIN_PAGE_SIZE;
+        return (size + unit - 1) / unit * unit;
+    }
+
+    FrameArena &FrameArena::instance() {
+        static FrameArena _frame_arena;
+        return _frame_arena;
+    }
+
+    FrameArena::FrameArena() : allocateCount(0), refillCount(0), mapCount(0), hugeMapCount(0) {
+        for (int sizeClass = 0; sizeClass < ARENA_SIZE_CLASSES; sizeClass++) {
+            chunks[sizeClass] = nullptr;
+            chunkUsed[sizeClass] = 0;
+        }
+    }
+
+    // Buffers may still be referenced by other singletons being destroyed, so the chunks stay mapped.
+    FrameArena::~FrameArena() = default;
+
+    int FrameArena::sizeClass(size_t size) {
+        if (size > PFM_MAX_PAGE_SIZE) return -1;
+        int sizeClass = 0;
+        for (size_t classSize = PFM_MIN_PAGE_SIZE; classSize < size; classSize <<= 1) {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    size_t FrameArena::classSize(int sizeClass) {
+        return (size_t) PFM_MIN_PAGE_SIZE << sizeClass;
+    }
+
+    void *FrameArena::allocate(size_t size) {
+        allocateCount.fetch_add(1, std::memory_order_relaxed);
+        int sizeClass = FrameArena::sizeClass(size);
+        if (sizeClass < 0) return allocateRegion(size);
+
+        if (threadCacheDestroyed) {
+            std::vector<void *> spare;
+            void *buffer = refill(sizeClass, spare);
+            if (!spare.empty()) drain(sizeClass, spare, 0);
+            return buffer;
+        }
+        std::vector<void *> &list = threadCache.lists[sizeClass];
+        if (list.empty()) return refill(sizeClass, list);
+        void *buffer = list.back();
+        list.pop_back();
+        return buffer;
+    }
+
+    void FrameArena::release(void *buffer, size_t size) {
+        if (buffer == nullptr) return;
+        int sizeClass = FrameArena::sizeClass(size);
+        if (sizeClass < 0) {
+            releaseRegion(buffer, size);
+            return;
+        }
+
+        if (threadCacheDestroyed) {
+            std::lock_guard<std::mutex> guard(latch);
+            freeLists[sizeClass].push_back(buffer);
+            return;
+        }
+        std::vector<void *> &list = threadCache.lists[sizeClass];
+        list.push_back(buffer);
+        if (list.size() > ARENA_THREAD_CACHE) drain(sizeClass, list, ARENA_THREAD_CACHE / 2);
+    }
+
+    // Fills half a thread list from the shared list, then from the chunk of the size, and returns one buffer.
+    void *FrameArena::refill(int sizeClass, std::vector<void *> &threadList) {
+        refillCount.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(latch);
+        std::vector<void *> &shared = freeLists[sizeClass];
+        size_t batch = ARENA_THREAD_CACHE / 2;
+        for (; batch > 0 && !shared.empty(); batch--) {
+            threadList.push_back(shared.back());
+            shared.pop_back();
+        }
+        // Every size divides the chunk size, so a chunk is used up exactly.
+        for (; batch > 0; batch--) {
+            if (chunks[sizeClass] == nullptr || chunkUsed[sizeClass] == ARENA_HUGE_PAGE_SIZE) {
+                void *chunk = allocateRegion(ARENA_HUGE_PAGE_SIZE);
+                if (chunk == nullptr) break;
+                chunks[sizeClass] = (char *) chunk;
+                chunkUsed[sizeClass] = 0;
+            }
+            threadList.push_back(chunks[sizeClass] + chunkUsed[sizeClass]);
+            chunkUsed[sizeClass] += classSize(sizeClass);
+        }
+
+        if (threadList.empty()) return nullptr;
+        void *buffer = threadList.back();
+        threadList.pop_back();
+        return buffer;
+    }
+
+    void FrameArena::drain(int sizeClass, std::vector<void *> &threadList, size_t keep) {
+        std::lock_guard<std::mutex> guard(latch);
+        std::vector<void *> &shared = freeLists[sizeClass];
+        while (threadList.size() > keep) {
+            shared.push_back(threadList.back());
+            threadList.pop_back();
+        }
+    }
+
+    void *FrameArena::allocateRegion(size_t size) {
+        size_t length = regionLength(size);
+        if (size < ARENA_HUGE_PAGE_SIZE) {
+            void *region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (region == MAP_FAILED) return nullptr;
+            mapCount.fetch_add(1, std::memory_order_relaxed);
+            return region;
+        }
+
+        // Reserved huge pages exist only if the administrator set vm.nr_hugepages; try them first.
+        void *region = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                            -1, 0);
+        if (region != MAP_FAILED) {
+            mapCount.fetch_add(1, std::memory_order_relaxed);
+            hugeMapCount.fetch_add(1, std::memory_order_relaxed);
+            return region;
+        }
+
+        // Otherwise ask for transparent huge pages. The kernel only uses them for ranges aligned to a huge
+        // page, so map one more huge page than needed and trim the ends.
+        void *mapping = mmap(nullptr, length + ARENA_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) return nullptr;
+        uintptr_t start = ((uintptr_t) mapping + ARENA_HUGE_PAGE_SIZE - 1) & ~((uintptr_t) ARENA_HUGE_PAGE_SIZE - 1);
+        size_t head = start - (uintptr_t) mapping;
+        if (head > 0) munmap(mapping, head);
+        munmap((char *) start + length, ARENA_HUGE_PAGE_SIZE - head);
+        madvise((void *) start, length, MADV_HUGEPAGE);
+        mapCount.fetch_add(1, std::memory_order_relaxed);
+        return (void *) start;
+    }
+
+    void FrameArena::releaseRegion(void *region, size_t size) {
+        if (region != nullptr) munmap(region, regionLength(size));
+    }
+
+    RC FrameArena::collectCounterValues(unsigned &allocateCount, unsigned &refillCount, unsigned &mapCount,
+                                        unsigned &hugeMapCount) {
+        allocateCount = this->allocateCount.load();
+        refillCount = this->refillCount.load();
+        mapCount = this->mapCount.load();
+        hugeMapCount = this->hugeMapCount.load();
+        return 0;
+    }
+
+    ArenaBuffer::ArenaBuffer(size_t size) : buffer((char *) FrameArena::instance().allocate(size)), length(size) {
+        if (buffer == nullptr) throw std::bad_alloc();
+    }
+
+    ArenaBuffer::~ArenaBuffer() {
+        FrameArena::instance().release(buffer, length);
+    }
+
+} // namespace PeterDB
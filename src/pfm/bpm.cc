@@ -0,0 +1,1166 @@
+#include "src/include/bpm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace PeterDB {
+
+    BufferPoolManager::BufferPoolManager(unsigned numFrames)
+            : numFrames(numFrames), extentSize(BPM_EXTENT_SIZE), nextFileId(0), nextRingId(0), log(nullptr),
+              prefetchBackend(nullptr), prefetchInFlight(0), stopping(false), flushIntervalMs(BPM_FLUSH_INTERVAL_MS),
+              flushRequested(0), flushCompleted(0), flushInProgress(false), flushResult(0), syncCount(0),
+              cycleCount(0) {
+        allocateFrames();
+        flusher = std::thread(&BufferPoolManager::runFlusher, this);
+    }
+
+    BufferPoolManager::~BufferPoolManager() {
+        {
+            std::unique_lock<std::mutex> lock(latch);
+            prefetchQueue.clear();
+            waitForPrefetchesLocked(lock);
+            stopping = true;
+        }
+        prefetchSubmitted.notify_all();
+        flushWanted.notify_all();
+        if (reaper.joinable()) reaper.join();
+        if (flusher.joinable()) flusher.join();
+        delete prefetchBackend;
+
+        flushAll();
+        for (auto &file : files) {
+            if (file.second.compressed != nullptr) {
+                file.second.compressed->sync();
+                delete file.second.compressed;
+            }
+            close(file.second.fd);
+        }
+        releaseFrames();
+    }
+
+    // Data pages follow the hidden header page at the start of every file.
+    off_t BufferPoolManager::pageOffset(PageNum pageNum, unsigned pageSize) {
+        return (off_t) (pageNum + 1) * pageSize;
+    }
+
+    unsigned long long BufferPoolManager::pageKey(unsigned fileId, PageNum pageNum) {
+        return ((unsigned long long) fileId << 32) | pageNum;
+    }
+
+    // The default page size always has a pool; the others are added when a file using them is opened.
+    RC BufferPoolManager::allocateFrames() {
+        if (addPoolLocked(PAGE_SIZE) != 0) return -1;
+        for (auto &file : files) {
+            if (findPoolLocked(file.second.pageSize) == nullptr && addPoolLocked(file.second.pageSize) != 0) return -1;
+        }
+        return 0;
+    }
+
+    FramePool *BufferPoolManager::findPoolLocked(unsigned pageSize) {
+        for (FramePool &pool : pools) {
+            if (pool.pageSize == pageSize) return &pool;
+        }
+        return nullptr;
+    }
+
+    // Callers make sure no read-ahead is in flight: growing prefetchRequests moves the requests.
+    RC BufferPoolManager::addPoolLocked(unsigned pageSize) {
+        unsigned count = (unsigned) ((unsigned long long) numFrames * PAGE_SIZE / pageSize);
+        if (count < BPM_MIN_POOL_FRAMES) count = BPM_MIN_POOL_FRAMES;
+        void *memory = FrameArena::instance().allocateRegion((size_t) count * pageSize);
+        if (memory == nullptr) return -1;
+
+        FramePool pool{pageSize, (unsigned) frames.size(), count, 0, 0, 0, (char *) memory};
+        pools.push_back(pool);
+        frames.resize(frames.size() + count, Frame());
+        prefetchRequests.resize(frames.size(), IORequest());
+        for (unsigned i = pool.first; i < pool.first + count; i++) {
+            frames[i].valid = false;
+            frames[i].dirty = false;
+            frames[i].referenced = false;
+            frames[i].loading = false;
+            frames[i].flushing = false;
+            frames[i].hot = false;
+            frames[i].prefetched = false;
+            frames[i].ring = 0;
+            frames[i].pinCount = 0;
+            frames[i].dropped = false;
+            frames[i].pageSize = pageSize;
+            frames[i].lsn = 0;
+            frames[i].recLsn = 0;
+            frames[i].data = pool.arena + (size_t) (i - pool.first) * pageSize;
+        }
+        return 0;
+    }
+
+    void BufferPoolManager::releaseFrames() {
+        pageTable.clear();
+        frames.clear();
+        for (auto &ring : rings) {
+            ring.second.frames.clear();
+            ring.second.next = 0;
+        }
+        for (FramePool &pool : pools) {
+            FrameArena::instance().releaseRegion(pool.arena, (size_t) pool.count * pool.pageSize);
+        }
+        pools.clear();
+    }
+
+    RC BufferPoolManager::resize(unsigned numFrames) {
+        std::unique_lock<std::mutex> lock(latch);
+        if (numFrames == 0) return -1;
+        for (bool waited = true; waited;) {
+            prefetchQueue.clear();
+            waitForPrefetchesLocked(lock);
+            waitForFlusherLocked(lock);
+            if (forceLogLocked(lock, BPM_ALL_FILES, waited) != 0) return -1;
+        }
+        for (Frame &frame : frames) {
+            if (frame.valid && frame.pinCount > 0) return -1;
+            if (frame.valid && frame.dirty && writeFrame(frame) != 0) return -1;
+        }
+        releaseFrames();
+        this->numFrames = numFrames;
+        return allocateFrames();
+    }
+
+    unsigned BufferPoolManager::getNumFrames() {
+        std::lock_guard<std::mutex> guard(latch);
+        return frames.size();
+    }
+
+    RC BufferPoolManager::registerFile(int fd, unsigned pageSize, unsigned &fileId, bool compressed) {
+        struct stat st{};
+        if (fstat(fd, &st) != 0) return -1;
+
+        std::unique_lock<std::mutex> lock(latch);
+        for (auto &file : files) {
+            if (file.second.dev == st.st_dev && file.second.ino == st.st_ino) {
+                if (file.second.pageSize != pageSize || (file.second.compressed != nullptr) != compressed) return -1;
+                file.second.refCount++;
+                fileId = file.first;
+                return 0;
+            }
+        }
+
+        if (findPoolLocked(pageSize) == nullptr) {
+            waitForPrefetchesLocked(lock);
+            if (findPoolLocked(pageSize) == nullptr && addPoolLocked(pageSize) != 0) return -1;
+        }
+
+        FileEntry entry{};
+        entry.fd = dup(fd);
+        if (entry.fd < 0) return -1;
+        entry.dev = st.st_dev;
+        entry.ino = st.st_ino;
+        entry.refCount = 1;
+        entry.pageSize = pageSize;
+        entry.numPages = st.st_size < pageSize ? 0 : (unsigned) (st.st_size / pageSize - 1);
+        entry.preallocate = true;
+        if (compressed) {
+            entry.compressed = CompressedFile::open(entry.fd, pageSize);
+            if (entry.compressed == nullptr) {
+                close(entry.fd);
+                return -1;
+            }
+            entry.numPages = entry.compressed->getNumberOfPages();
+            entry.preallocate = false;
+        }
+        entry.capacity = entry.numPages;
+        fileId = nextFileId++;
+        files[fileId] = entry;
+        return 0;
+    }
+
+    RC BufferPoolManager::unregisterFile(unsigned fileId) {
+        std::unique_lock<std::mutex> lock(latch);
+        auto it = files.find(fileId);
+        if (it == files.end()) return -1;
+        if (it->second.refCount > 1) {
+            it->second.refCount--;
+            return 0;
+        }
+
+        // Read-ahead still targets the descriptor, so let it drain before the file goes away.
+        RC rc = 0;
+        for (bool waited = true; waited;) {
+            for (auto queued = prefetchQueue.begin(); queued != prefetchQueue.end();) {
+                queued = queued->fileId == fileId ? prefetchQueue.erase(queued) : queued + 1;
+            }
+            waitForPrefetchesLocked(lock);
+            waitForFlusherLocked(lock);
+            it = files.find(fileId);
+            if (it == files.end() || it->second.refCount > 1) break;
+            if (forceLogLocked(lock, fileId, waited) != 0) {
+                rc = -1;
+                break;
+            }
+        }
+        it = files.find(fileId);
+        if (it == files.end() || --it->second.refCount > 0) return 0;
+
+        if (flushFileLocked(fileId) != 0) rc = -1;
+        if (trimLocked(it->second) != 0) rc = -1;
+        // The flusher no longer sees the file, so a checkpoint could otherwise count on unsynced writes.
+        if (log != nullptr && it->second.unsynced && fdatasync(it->second.fd) != 0) rc = -1;
+        if (it->second.compressed != nullptr) {
+            if (it->second.compressed->sync() != 0) rc = -1;
+            delete it->second.compressed;
+        }
+        dropFileLocked(fileId);
+        close(it->second.fd);
+        files.erase(it);
+        return rc;
+    }
+
+    RC BufferPoolManager::writePageLocked(FileEntry &file, PageNum pageNum, const char *data) {
+        if (file.compressed != nullptr) {
+            if (file.compressed->writePage(pageNum, data) != 0) return -1;
+        } else {
+            ssize_t length = pwrite(file.fd, data, file.pageSize, pageOffset(pageNum, file.pageSize));
+            if (length != (ssize_t) file.pageSize) return -1;
+        }
+        file.unsynced = true;
+        return 0;
+    }
+
+    // The caller has made the log durable up to the frame's last change, see forceLogLocked.
+    RC BufferPoolManager::writeFrame(Frame &frame) {
+        if (logPendingLocked(frame)) return -1;
+        if (writePageLocked(files.at(frame.fileId), frame.pageNum, frame.data) != 0) return -1;
+        frame.dirty = false;
+        frame.lsn = 0;
+        // A frame still pinned for write may be changed again before it is unpinned.
+        if (frame.pinCount == 0) frame.recLsn = 0;
+        return 0;
+    }
+
+    // A dirty frame changed under an LSN the log has not made durable yet cannot be written back.
+    bool BufferPoolManager::logPendingLocked(const Frame &frame) {
+        return frame.dirty && frame.lsn != 0 && log != nullptr && frame.lsn >= log->getDurableLsn();
+    }
+
+    // The latch is released while waiting, so the caller looks up again whatever it found before.
+    RC BufferPoolManager::flushLogLocked(std::unique_lock<std::mutex> &lock, LSN lsn) {
+        LogManager *log = this->log;
+        if (log == nullptr) return 0;
+        lock.unlock();
+        RC rc = log->flush(lsn);
+        lock.lock();
+        return rc;
+    }
+
+    // Make the log durable for every dirty frame of fileId, or of every file for BPM_ALL_FILES, so that they can
+    // be written back under the latch; waited tells whether the latch was released for it.
+    RC BufferPoolManager::forceLogLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, bool &waited) {
+        LSN lsn = 0;
+        for (const Frame &frame : frames) {
+            if (frame.valid && (fileId == BPM_ALL_FILES || frame.fileId == fileId) && logPendingLocked(frame)) {
+                lsn = std::max(lsn, frame.lsn);
+            }
+        }
+        waited = lsn != 0;
+        return waited ? flushLogLocked(lock, lsn) : 0;
+    }
+
+    RC BufferPoolManager::evictFrameLocked(FramePool &pool, Frame &frame) {
+        if (frame.dirty && writeFrame(frame) != 0) return -1;
+        pageTable.erase(pageKey(frame.fileId, frame.pageNum));
+        if (frame.hot) pool.hotCount--;
+        frame.hot = false;
+        frame.valid = false;
+        return 0;
+    }
+
+    RC BufferPoolManager::findVictim(FramePool &pool, unsigned &frameId, LSN &logLsn) {
+        // The first two sweeps evict probation frames and clear reference bits; a protected frame is only
+        // taken there while the region is over its share and the frame was not reused since the last pass.
+        // The last sweep takes any unpinned frame whose changes are durable in the log.
+        logLsn = 0;
+        for (size_t step = 0; step < 3 * pool.count; step++) {
+            unsigned current = pool.first + pool.clockHand;
+            pool.clockHand = (pool.clockHand + 1) % pool.count;
+            Frame &frame = frames[current];
+
+            if (!frame.valid) {
+                frameId = current;
+                return 0;
+            }
+            if (frame.pinCount > 0 || frame.flushing) continue;
+            bool lastSweep = step >= 2 * pool.count;
+            if (frame.hot && !lastSweep) {
+                if ((unsigned long long) pool.hotCount * 100 <= (unsigned long long) pool.count * BPM_HOT_PERCENT) {
+                    continue;
+                }
+            }
+            if (frame.referenced && !lastSweep) {
+                frame.referenced = false;
+                continue;
+            }
+            if (logPendingLocked(frame)) {
+                logLsn = std::max(logLsn, frame.lsn);
+                continue;
+            }
+            if (evictFrameLocked(pool, frame) != 0) return -1;
+            frameId = current;
+            return 0;
+        }
+        return -1;
+    }
+
+    // A ring grows to its capacity from the shared region, then recycles its oldest unpinned frame.
+    // Frames the shared region took back in between are replaced by fresh ones.
+    RC BufferPoolManager::findRingVictim(unsigned ring, FramePool &pool, unsigned &frameId, bool &inRing,
+                                         LSN &logLsn) {
+        auto it = rings.find(ring);
+        if (it == rings.end()) {
+            inRing = false;
+            return findVictim(pool, frameId, logLsn);
+        }
+        Ring &state = it->second;
+        unsigned capacity = std::min((unsigned) BPM_RING_FRAMES, std::max(pool.count / 4, 1u));
+
+        size_t stale = state.frames.size();
+        if (state.frames.size() >= capacity) {
+            for (size_t k = 0; k < state.frames.size(); k++) {
+                size_t index = state.next;
+                state.next = (state.next + 1) % state.frames.size();
+                Frame &frame = frames[state.frames[index]];
+                if (!frame.valid || frame.ring != ring) {
+                    stale = index;
+                    break;
+                }
+                if (frame.pinCount > 0 || frame.flushing || frame.loading || logPendingLocked(frame)) continue;
+                if (evictFrameLocked(pool, frame) != 0) return -1;
+                frameId = state.frames[index];
+                inRing = true;
+                return 0;
+            }
+        }
+
+        if (findVictim(pool, frameId, logLsn) != 0) return -1;
+        inRing = true;
+        if (stale < state.frames.size()) {
+            state.frames[stale] = frameId;
+        } else if (state.frames.size() < capacity) {
+            state.frames.push_back(frameId);
+        } else {
+            // Every frame of the ring is pinned; this one is borrowed from the shared region.
+            inRing = false;
+        }
+        return 0;
+    }
+
+    // Fails with logLsn set when the only frames left to evict wait for the log up to logLsn; the caller
+    // forces the log with the latch released and starts over, or does without a frame.
+    RC BufferPoolManager::installPage(unsigned fileId, PageNum pageNum, unsigned &frameId, unsigned ring,
+                                      LSN &logLsn) {
+        logLsn = 0;
+        FramePool *pool = findPoolLocked(files.at(fileId).pageSize);
+        if (pool == nullptr) return -1;
+        bool inRing = false;
+        if (ring != 0) {
+            if (findRingVictim(ring, *pool, frameId, inRing, logLsn) != 0) return -1;
+        } else if (findVictim(*pool, frameId, logLsn) != 0) {
+            return -1;
+        }
+        Frame &frame = frames[frameId];
+        frame.fileId = fileId;
+        frame.pageNum = pageNum;
+        frame.valid = true;
+        frame.dirty = false;
+        frame.lsn = 0;
+        frame.recLsn = 0;
+        frame.referenced = true;
+        frame.loading = false;
+        frame.flushing = false;
+        frame.hot = false;
+        frame.prefetched = false;
+        frame.ring = inRing ? ring : 0;
+        frame.pinCount = 0;
+        frame.dropped = false;
+        pageTable[pageKey(fileId, pageNum)] = frameId;
+        return 0;
+    }
+
+    // A page of a plain file is read with the latch released, like a read-ahead: the frame is pinned and
+    // marked loading, so other pins of the page wait for it while every other page stays available.
+    // CompressedFile is only called under the latch.
+    RC BufferPoolManager::loadFrameLocked(std::unique_lock<std::mutex> &lock, FileEntry &file, unsigned frameId) {
+        Frame &frame = frames[frameId];
+        if (file.compressed != nullptr) {
+            if (file.compressed->readPage(frame.pageNum, frame.data) == 0) return 0;
+            pageTable.erase(pageKey(frame.fileId, frame.pageNum));
+            frame.valid = false;
+            return -1;
+        }
+
+        int fd = file.fd;
+        char *data = frame.data;
+        off_t offset = pageOffset(frame.pageNum, frame.pageSize);
+        unsigned pageSize = frame.pageSize;
+        frame.loading = true;
+        frame.pinCount = 1;
+        lock.unlock();
+        bool read = pread(fd, data, pageSize, offset) == (ssize_t) pageSize;
+        lock.lock();
+
+        // Adding a pool may have moved the frames, but not their ids or memory.
+        Frame &loadedFrame = frames[frameId];
+        loadedFrame.loading = false;
+        loadedFrame.pinCount = 0;
+        loaded.notify_all();
+        if (read) return 0;
+        pageTable.erase(pageKey(loadedFrame.fileId, loadedFrame.pageNum));
+        loadedFrame.valid = false;
+        return -1;
+    }
+
+    // A hit through a ring leaves the frame where it is. Any other hit is a reuse: it pulls the frame out of
+    // its ring, and promotes it once the hand has cleared its reference bit since the previous pin.
+    void BufferPoolManager::touchFrameLocked(Frame &frame, unsigned ring) {
+        if (ring == 0) {
+            if (frame.ring != 0) {
+                frame.ring = 0;
+            } else if (!frame.hot && !frame.referenced && !frame.prefetched) {
+                frame.hot = true;
+                findPoolLocked(frame.pageSize)->hotCount++;
+            }
+        }
+        frame.prefetched = false;
+        frame.referenced = true;
+    }
+
+    RC BufferPoolManager::pinPage(unsigned fileId, PageNum pageNum, unsigned &frameId, char *&data, bool &hit,
+                                  unsigned ring, bool forWrite) {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            auto file = files.find(fileId);
+            if (file == files.end() || pageNum >= file->second.numPages) return -1;
+
+            auto it = pageTable.find(pageKey(fileId, pageNum));
+            if (it != pageTable.end() && frames[it->second].loading) {
+                loaded.wait(lock);
+                continue;
+            }
+            if (it != pageTable.end()) {
+                frameId = it->second;
+                touchFrameLocked(frames[frameId], ring);
+                hit = true;
+                break;
+            }
+            LSN logLsn;
+            if (installPage(fileId, pageNum, frameId, ring, logLsn) != 0) {
+                if (logLsn == 0 || flushLogLocked(lock, logLsn) != 0) return -1;
+                continue;
+            }
+            if (loadFrameLocked(lock, file->second, frameId) != 0) return -1;
+            hit = false;
+            break;
+        }
+
+        Frame &frame = frames[frameId];
+        frame.pinCount++;
+        // Whatever the caller logs under this pin gets an LSN at or past the current end of the log.
+        if (forWrite && log != nullptr && frame.recLsn == 0) frame.recLsn = log->getEndLsn();
+        data = frame.data;
+        return 0;
+    }
+
+    void BufferPoolManager::unpinPage(unsigned frameId, bool dirty, LSN lsn) {
+        std::lock_guard<std::mutex> guard(latch);
+        Frame &frame = frames[frameId];
+        if (frame.pinCount > 0) frame.pinCount--;
+        if (frame.dropped) {
+            // The file is gone; whatever the pin changed is discarded with the frame.
+            if (frame.pinCount == 0) {
+                frame.valid = false;
+                frame.dropped = false;
+            }
+            return;
+        }
+        if (dirty) frame.dirty = true;
+        if (lsn > frame.lsn) frame.lsn = lsn;
+    }
+
+    RC BufferPoolManager::writePage(unsigned fileId, PageNum pageNum, const void *data, unsigned ring) {
+        std::unique_lock<std::mutex> lock(latch);
+        // A whole-page overwrite never needs the old image, so a miss just claims a frame.
+        unsigned frameId;
+        while (true) {
+            auto file = files.find(fileId);
+            if (file == files.end() || pageNum >= file->second.numPages) return -1;
+
+            auto it = pageTable.find(pageKey(fileId, pageNum));
+            if (it != pageTable.end() && frames[it->second].loading) {
+                loaded.wait(lock);
+                continue;
+            }
+            if (it != pageTable.end()) {
+                frameId = it->second;
+                touchFrameLocked(frames[frameId], ring);
+                break;
+            }
+            LSN logLsn;
+            if (installPage(fileId, pageNum, frameId, ring, logLsn) == 0) break;
+            if (logLsn == 0 || flushLogLocked(lock, logLsn) != 0) return -1;
+        }
+        Frame &frame = frames[frameId];
+        memcpy(frame.data, data, frame.pageSize);
+        frame.dirty = true;
+        return 0;
+    }
+
+    RC BufferPoolManager::appendPage(unsigned fileId, const void *data, PageNum &pageNum, unsigned &extents,
+                                     unsigned ring) {
+        std::unique_lock<std::mutex> lock(latch);
+        // Appends are written through so the file grows immediately; the new page is then cached clean.
+        if (appendLocked(lock, fileId, 1, data, pageNum, extents) != 0) return -1;
+        unsigned pageSize = files.at(fileId).pageSize;
+
+        // The page is on disk already, so it is not cached rather than wait for the log to free a frame.
+        unsigned frameId;
+        LSN logLsn;
+        if (installPage(fileId, pageNum, frameId, ring, logLsn) == 0) {
+            memcpy(frames[frameId].data, data, pageSize);
+        }
+        return 0;
+    }
+
+    void BufferPoolManager::waitForLoadLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, PageNum pageNum,
+                                              unsigned count) {
+        for (PageNum i = pageNum; i < pageNum + count; i++) {
+            auto it = pageTable.find(pageKey(fileId, i));
+            while (it != pageTable.end() && frames[it->second].loading) {
+                loaded.wait(lock);
+                it = pageTable.find(pageKey(fileId, i));
+            }
+        }
+    }
+
+    RC BufferPoolManager::readPages(unsigned fileId, PageNum pageNum, unsigned count, void *data, unsigned &hits) {
+        std::unique_lock<std::mutex> lock(latch);
+        auto file = files.find(fileId);
+        if (file == files.end() || count == 0 || pageNum + count > file->second.numPages) return -1;
+        waitForLoadLocked(lock, fileId, pageNum, count);
+
+        // One read covers the whole range; cached frames may be newer than the disk and are copied over it.
+        std::vector<unsigned> cached;
+        for (PageNum i = pageNum; i < pageNum + count; i++) {
+            auto it = pageTable.find(pageKey(fileId, i));
+            cached.push_back(it == pageTable.end() ? (unsigned) -1 : it->second);
+        }
+        hits = count - (unsigned) std::count(cached.begin(), cached.end(), (unsigned) -1);
+        unsigned pageSize = file->second.pageSize;
+        size_t length = (size_t) count * pageSize;
+        bool read = true;
+        if (file->second.compressed != nullptr) {
+            for (unsigned i = 0; i < count && read; i++) {
+                read = cached[i] != (unsigned) -1 ||
+                       file->second.compressed->readPage(pageNum + i, (char *) data + (size_t) i * pageSize) == 0;
+            }
+        } else if (hits < count) {
+            // The cached frames are pinned so none is written back and evicted under the read.
+            int fd = file->second.fd;
+            pinFramesLocked(cached, true);
+            lock.unlock();
+            read = pread(fd, data, length, pageOffset(pageNum, pageSize)) == (ssize_t) length;
+            lock.lock();
+            pinFramesLocked(cached, false);
+            // Pages cached meanwhile may be newer than what was read.
+            for (unsigned i = 0; i < count; i++) {
+                auto it = pageTable.find(pageKey(fileId, pageNum + i));
+                if (cached[i] == (unsigned) -1 && it != pageTable.end() && !frames[it->second].loading) {
+                    cached[i] = it->second;
+                }
+            }
+        }
+        if (!read) return -1;
+
+        for (unsigned i = 0; i < count; i++) {
+            if (cached[i] == (unsigned) -1) continue;
+            Frame &frame = frames[cached[i]];
+            frame.referenced = true;
+            memcpy((char *) data + (size_t) i * pageSize, frame.data, pageSize);
+        }
+        return 0;
+    }
+
+    void BufferPoolManager::pinFramesLocked(const std::vector<unsigned> &frameIds, bool pin) {
+        for (unsigned frameId : frameIds) {
+            if (frameId == (unsigned) -1) continue;
+            if (pin) {
+                frames[frameId].pinCount++;
+            } else {
+                frames[frameId].pinCount--;
+            }
+        }
+    }
+
+    RC BufferPoolManager::writePages(unsigned fileId, PageNum pageNum, unsigned count, const void *data) {
+        std::unique_lock<std::mutex> lock(latch);
+        auto file = files.find(fileId);
+        if (file == files.end() || count == 0 || pageNum + count > file->second.numPages) return -1;
+        waitForLoadLocked(lock, fileId, pageNum, count);
+        // An older copy of one of these pages may be on its way to the disk; it must not land last.
+        waitForFlusherLocked(lock);
+        file = files.find(fileId);
+        if (file == files.end()) return -1;
+
+        unsigned pageSize = file->second.pageSize;
+        size_t length = (size_t) count * pageSize;
+        std::vector<unsigned> cached;
+        if (file->second.compressed != nullptr) {
+            for (unsigned i = 0; i < count; i++) {
+                if (file->second.compressed->writePage(pageNum + i, (const char *) data + (size_t) i * pageSize) != 0) {
+                    return -1;
+                }
+            }
+        } else {
+            // The cached frames are pinned, so the flusher cannot write an older copy of them meanwhile.
+            for (PageNum i = pageNum; i < pageNum + count; i++) {
+                auto it = pageTable.find(pageKey(fileId, i));
+                cached.push_back(it == pageTable.end() ? (unsigned) -1 : it->second);
+            }
+            int fd = file->second.fd;
+            pinFramesLocked(cached, true);
+            lock.unlock();
+            bool written = pwrite(fd, data, length, pageOffset(pageNum, pageSize)) == (ssize_t) length;
+            lock.lock();
+            waitForLoadLocked(lock, fileId, pageNum, count);
+            pinFramesLocked(cached, false);
+            if (!written) return -1;
+        }
+        files.at(fileId).unsynced = true;
+
+        // Cached copies now match the disk. A page cached meanwhile may have been loaded, changed or even
+        // written back around the write, so its frame takes the new image but stays dirty.
+        for (unsigned i = 0; i < count; i++) {
+            auto it = pageTable.find(pageKey(fileId, pageNum + i));
+            if (it == pageTable.end()) continue;
+            Frame &frame = frames[it->second];
+            memcpy(frame.data, (const char *) data + (size_t) i * pageSize, pageSize);
+            if (!cached.empty() && cached[i] != it->second) {
+                frame.dirty = true;
+                continue;
+            }
+            frame.dirty = false;
+            frame.lsn = 0;
+            if (frame.pinCount == 0) frame.recLsn = 0;
+        }
+        return 0;
+    }
+
+    RC BufferPoolManager::appendPages(unsigned fileId, unsigned count, const void *data, PageNum &pageNum,
+                                      unsigned &extents) {
+        std::unique_lock<std::mutex> lock(latch);
+        if (count == 0) return -1;
+        // Bulk appends bypass the frames, so a large load does not push out the working set.
+        return appendLocked(lock, fileId, count, data, pageNum, extents);
+    }
+
+    // Appends to one file take turns, so its pages are written in order and the file never has a hole. The
+    // pages count once they are written; a plain file is written with the latch released meanwhile.
+    RC BufferPoolManager::appendLocked(std::unique_lock<std::mutex> &lock, unsigned fileId, unsigned count,
+                                       const void *data, PageNum &pageNum, unsigned &extents) {
+        auto file = files.find(fileId);
+        while (file != files.end() && file->second.appending) {
+            appended.wait(lock);
+            file = files.find(fileId);
+        }
+        if (file == files.end()) return -1;
+
+        pageNum = file->second.numPages;
+        extents = reserveLocked(file->second, pageNum + count);
+        unsigned pageSize = file->second.pageSize;
+        if (file->second.compressed != nullptr) {
+            for (unsigned i = 0; i < count; i++) {
+                PageNum appendedPageNum;
+                if (file->second.compressed->appendPage((const char *) data + (size_t) i * pageSize,
+                                                        appendedPageNum) != 0) {
+                    file->second.numPages += i;
+                    return -1;
+                }
+            }
+        } else {
+            int fd = file->second.fd;
+            size_t length = (size_t) count * pageSize;
+            file->second.appending = true;
+            lock.unlock();
+            bool written = pwrite(fd, data, length, pageOffset(pageNum, pageSize)) == (ssize_t) length;
+            lock.lock();
+            file = files.find(fileId);
+            file->second.appending = false;
+            appended.notify_all();
+            if (!written) return -1;
+        }
+        file->second.numPages += count;
+        file->second.unsynced = true;
+        return 0;
+    }
+
+    bool BufferPoolManager::readIfCached(unsigned fileId, PageNum pageNum, void *data) {
+        std::unique_lock<std::mutex> lock(latch);
+        auto it = pageTable.find(pageKey(fileId, pageNum));
+        while (it != pageTable.end() && frames[it->second].loading) {
+            loaded.wait(lock);
+            it = pageTable.find(pageKey(fileId, pageNum));
+        }
+        if (it == pageTable.end()) return false;
+        Frame &frame = frames[it->second];
+        frame.referenced = true;
+        memcpy(data, frame.data, frame.pageSize);
+        return true;
+    }
+
+    bool BufferPoolManager::writeIfCached(unsigned fileId, PageNum pageNum, const void *data) {
+        std::unique_lock<std::mutex> lock(latch);
+        auto it = pageTable.find(pageKey(fileId, pageNum));
+        while (it != pageTable.end() && frames[it->second].loading) {
+            loaded.wait(lock);
+            it = pageTable.find(pageKey(fileId, pageNum));
+        }
+        if (it == pageTable.end()) return false;
+        Frame &frame = frames[it->second];
+        frame.referenced = true;
+        frame.dirty = true;
+        memcpy(frame.data, data, frame.pageSize);
+        return true;
+    }
+
+    unsigned BufferPoolManager::getNumberOfPages(unsigned fileId) {
+        std::lock_guard<std::mutex> guard(latch);
+        auto file = files.find(fileId);
+        return file == files.end() ? 0 : file->second.numPages;
+    }
+
+    unsigned BufferPoolManager::getReservedPages(unsigned fileId) {
+        std::lock_guard<std::mutex> guard(latch);
+        auto file = files.find(fileId);
+        return file == files.end() ? 0 : file->second.capacity - file->second.numPages;
+    }
+
+    void BufferPoolManager::setExtentSize(unsigned bytes) {
+        std::lock_guard<std::mutex> guard(latch);
+        extentSize = bytes;
+    }
+
+    // Make sure blocks are allocated for the first numPages data pages; returns the number of extents reserved.
+    unsigned BufferPoolManager::reserveLocked(FileEntry &file, unsigned numPages) {
+        if (!file.preallocate || extentSize == 0 || numPages <= file.capacity) return 0;
+
+        unsigned extentPages = extentSize / file.pageSize;
+        if (extentPages == 0) extentPages = 1;
+        unsigned extents = (numPages - file.capacity + extentPages - 1) / extentPages;
+        unsigned capacity = file.capacity + extents * extentPages;
+        off_t length = (off_t) (capacity - file.capacity) * file.pageSize;
+        if (fallocate(file.fd, FALLOC_FL_KEEP_SIZE, pageOffset(file.capacity, file.pageSize), length) != 0) {
+            // Not supported here: appends simply grow the file page by page.
+            file.preallocate = false;
+            return 0;
+        }
+        file.capacity = capacity;
+        return extents;
+    }
+
+    // Truncating to the current size releases blocks reserved past the end of the file.
+    RC BufferPoolManager::trimLocked(FileEntry &file) {
+        if (file.capacity <= file.numPages) return 0;
+        file.capacity = file.numPages;
+        return ftruncate(file.fd, pageOffset(file.numPages, file.pageSize)) == 0 ? 0 : -1;
+    }
+
+    RC BufferPoolManager::flushFileLocked(unsigned fileId) {
+        RC rc = 0;
+        for (Frame &frame : frames) {
+            if (frame.valid && frame.dirty && frame.fileId == fileId && writeFrame(frame) != 0) rc = -1;
+        }
+        return rc;
+    }
+
+    // A frame still pinned, say by a scan that was not closed, stays valid and out of every victim search
+    // until its last unpin invalidates it; it is no longer found by page and never written back.
+    void BufferPoolManager::dropFileLocked(unsigned fileId) {
+        for (Frame &frame : frames) {
+            if (frame.valid && frame.fileId == fileId && !frame.dropped) {
+                pageTable.erase(pageKey(fileId, frame.pageNum));
+                if (frame.hot) findPoolLocked(frame.pageSize)->hotCount--;
+                frame.hot = false;
+                frame.dirty = false;
+                frame.lsn = 0;
+                frame.recLsn = 0;
+                frame.loading = false;
+                frame.ring = 0;
+                if (frame.pinCount > 0) {
+                    frame.dropped = true;
+                } else {
+                    frame.valid = false;
+                }
+            }
+        }
+    }
+
+    RC BufferPoolManager::prefetch(unsigned fileId, PageNum pageNum, unsigned count, unsigned ring) {
+        std::lock_guard<std::mutex> guard(latch);
+        auto file = files.find(fileId);
+        if (file == files.end() || file->second.compressed != nullptr) return -1;
+
+        if (prefetchBackend == nullptr) {
+            prefetchBackend = AsyncIOBackend::create(AIO_DEFAULT_QUEUE_DEPTH);
+            reaper = std::thread(&BufferPoolManager::reapPrefetches, this);
+        }
+        for (PageNum i = pageNum; i < pageNum + count && i < file->second.numPages; i++) {
+            if (prefetchQueue.size() >= BPM_PREFETCH_QUEUE) break;
+            if (pageTable.find(pageKey(fileId, i)) == pageTable.end()) {
+                prefetchQueue.push_back(QueuedPrefetch{fileId, i, ring});
+            }
+        }
+        issuePrefetchesLocked();
+        return 0;
+    }
+
+    void BufferPoolManager::cancelPrefetch(unsigned fileId) {
+        std::lock_guard<std::mutex> guard(latch);
+        for (auto queued = prefetchQueue.begin(); queued != prefetchQueue.end();) {
+            queued = queued->fileId == fileId ? prefetchQueue.erase(queued) : queued + 1;
+        }
+    }
+
+    unsigned BufferPoolManager::createRing() {
+        std::lock_guard<std::mutex> guard(latch);
+        unsigned ring = ++nextRingId;
+        rings[ring] = Ring{std::vector<unsigned>(), 0};
+        return ring;
+    }
+
+    // The frames stay cached but lose their reference bits, so the hand reclaims them first.
+    void BufferPoolManager::dropRing(unsigned ring) {
+        std::lock_guard<std::mutex> guard(latch);
+        auto it = rings.find(ring);
+        if (it == rings.end()) return;
+        for (unsigned frameId : it->second.frames) {
+            Frame &frame = frames[frameId];
+            if (frame.ring != ring) continue;
+            frame.ring = 0;
+            frame.referenced = false;
+        }
+        rings.erase(it);
+    }
+
+    void BufferPoolManager::issuePrefetchesLocked() {
+        while (!prefetchQueue.empty() && prefetchInFlight < prefetchBackend->getQueueDepth()) {
+            unsigned fileId = prefetchQueue.front().fileId;
+            PageNum pageNum = prefetchQueue.front().pageNum;
+            unsigned ring = prefetchQueue.front().ring;
+
+            auto file = files.find(fileId);
+            if (file == files.end() || pageNum >= file->second.numPages ||
+                pageTable.find(pageKey(fileId, pageNum)) != pageTable.end()) {
+                prefetchQueue.pop_front();
+                continue;
+            }
+            // Keep at most half of a pool loading, so read-ahead never starves demand reads of frames.
+            FramePool *pool = findPoolLocked(file->second.pageSize);
+            if (pool == nullptr || pool->loading >= pool->count / 2) break;
+            prefetchQueue.pop_front();
+
+            unsigned frameId;
+            LSN logLsn;
+            if (installPage(fileId, pageNum, frameId, ring, logLsn) != 0) break;
+            Frame &frame = frames[frameId];
+            frame.loading = true;
+            frame.prefetched = true;
+            frame.pinCount = 1;
+
+            IORequest *request = &prefetchRequests[frameId];
+            request->fd = file->second.fd;
+            request->offset = pageOffset(pageNum, frame.pageSize);
+            request->buffer = frame.data;
+            request->length = frame.pageSize;
+            request->write = false;
+            request->context = (void *) (size_t) frameId;
+            if (prefetchBackend->submit(&request, 1) != 0) {
+                pageTable.erase(pageKey(fileId, pageNum));
+                frame.valid = false;
+                frame.loading = false;
+                frame.pinCount = 0;
+                break;
+            }
+            pool->loading++;
+            prefetchInFlight++;
+        }
+        if (prefetchInFlight > 0) prefetchSubmitted.notify_one();
+    }
+
+    void BufferPoolManager::waitForPrefetchesLocked(std::unique_lock<std::mutex> &lock) {
+        loaded.wait(lock, [this] { return prefetchInFlight == 0; });
+    }
+
+    void BufferPoolManager::reapPrefetches() {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            prefetchSubmitted.wait(lock, [this] { return stopping || prefetchInFlight > 0; });
+            if (prefetchInFlight == 0) return;
+
+            lock.unlock();
+            IORequest *completed[AIO_DEFAULT_QUEUE_DEPTH];
+            unsigned count = prefetchBackend->complete(completed, AIO_DEFAULT_QUEUE_DEPTH, 1);
+            lock.lock();
+
+            for (unsigned i = 0; i < count; i++) {
+                Frame &frame = frames[(size_t) completed[i]->context];
+                frame.loading = false;
+                frame.pinCount--;
+                findPoolLocked(frame.pageSize)->loading--;
+                if (completed[i]->result != (int) frame.pageSize) {
+                    pageTable.erase(pageKey(frame.fileId, frame.pageNum));
+                    frame.valid = false;
+                }
+            }
+            prefetchInFlight -= count;
+            issuePrefetchesLocked();
+            loaded.notify_all();
+        }
+    }
+
+    RC BufferPoolManager::flushFile(unsigned fileId) {
+        std::unique_lock<std::mutex> lock(latch);
+        for (bool waited = true; waited;) {
+            waitForFlusherLocked(lock);
+            if (files.find(fileId) == files.end()) return -1;
+            if (forceLogLocked(lock, fileId, waited) != 0) return -1;
+        }
+        return flushFileLocked(fileId);
+    }
+
+    RC BufferPoolManager::flushAll() {
+        std::unique_lock<std::mutex> lock(latch);
+        for (bool waited = true; waited;) {
+            waitForFlusherLocked(lock);
+            if (forceLogLocked(lock, BPM_ALL_FILES, waited) != 0) return -1;
+        }
+        RC rc = 0;
+        for (Frame &frame : frames) {
+            if (frame.valid && frame.dirty && writeFrame(frame) != 0) rc = -1;
+        }
+        return rc;
+    }
+
+    RC BufferPoolManager::sync() {
+        std::unique_lock<std::mutex> lock(latch);
+        unsigned long long generation = ++flushRequested;
+        syncCount++;
+        flushWanted.notify_one();
+        flushDone.wait(lock, [this, generation] { return flushCompleted >= generation; });
+        return flushResult;
+    }
+
+    void BufferPoolManager::setFlushInterval(unsigned milliseconds) {
+        std::lock_guard<std::mutex> guard(latch);
+        flushIntervalMs = milliseconds;
+        flushWanted.notify_one();
+    }
+
+    void BufferPoolManager::setLogManager(LogManager *log) {
+        std::lock_guard<std::mutex> guard(latch);
+        this->log = log;
+    }
+
+    RC BufferPoolManager::collectFlushCounterValues(unsigned &syncCount, unsigned &cycleCount) {
+        std::lock_guard<std::mutex> guard(latch);
+        syncCount = this->syncCount;
+        cycleCount = this->cycleCount;
+        return 0;
+    }
+
+    void BufferPoolManager::waitForFlusherLocked(std::unique_lock<std::mutex> &lock) {
+        flushDone.wait(lock, [this] { return !flushInProgress; });
+    }
+
+    void BufferPoolManager::runFlusher() {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            // Any wakeup runs a cycle, so a changed interval takes effect at once.
+            if (!stopping && flushRequested == flushCompleted) {
+                if (flushIntervalMs == 0) {
+                    flushWanted.wait(lock);
+                } else {
+                    flushWanted.wait_for(lock, std::chrono::milliseconds(flushIntervalMs));
+                }
+            }
+            if (stopping) break;
+
+            // sync() calls arriving during this cycle get the next one.
+            unsigned long long generation = flushRequested;
+            // A pass stages only part of each pool, so the cycle repeats passes until nothing is held back.
+            LSN redoLsn = 0;
+            bool more = true;
+            for (flushResult = 0; flushResult == 0 && more && !stopping;) {
+                flushResult = flushDirtyPages(lock, redoLsn, more);
+            }
+            LogManager *log = this->log;
+            if (flushResult == 0 && redoLsn != 0 && log != nullptr) {
+                lock.unlock();
+                log->checkpointIfDue(redoLsn);
+                lock.lock();
+            }
+            flushCompleted = generation;
+            cycleCount++;
+            flushDone.notify_all();
+        }
+        // Nobody waits for the answer any more, but no sync() caller may stay blocked either.
+        flushCompleted = flushRequested;
+        flushDone.notify_all();
+    }
+
+    RC BufferPoolManager::flushDirtyPages(std::unique_lock<std::mutex> &lock, LSN &redoLsn, bool &more) {
+        // Once this cycle's writes and fsyncs succeed, only changes logged from here on may be missing from disk.
+        redoLsn = log != nullptr ? log->getEndLsn() : 0;
+        for (const Frame &frame : frames) {
+            if (frame.valid && frame.recLsn != 0 && frame.recLsn < redoLsn) redoLsn = frame.recLsn;
+        }
+
+        // Pinned frames may be in the middle of an update, so they wait for a later cycle.
+        // Compressed pages move between slots as their size changes, so they are written under the latch.
+        // Flushing frames cannot be evicted, and read-ahead may keep half of a pool loading, so a pass stages at
+        // most a quarter of each pool and readers always find a victim.
+        RC compressedResult = 0;
+        LSN maxLsn = 0;
+        std::vector<unsigned> dirty;
+        std::unordered_map<unsigned, unsigned> stagedFrames;            // page size -> frames staged in its pool
+        more = false;
+        for (unsigned i = 0; i < frames.size(); i++) {
+            Frame &frame = frames[i];
+            if (!frame.valid || !frame.dirty || frame.loading || frame.pinCount > 0) continue;
+            if (files.at(frame.fileId).compressed == nullptr) {
+                unsigned &poolStaged = stagedFrames[frame.pageSize];
+                if (poolStaged >= std::max(findPoolLocked(frame.pageSize)->count / 4, 1u)) {
+                    more = true;
+                    continue;
+                }
+                poolStaged++;
+                dirty.push_back(i);
+            } else if (logPendingLocked(frame)) {
+                // The log flush below makes its change durable, and the next pass writes it.
+                maxLsn = std::max(maxLsn, frame.lsn);
+                more = true;
+            } else if (writeFrame(frame) != 0) {
+                compressedResult = -1;
+            }
+        }
+        for (auto &file : files) {
+            if (file.second.compressed != nullptr && file.second.unsynced && file.second.compressed->sync() != 0) {
+                compressedResult = -1;
+            }
+        }
+        std::sort(dirty.begin(), dirty.end(), [this](unsigned a, unsigned b) {
+            return pageKey(frames[a].fileId, frames[a].pageNum) < pageKey(frames[b].fileId, frames[b].pageNum);
+        });
+
+        // Stage copies so the writes can run without the latch; a flushing frame stays resident,
+        // and a page dirtied again meanwhile is simply written by the next cycle.
+        typedef struct Run {
+            int fd;
+            PageNum pageNum;
+            unsigned pageSize;
+            unsigned first;         // index into dirty
+            unsigned count;
+            size_t staged;          // offset of the run in the staging buffer
+        } Run;
+        size_t stagingSize = 0;
+        for (unsigned frameId : dirty) {
+            stagingSize += frames[frameId].pageSize;
+        }
+        std::vector<char> staging(stagingSize);
+        std::vector<Run> runs;
+        std::vector<LSN> stagedLsns(dirty.size());
+        std::vector<LSN> stagedRecLsns(dirty.size());
+        size_t staged = 0;
+        for (unsigned i = 0; i < dirty.size(); i++) {
+            Frame &frame = frames[dirty[i]];
+            memcpy(&staging[staged], frame.data, frame.pageSize);
+            stagedLsns[i] = frame.lsn;
+            stagedRecLsns[i] = frame.recLsn;
+            if (frame.lsn > maxLsn) maxLsn = frame.lsn;
+            frame.dirty = false;
+            frame.lsn = 0;
+            frame.recLsn = 0;
+            frame.flushing = true;
+
+            FileEntry &file = files.at(frame.fileId);
+            file.unsynced = true;
+            Run *last = runs.empty() ? nullptr : &runs.back();
+            if (last != nullptr && last->fd == file.fd && last->pageNum + last->count == frame.pageNum &&
+                last->count < BPM_FLUSH_MAX_RUN) {
+                last->count++;
+            } else {
+                runs.push_back(Run{file.fd, frame.pageNum, frame.pageSize, i, 1, staged});
+            }
+            staged += frame.pageSize;
+        }
+
+        std::vector<std::pair<unsigned, int> > unsynced;
+        for (auto &file : files) {
+            if (!file.second.unsynced) continue;
+            unsynced.emplace_back(file.first, file.second.fd);
+            file.second.unsynced = false;
+        }
+        if (runs.empty() && unsynced.empty() && maxLsn == 0) return compressedResult;
+
+        // Closing a file or writing pages directly waits for flushInProgress, so the descriptors stay open.
+        flushInProgress = true;
+        LogManager *log = this->log;
+        lock.unlock();
+        RC rc = 0;
+        std::vector<bool> failed(runs.size(), false);
+        // One log flush covers every staged page, and no page reaches the disk before its log records.
+        bool logged = maxLsn == 0 || log == nullptr || log->flush(maxLsn) == 0;
+        for (size_t i = 0; i < runs.size(); i++) {
+            const Run &run = runs[i];
+            if (!logged) {
+                failed[i] = true;
+                rc = -1;
+                continue;
+            }
+            size_t length = (size_t) run.count * run.pageSize;
+            if (pwrite(run.fd, &staging[run.staged], length, pageOffset(run.pageNum, run.pageSize)) !=
+                (ssize_t) length) {
+                failed[i] = true;
+                rc = -1;
+            }
+        }
+        std::vector<bool> syncFailed(unsynced.size(), false);
+        for (size_t i = 0; i < unsynced.size(); i++) {
+            if (fdatasync(unsynced[i].second) != 0) {
+                syncFailed[i] = true;
+                rc = -1;
+            }
+        }
+        lock.lock();
+
+        for (size_t i = 0; i < runs.size(); i++) {
+            for (unsigned j = runs[i].first; j < runs[i].first + runs[i].count; j++) {
+                Frame &frame = frames[dirty[j]];
+                frame.flushing = false;
+                if (!failed[i]) continue;
+                frame.dirty = true;
+                if (stagedLsns[j] > frame.lsn) frame.lsn = stagedLsns[j];
+                if (stagedRecLsns[j] != 0 && (frame.recLsn == 0 || stagedRecLsns[j] < frame.recLsn)) {
+                    frame.recLsn = stagedRecLsns[j];
+                }
+            }
+        }
+        for (size_t i = 0; i < unsynced.size(); i++) {
+            if (syncFailed[i]) files.at(unsynced[i].first).unsynced = true;
+        }
+        flushInProgress = false;
+        flushDone.notify_all();
+        return rc == 0 ? compressedResult : rc;
+    }
+
+} // namespace PeterDB
@@ -0,0 +1,270 @@
+#include "src/include/compress.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+namespace PeterDB {
+
+    static const unsigned MIN_MATCH = 4;
+    static const unsigned MAX_OFFSET = 65535;
+    static const unsigned HASH_BITS = 12;
+
+    static const unsigned COMPRESSED_MAGIC = 0x5a504443; // "CDPZ"
+    static const unsigned MAP_BLOCK_MAGIC = 0x4b4c424d; // "MBLK"
+
+    // Stored at PFM_COMPRESSED_HEADER_OFFSET, after the FileHeader of the hidden header page.
+    typedef struct CompressedFileHeader {
+        unsigned magic;
+        unsigned numPages;
+        unsigned long long firstMapBlock;       // 0 while the file has no pages
+        unsigned long long dataEnd;
+    } CompressedFileHeader;
+
+    typedef struct MapBlockHeader {
+        unsigned magic;
+        unsigned reserved;
+        unsigned long long next;                // 0 in the last block
+    } MapBlockHeader;
+
+    static unsigned read32(const char *p) {
+        unsigned value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static unsigned hash32(unsigned value) {
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    static bool putLength(char *target, unsigned capacity, unsigned &out, unsigned length) {
+        while (length >= 255) {
+            if (out >= capacity) return false;
+            target[out++] = (char) 255;
+            length -= 255;
+        }
+        if (out >= capacity) return false;
+        target[out++] = (char) length;
+        return true;
+    }
+
+    static bool getLength(const char *source, unsigned size, unsigned &in, unsigned &length) {
+        unsigned char byte;
+        do {
+            if (in >= size) return false;
+            byte = (unsigned char) source[in++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // One sequence: literals, then a match unless matchLength is 0 (the last sequence).
+    static bool putSequence(char *target, unsigned capacity, unsigned &out, const char *literals,
+                            unsigned literalLength, unsigned offset, unsigned matchLength) {
+        if (out >= capacity) return false;
+        unsigned token = out++;
+        unsigned matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+        target[token] = (char) (((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+        if (literalLength >= 15 && !putLength(target, capacity, out, literalLength - 15)) return false;
+        if (out + literalLength > capacity) return false;
+        memcpy(target + out, literals, literalLength);
+        out += literalLength;
+        if (matchLength == 0) return true;
+
+        if (out + 2 > capacity) return false;
+        target[out++] = (char) (offset & 0xff);
+        target[out++] = (char) (offset >> 8);
+        return matchCode < 15 || putLength(target, capacity, out, matchCode - 15);
+    }
+
+    unsigned PageCodec::compress(const char *source, unsigned size, char *target, unsigned capacity) {
+        // Positions are stored plus one, so 0 marks an empty bucket.
+        unsigned table[1 << HASH_BITS];
+        memset(table, 0, sizeof(table));
+
+        unsigned in = 0, anchor = 0, out = 0;
+        while (in + MIN_MATCH <= size) {
+            unsigned value = read32(source + in);
+            unsigned &bucket = table[hash32(value)];
+            unsigned candidate = bucket;
+            bucket = in + 1;
+            if (candidate == 0 || in - (candidate - 1) > MAX_OFFSET || read32(source + candidate - 1) != value) {
+                in++;
+                continue;
+            }
+
+            unsigned match = candidate - 1;
+            unsigned length = MIN_MATCH;
+            while (in + length < size && source[match + length] == source[in + length]) length++;
+            if (!putSequence(target, capacity, out, source + anchor, in - anchor, in - match, length)) return 0;
+            in += length;
+            anchor = in;
+        }
+        if (!putSequence(target, capacity, out, source + anchor, size - anchor, 0, 0)) return 0;
+        return out;
+    }
+
+    RC PageCodec::decompress(const char *source, unsigned size, char *target, unsigned targetSize) {
+        unsigned in = 0, out = 0;
+        while (in < size) {
+            unsigned token = (unsigned char) source[in++];
+            unsigned literalLength = token >> 4;
+            if (literalLength == 15 && !getLength(source, size, in, literalLength)) return -1;
+            if (in + literalLength > size || out + literalLength > targetSize) return -1;
+            memcpy(target + out, source + in, literalLength);
+            in += literalLength;
+            out += literalLength;
+            if (in == size) break;
+
+            if (in + 2 > size) return -1;
+            unsigned offset = (unsigned char) source[in] | ((unsigned) (unsigned char) source[in + 1] << 8);
+            in += 2;
+            unsigned matchLength = (token & 15) + MIN_MATCH;
+            if ((token & 15) == 15 && !getLength(source, size, in, matchLength)) return -1;
+            if (offset == 0 || offset > out || out + matchLength > targetSize) return -1;
+
+            // The match may overlap the bytes it produces, e.g. a run of one repeated byte. The bytes from the
+            // match to the output repeat with period offset, so a copy from the match start may double each time.
+            const char *match = target + out - offset;
+            for (unsigned copied = 0; copied < matchLength;) {
+                unsigned chunk = std::min(offset + copied, matchLength - copied);
+                memcpy(target + out + copied, match, chunk);
+                copied += chunk;
+            }
+            out += matchLength;
+        }
+        return out == targetSize ? 0 : -1;
+    }
+
+    CompressedFile::CompressedFile(int fd, unsigned pageSize)
+            : fd(fd), pageSize(pageSize), slotsPerBlock((pageSize - sizeof(MapBlockHeader)) / sizeof(PageSlot)),
+              dataEnd(pageSize), headerDirty(false), buffer(pageSize) {}
+
+    RC CompressedFile::format(int fd, unsigned pageSize) {
+        CompressedFileHeader header{COMPRESSED_MAGIC, 0, 0, pageSize};
+        return pwrite(fd, &header, sizeof(header), PFM_COMPRESSED_HEADER_OFFSET) == sizeof(header) ? 0 : -1;
+    }
+
+    CompressedFile *CompressedFile::open(int fd, unsigned pageSize) {
+        CompressedFileHeader header{};
+        if (pread(fd, &header, sizeof(header), PFM_COMPRESSED_HEADER_OFFSET) != sizeof(header) ||
+            header.magic != COMPRESSED_MAGIC) {
+            return nullptr;
+        }
+
+        CompressedFile *file = new CompressedFile(fd, pageSize);
+        file->dataEnd = header.dataEnd;
+        file->slots.resize(header.numPages);
+        std::vector<char> block(pageSize);
+        unsigned long long offset = header.firstMapBlock;
+        for (PageNum first = 0; first < header.numPages; first += file->slotsPerBlock) {
+            MapBlockHeader blockHeader{};
+            if (offset == 0 || pread(fd, block.data(), pageSize, (off_t) offset) != (ssize_t) pageSize) break;
+            memcpy(&blockHeader, block.data(), sizeof(blockHeader));
+            if (blockHeader.magic != MAP_BLOCK_MAGIC) break;
+
+            unsigned count = std::min(file->slotsPerBlock, header.numPages - first);
+            memcpy(&file->slots[first], block.data() + sizeof(MapBlockHeader), (size_t) count * sizeof(PageSlot));
+            file->mapBlocks.push_back(offset);
+            file->dirtyBlocks.push_back(false);
+            offset = blockHeader.next;
+        }
+        if ((unsigned long long) file->mapBlocks.size() * file->slotsPerBlock < header.numPages) {
+            delete file;
+            return nullptr;
+        }
+        return file;
+    }
+
+    unsigned CompressedFile::getNumberOfPages() const {
+        return (unsigned) slots.size();
+    }
+
+    RC CompressedFile::readPage(PageNum pageNum, void *data) {
+        if (pageNum >= slots.size()) return -1;
+        const PageSlot &slot = slots[pageNum];
+        if (slot.length == pageSize) {
+            return pread(fd, data, pageSize, (off_t) slot.offset) == (ssize_t) pageSize ? 0 : -1;
+        }
+        if (slot.length == 0 || pread(fd, buffer.data(), slot.length, (off_t) slot.offset) != (ssize_t) slot.length) {
+            return -1;
+        }
+        return PageCodec::decompress(buffer.data(), slot.length, (char *) data, pageSize);
+    }
+
+    RC CompressedFile::writePage(PageNum pageNum, const void *data) {
+        if (pageNum >= slots.size()) return -1;
+
+        // A page that does not shrink by at least one slot step is stored as it is.
+        const char *image = buffer.data();
+        unsigned length = PageCodec::compress((const char *) data, pageSize, buffer.data(),
+                                              pageSize - PFM_COMPRESSED_SLOT_ALIGN);
+        if (length == 0) {
+            image = (const char *) data;
+            length = pageSize;
+        }
+
+        PageSlot slot = slots[pageNum];
+        if (length > slot.capacity) {
+            slot.offset = dataEnd;
+            slot.capacity = (length + PFM_COMPRESSED_SLOT_ALIGN - 1) / PFM_COMPRESSED_SLOT_ALIGN *
+                            PFM_COMPRESSED_SLOT_ALIGN;
+        }
+        if (pwrite(fd, image, length, (off_t) slot.offset) != (ssize_t) length) return -1;
+        if (slot.offset == dataEnd) {
+            dataEnd += slot.capacity;
+            headerDirty = true;
+        }
+        if (slot.length != length || slot.offset != slots[pageNum].offset) {
+            slot.length = length;
+            slots[pageNum] = slot;
+            dirtyBlocks[pageNum / slotsPerBlock] = true;
+        }
+        return 0;
+    }
+
+    RC CompressedFile::appendPage(const void *data, PageNum &pageNum) {
+        pageNum = (PageNum) slots.size();
+        if (pageNum % slotsPerBlock == 0) {
+            // The first page of a new range brings the map block that describes the range.
+            mapBlocks.push_back(dataEnd);
+            dirtyBlocks.push_back(true);
+            if (mapBlocks.size() > 1) dirtyBlocks[mapBlocks.size() - 2] = true;
+            dataEnd += pageSize;
+        }
+        slots.push_back(PageSlot{0, 0, 0});
+        headerDirty = true;
+        if (writePage(pageNum, data) != 0) {
+            slots.pop_back();
+            return -1;
+        }
+        return 0;
+    }
+
+    RC CompressedFile::sync() {
+        RC rc = 0;
+        std::vector<char> block(pageSize);
+        for (size_t i = 0; i < mapBlocks.size(); i++) {
+            if (!dirtyBlocks[i]) continue;
+            memset(block.data(), 0, pageSize);
+            MapBlockHeader blockHeader{MAP_BLOCK_MAGIC, 0, i + 1 < mapBlocks.size() ? mapBlocks[i + 1] : 0};
+            memcpy(block.data(), &blockHeader, sizeof(blockHeader));
+            size_t first = i * slotsPerBlock;
+            size_t count = std::min((size_t) slotsPerBlock, slots.size() - first);
+            memcpy(block.data() + sizeof(MapBlockHeader), &slots[first], count * sizeof(PageSlot));
+            if (pwrite(fd, block.data(), pageSize, (off_t) mapBlocks[i]) != (ssize_t) pageSize) {
+                rc = -1;
+                continue;
+            }
+            dirtyBlocks[i] = false;
+        }
+        if (!headerDirty) return rc;
+
+        CompressedFileHeader header{COMPRESSED_MAGIC, (unsigned) slots.size(), mapBlocks.empty() ? 0 : mapBlocks[0],
+                                    dataEnd};
+        if (pwrite(fd, &header, sizeof(header), PFM_COMPRESSED_HEADER_OFFSET) != sizeof(header)) return -1;
+        headerDirty = false;
+        return rc;
+    }
+
+} // namespace PeterDB
@@ -1,61 +1,746 @@
 #include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "src/include/compress.h"
+
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace PeterDB {
+
+    // The hidden header page at the start of every file; the counters survive closing the file.
+    typedef struct FileHeader {
+        unsigned magic;
+        unsigned readPageCount;
+        unsigned writePageCount;
+        unsigned appendPageCount;
+        unsigned pageSize;                      // 0 in files written before page sizes were configurable
+        unsigned flags;
+    } FileHeader;
+
+    static const unsigned PFM_MAGIC = 0x46424450; // "PDBF"
+    static const unsigned PFM_FILE_COMPRESSED = 1;  // pages are stored by CompressedFile
+
+    // A file held open by the cache; its FileHandles share the descriptor and the buffer pool registration.
+    typedef struct CachedFile {
+        int fd;
+        dev_t dev;
+        ino_t ino;
+        unsigned pageSize;
+        unsigned flags;
+        unsigned readPageCount;     // counters of the last closed handle, written to the header on eviction
+        unsigned writePageCount;
+        unsigned appendPageCount;
+        unsigned refCount;          // open FileHandles
+        bool detached;              // destroyed or replaced while open; evicted on its last close
+        std::list<unsigned>::iterator idlePosition;                         // idle.end() unless idle
+    } CachedFile;
+
+    struct OpenFileCache {
+        std::mutex latch;
+        std::unordered_map<std::string, unsigned> names;                    // file name -> buffer pool fileId
+        std::unordered_map<unsigned, CachedFile> files;                     // fileId -> open file
+        std::list<unsigned> idle;                                           // least recently closed first
+        unsigned capacity;
+        unsigned openCount;                                                 // files opened on the file system
+        unsigned hitCount;                                                  // opens served by the cache
+        unsigned evictCount;
+    };
+
+    static bool validPageSize(unsigned pageSize) {
+        return pageSize >= PFM_MIN_PAGE_SIZE && pageSize <= PFM_MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+    }
+
+    static RC readHeader(int fd, FileHeader &header) {
+        if (pread(fd, &header, sizeof(FileHeader), 0) != sizeof(FileHeader)) return -1;
+        if (header.pageSize == 0) header.pageSize = PAGE_SIZE;
+        return header.magic == PFM_MAGIC && validPageSize(header.pageSize) ? 0 : -1;
+    }
+
+    static RC writeHeader(int fd, const FileHeader &header) {
+        return pwrite(fd, &header, sizeof(FileHeader), 0) == sizeof(FileHeader) ? 0 : -1;
+    }
+
     PagedFileManager &PagedFileManager::instance() {
-        static PagedFileManager _pf_manager = PagedFileManager();
+        static PagedFileManager _pf_manager;
         return _pf_manager;
     }
 
-    PagedFileManager::PagedFileManager() = default;
-
-    PagedFileManager::~PagedFileManager() = default;
+    PagedFileManager::PagedFileManager() : bpm(new BufferPoolManager()), openFiles(new OpenFileCache()) {
+        openFiles->capacity = PFM_FILE_CACHE_SIZE;
+        openFiles->openCount = 0;
+        openFiles->hitCount = 0;
+        openFiles->evictCount = 0;
+    }
 
-    PagedFileManager::PagedFileManager(const PagedFileManager &) = default;
+    PagedFileManager::~PagedFileManager() {
+        {
+            std::lock_guard<std::mutex> guard(openFiles->latch);
+            while (!openFiles->files.empty()) {
+                evictFileLocked(openFiles->files.begin()->first);
+            }
+        }
+        delete openFiles;
+        delete bpm;
+    }
 
-    PagedFileManager &PagedFileManager::operator=(const PagedFileManager &) = default;
+    // The copy operations stay declared and undefined: a copy would share the pool and file cache it deletes.
 
     RC PagedFileManager::createFile(const std::string &fileName) {
-        return -1;
+        return createFile(fileName, PAGE_SIZE);
+    }
+
+    RC PagedFileManager::createFile(const std::string &fileName, unsigned pageSize) {
+        return createFileWithFlags(fileName, pageSize, 0);
+    }
+
+    RC PagedFileManager::createCompressedFile(const std::string &fileName, unsigned pageSize) {
+        return createFileWithFlags(fileName, pageSize, PFM_FILE_COMPRESSED);
+    }
+
+    RC PagedFileManager::createFileWithFlags(const std::string &fileName, unsigned pageSize, unsigned flags) {
+        if (!validPageSize(pageSize)) return -1;
+        int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) return -1;
+        {
+            // The name was free, so a cached file of that name was deleted behind our back.
+            std::lock_guard<std::mutex> guard(openFiles->latch);
+            forgetFileLocked(fileName);
+        }
+
+        // The header occupies a whole page, so data pages stay aligned to the page size.
+        std::vector<char> page(pageSize, 0);
+        FileHeader header{PFM_MAGIC, 0, 0, 0, pageSize, flags};
+        memcpy(page.data(), &header, sizeof(FileHeader));
+        RC rc = pwrite(fd, page.data(), pageSize, 0) == (ssize_t) pageSize ? 0 : -1;
+        if (rc == 0 && (flags & PFM_FILE_COMPRESSED) != 0) rc = CompressedFile::format(fd, pageSize);
+        close(fd);
+        return rc;
     }
 
     RC PagedFileManager::destroyFile(const std::string &fileName) {
-        return -1;
+        std::lock_guard<std::mutex> guard(openFiles->latch);
+        forgetFileLocked(fileName);
+        return unlink(fileName.c_str()) == 0 ? 0 : -1;
+    }
+
+    // Returns a cached file that still is the file of that name; a stale entry is forgotten.
+    bool PagedFileManager::findFileLocked(const std::string &fileName, unsigned &fileId) {
+        auto it = openFiles->names.find(fileName);
+        if (it == openFiles->names.end()) return false;
+        const CachedFile &file = openFiles->files.at(it->second);
+        struct stat st{};
+        if (stat(fileName.c_str(), &st) != 0 || st.st_dev != file.dev || st.st_ino != file.ino) {
+            forgetFileLocked(fileName);
+            return false;
+        }
+        fileId = it->second;
+        return true;
+    }
+
+    void PagedFileManager::forgetFileLocked(const std::string &fileName) {
+        auto it = openFiles->names.find(fileName);
+        if (it == openFiles->names.end()) return;
+        unsigned fileId = it->second;
+        openFiles->names.erase(it);
+
+        // Another name may still lead to the same file.
+        for (auto &name : openFiles->names) {
+            if (name.second == fileId) return;
+        }
+        CachedFile &file = openFiles->files.at(fileId);
+        if (file.refCount > 0) {
+            file.detached = true;
+        } else {
+            evictFileLocked(fileId);
+        }
+    }
+
+    RC PagedFileManager::evictFileLocked(unsigned fileId) {
+        CachedFile &file = openFiles->files.at(fileId);
+        FileHeader header{PFM_MAGIC, file.readPageCount, file.writePageCount, file.appendPageCount, file.pageSize,
+                          file.flags};
+        RC rc = writeHeader(file.fd, header);
+        if (bpm->unregisterFile(fileId) != 0) rc = -1;
+        if (close(file.fd) != 0) rc = -1;
+        if (file.idlePosition != openFiles->idle.end()) openFiles->idle.erase(file.idlePosition);
+        for (auto name = openFiles->names.begin(); name != openFiles->names.end();) {
+            name = name->second == fileId ? openFiles->names.erase(name) : std::next(name);
+        }
+        openFiles->files.erase(fileId);
+        openFiles->evictCount++;
+        return rc;
     }
 
     RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
-        return -1;
+        if (fileHandle.fd >= 0) return -1;
+
+        std::lock_guard<std::mutex> guard(openFiles->latch);
+        unsigned fileId;
+        if (findFileLocked(fileName, fileId)) {
+            openFiles->hitCount++;
+        } else {
+            int fd = open(fileName.c_str(), O_RDWR);
+            if (fd < 0) return -1;
+            struct stat st{};
+            FileHeader header{};
+            if (readHeader(fd, header) != 0 || fstat(fd, &st) != 0 ||
+                bpm->registerFile(fd, header.pageSize, fileId, (header.flags & PFM_FILE_COMPRESSED) != 0) != 0) {
+                close(fd);
+                return -1;
+            }
+            openFiles->openCount++;
+
+            auto cached = openFiles->files.find(fileId);
+            if (cached != openFiles->files.end()) {
+                // Another name of a file that is already open.
+                bpm->unregisterFile(fileId);
+                close(fd);
+            } else {
+                CachedFile file{fd, st.st_dev, st.st_ino, header.pageSize, header.flags, header.readPageCount,
+                                header.writePageCount, header.appendPageCount, 0, false, openFiles->idle.end()};
+                openFiles->files[fileId] = file;
+            }
+            openFiles->names[fileName] = fileId;
+        }
+
+        CachedFile &file = openFiles->files.at(fileId);
+        if (file.idlePosition != openFiles->idle.end()) {
+            openFiles->idle.erase(file.idlePosition);
+            file.idlePosition = openFiles->idle.end();
+        }
+        file.refCount++;
+        fileHandle.fd = file.fd;
+        fileHandle.fileId = fileId;
+        fileHandle.fileName = fileName;
+        fileHandle.pageSize = file.pageSize;
+        fileHandle.compressed = (file.flags & PFM_FILE_COMPRESSED) != 0;
+        fileHandle.readPageCounter = file.readPageCount;
+        fileHandle.writePageCounter = file.writePageCount;
+        fileHandle.appendPageCounter = file.appendPageCount;
+        fileHandle.cacheHitCounter = 0;
+        fileHandle.cacheMissCounter = 0;
+        fileHandle.prefetchPageCounter = 0;
+        fileHandle.extentCounter = 0;
+        fileHandle.readAhead = ReadAheadState{(PageNum) -1, 0, 0, 0};
+        return 0;
+    }
+
+    RC PagedFileManager::openFileMapped(const std::string &fileName, FileHandle &fileHandle) {
+        if (fileHandle.fd >= 0) return -1;
+
+        // The mapping shows what is on disk, so write back pages other handles still hold dirty.
+        if (bpm->flushAll() != 0) return -1;
+
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return -1;
+        struct stat st{};
+        FileHeader header{};
+        if (readHeader(fd, header) != 0 || fstat(fd, &st) != 0 || (header.flags & PFM_FILE_COMPRESSED) != 0) {
+            close(fd);
+            return -1;
+        }
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+        {
+            // The header on disk lags behind the counters of a cached file.
+            std::lock_guard<std::mutex> guard(openFiles->latch);
+            unsigned fileId;
+            if (findFileLocked(fileName, fileId)) {
+                const CachedFile &file = openFiles->files.at(fileId);
+                header.readPageCount = file.readPageCount;
+                header.writePageCount = file.writePageCount;
+                header.appendPageCount = file.appendPageCount;
+            }
+        }
+
+        fileHandle.fd = fd;
+        fileHandle.fileName = fileName;
+        fileHandle.pageSize = header.pageSize;
+        fileHandle.mapped = true;
+        fileHandle.compressed = false;
+        fileHandle.mapping = (char *) mapping;
+        fileHandle.mappingSize = st.st_size;
+        fileHandle.adviseNextPageNum = 0;
+        fileHandle.readPageCounter = header.readPageCount;
+        fileHandle.writePageCounter = header.writePageCount;
+        fileHandle.appendPageCounter = header.appendPageCount;
+        fileHandle.cacheHitCounter = 0;
+        fileHandle.cacheMissCounter = 0;
+        fileHandle.prefetchPageCounter = 0;
+        fileHandle.extentCounter = 0;
+        fileHandle.readAhead = ReadAheadState{(PageNum) -1, 0, 0, 0};
+        return 0;
     }
 
     RC PagedFileManager::closeFile(FileHandle &fileHandle) {
-        return -1;
+        if (fileHandle.fd < 0) return -1;
+
+        if (fileHandle.mapped) {
+            // The descriptor is read-only; counters of a mapped session are not persisted.
+            RC rc = munmap(fileHandle.mapping, fileHandle.mappingSize) == 0 ? 0 : -1;
+            for (auto &retired : fileHandle.retiredMappings) {
+                if (munmap(retired.first, retired.second) != 0) rc = -1;
+            }
+            fileHandle.retiredMappings.clear();
+            fileHandle.mapped = false;
+            fileHandle.mapping = nullptr;
+            fileHandle.mappingSize = 0;
+            if (close(fileHandle.fd) != 0) rc = -1;
+            fileHandle.fd = -1;
+            return rc;
+        }
+
+        if (fileHandle.scanRing != 0) {
+            bpm->dropRing(fileHandle.scanRing);
+            fileHandle.scanRing = 0;
+        }
+        std::lock_guard<std::mutex> guard(openFiles->latch);
+        auto it = openFiles->files.find(fileHandle.fileId);
+        if (it == openFiles->files.end() || it->second.refCount == 0) return -1;
+        CachedFile &file = it->second;
+        file.readPageCount = fileHandle.readPageCounter;
+        file.writePageCount = fileHandle.writePageCounter;
+        file.appendPageCount = fileHandle.appendPageCounter;
+        fileHandle.fd = -1;
+        if (--file.refCount > 0) return 0;
+
+        if (file.detached || openFiles->capacity == 0) return evictFileLocked(fileHandle.fileId);
+        file.idlePosition = openFiles->idle.insert(openFiles->idle.end(), fileHandle.fileId);
+        RC rc = 0;
+        while (openFiles->idle.size() > openFiles->capacity) {
+            if (evictFileLocked(openFiles->idle.front()) != 0) rc = -1;
+        }
+        return rc;
+    }
+
+    BufferPoolManager &PagedFileManager::bufferPool() {
+        return *bpm;
+    }
+
+    RC PagedFileManager::setBufferPoolSize(unsigned numFrames) {
+        return bpm->resize(numFrames);
+    }
+
+    RC PagedFileManager::setExtentSize(unsigned bytes) {
+        bpm->setExtentSize(bytes);
+        return 0;
+    }
+
+    RC PagedFileManager::setFileCacheSize(unsigned numFiles) {
+        std::lock_guard<std::mutex> guard(openFiles->latch);
+        openFiles->capacity = numFiles;
+        RC rc = 0;
+        while (openFiles->idle.size() > openFiles->capacity) {
+            if (evictFileLocked(openFiles->idle.front()) != 0) rc = -1;
+        }
+        return rc;
+    }
+
+    RC PagedFileManager::collectFileCacheCounterValues(unsigned &openCount, unsigned &hitCount, unsigned &evictCount) {
+        std::lock_guard<std::mutex> guard(openFiles->latch);
+        openCount = openFiles->openCount;
+        hitCount = openFiles->hitCount;
+        evictCount = openFiles->evictCount;
+        return 0;
+    }
+
+    RC PagedFileManager::setFlushInterval(unsigned milliseconds) {
+        bpm->setFlushInterval(milliseconds);
+        return 0;
+    }
+
+    PageGuard::PageGuard() : frame(nullptr), pageNum(0), frameId(0), dirty(false), mapped(false), lsn(0) {}
+
+    PageGuard::~PageGuard() {
+        release();
+    }
+
+    PageGuard::PageGuard(PageGuard &&other) noexcept
+            : frame(other.frame), pageNum(other.pageNum), frameId(other.frameId), dirty(other.dirty),
+              mapped(other.mapped), lsn(other.lsn) {
+        other.frame = nullptr;
+        other.dirty = false;
+        other.lsn = 0;
+    }
+
+    PageGuard &PageGuard::operator=(PageGuard &&other) noexcept {
+        if (this != &other) {
+            release();
+            frame = other.frame;
+            pageNum = other.pageNum;
+            frameId = other.frameId;
+            dirty = other.dirty;
+            mapped = other.mapped;
+            lsn = other.lsn;
+            other.frame = nullptr;
+            other.dirty = false;
+            other.lsn = 0;
+        }
+        return *this;
+    }
+
+    const char *PageGuard::data() const {
+        return frame;
+    }
+
+    PageNum PageGuard::getPageNum() const {
+        return pageNum;
+    }
+
+    bool PageGuard::isPinned() const {
+        return frame != nullptr;
+    }
+
+    void PageGuard::release() {
+        if (frame == nullptr) return;
+        if (!mapped) PagedFileManager::instance().bufferPool().unpinPage(frameId, dirty, lsn);
+        frame = nullptr;
+        dirty = false;
+        lsn = 0;
+    }
+
+    char *WritePageGuard::data() {
+        return frame;
+    }
+
+    void WritePageGuard::setLsn(LSN lsn) {
+        if (lsn > this->lsn) this->lsn = lsn;
     }
 
     FileHandle::FileHandle() {
         readPageCounter = 0;
         writePageCounter = 0;
         appendPageCounter = 0;
+        cacheHitCounter = 0;
+        cacheMissCounter = 0;
+        prefetchPageCounter = 0;
+        extentCounter = 0;
+        fd = -1;
+        fileId = 0;
+        pageSize = PAGE_SIZE;
+        readAhead = ReadAheadState{(PageNum) -1, 0, 0, 0};
+        accessPattern = PFM_ACCESS_DEFAULT;
+        scanRing = 0;
+        compressed = false;
+        mapped = false;
+        mapping = nullptr;
+        mappingSize = 0;
+        adviseNextPageNum = 0;
     }
 
     FileHandle::~FileHandle() = default;
 
+    // A copy takes a snapshot of the counters only. The descriptor, scan ring and mapping belong to the handle
+    // that opened them and are released by its close, so a copied handle is closed, and an assigned one keeps
+    // whatever file it has open.
+    FileHandle::FileHandle(const FileHandle &other) : FileHandle() {
+        copyCounters(other);
+    }
+
+    FileHandle &FileHandle::operator=(const FileHandle &other) {
+        if (this != &other) copyCounters(other);
+        return *this;
+    }
+
+    void FileHandle::copyCounters(const FileHandle &other) {
+        readPageCounter = other.readPageCounter.load();
+        writePageCounter = other.writePageCounter.load();
+        appendPageCounter = other.appendPageCounter.load();
+        cacheHitCounter = other.cacheHitCounter.load();
+        cacheMissCounter = other.cacheMissCounter.load();
+        prefetchPageCounter = other.prefetchPageCounter.load();
+        extentCounter = other.extentCounter.load();
+    }
+
     RC FileHandle::readPage(PageNum pageNum, void *data) {
-        return -1;
+        PageGuard guard;
+        if (pinPage(pageNum, guard) != 0) return -1;
+        memcpy(data, guard.data(), pageSize);
+        return 0;
     }
 
     RC FileHandle::writePage(PageNum pageNum, const void *data) {
-        return -1;
+        if (fd < 0 || mapped) return -1;
+        unsigned ring;
+        {
+            std::lock_guard<std::mutex> lock(latch);
+            ring = scanRingLocked();
+        }
+        if (PagedFileManager::instance().bufferPool().writePage(fileId, pageNum, data, ring) != 0) return -1;
+        writePageCounter++;
+        return 0;
     }
 
     RC FileHandle::appendPage(const void *data) {
-        return -1;
+        if (fd < 0 || mapped) return -1;
+        PageNum pageNum;
+        unsigned extents, ring;
+        {
+            std::lock_guard<std::mutex> lock(latch);
+            ring = scanRingLocked();
+        }
+        if (PagedFileManager::instance().bufferPool().appendPage(fileId, data, pageNum, extents, ring) != 0) {
+            return -1;
+        }
+        appendPageCounter++;
+        extentCounter += extents;
+        return 0;
+    }
+
+    RC FileHandle::readPages(PageNum pageNum, unsigned count, void *data) {
+        if (fd < 0) return -1;
+        if (mapped) {
+            std::lock_guard<std::mutex> lock(latch);
+            if (count == 0 || mappedPageLocked(pageNum + count - 1) == nullptr) return -1;
+            memcpy(data, mappedPageLocked(pageNum), (size_t) count * pageSize);
+            readPageCounter += count;
+            return 0;
+        }
+        unsigned hits = 0;
+        if (PagedFileManager::instance().bufferPool().readPages(fileId, pageNum, count, data, hits) != 0) return -1;
+        readPageCounter += count;
+        cacheHitCounter += hits;
+        cacheMissCounter += count - hits;
+        return 0;
+    }
+
+    RC FileHandle::writePages(PageNum pageNum, unsigned count, const void *data) {
+        if (fd < 0 || mapped) return -1;
+        if (PagedFileManager::instance().bufferPool().writePages(fileId, pageNum, count, data) != 0) return -1;
+        writePageCounter += count;
+        return 0;
+    }
+
+    RC FileHandle::appendPages(unsigned count, const void *data) {
+        if (fd < 0 || mapped) return -1;
+        PageNum pageNum;
+        unsigned extents;
+        if (PagedFileManager::instance().bufferPool().appendPages(fileId, count, data, pageNum, extents) != 0) {
+            return -1;
+        }
+        appendPageCounter += count;
+        extentCounter += extents;
+        return 0;
     }
 
     unsigned FileHandle::getNumberOfPages() {
-        return -1;
+        if (fd < 0) return 0;
+        if (mapped) {
+            std::lock_guard<std::mutex> lock(latch);
+            return getNumberOfMappedPagesLocked();
+        }
+        return PagedFileManager::instance().bufferPool().getNumberOfPages(fileId);
+    }
+
+    const std::string &FileHandle::getFileName() const {
+        return fileName;
+    }
+
+    unsigned FileHandle::getPageSize() const {
+        return pageSize;
+    }
+
+    unsigned FileHandle::getNumberOfMappedPagesLocked() {
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size <= mappingSize) {
+            return (unsigned) (mappingSize / pageSize - 1);
+        }
+
+        // The file grew: extend the mapping in place if possible, otherwise map it anew. Pages already
+        // handed out may still be in use, so an outgrown mapping is kept until the file is closed.
+        size_t size = st.st_size;
+        void *grown = mremap(mapping, mappingSize, size, 0);
+        if (grown == MAP_FAILED) {
+            grown = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (grown == MAP_FAILED) return (unsigned) (mappingSize / pageSize - 1);
+            retiredMappings.emplace_back(mapping, mappingSize);
+        }
+        mapping = (char *) grown;
+        mappingSize = size;
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+        return (unsigned) (mappingSize / pageSize - 1);
+    }
+
+    const char *FileHandle::mappedPageLocked(PageNum pageNum) {
+        // Only a page past the current mapping costs an fstat, to see whether the file grew.
+        if (BufferPoolManager::pageOffset(pageNum, pageSize) + pageSize > (off_t) mappingSize &&
+            pageNum >= getNumberOfMappedPagesLocked()) {
+            return nullptr;
+        }
+        return mapping + BufferPoolManager::pageOffset(pageNum, pageSize);
+    }
+
+    RC FileHandle::pinPage(PageNum pageNum, PageGuard &guard) {
+        return pinFrame(pageNum, guard, false, true);
+    }
+
+    // Pages pinned in ascending order with gaps, like the pages of a sorted RID list, often land next to each
+    // other; they must not start read-ahead of pages nobody asked for.
+    RC FileHandle::pinPageNoReadAhead(PageNum pageNum, PageGuard &guard) {
+        return pinFrame(pageNum, guard, false, false);
+    }
+
+    RC FileHandle::pinFrame(PageNum pageNum, PageGuard &guard, bool forWrite, bool readAhead) {
+        guard.release();
+        if (fd < 0) return -1;
+        if (mapped) {
+            std::lock_guard<std::mutex> lock(latch);
+            const char *page = mappedPageLocked(pageNum);
+            if (page == nullptr) return -1;
+            // Keep the kernel a read-ahead window ahead of the reader.
+            if (readAhead && pageNum + PFM_READ_AHEAD_MAX / 2 >= adviseNextPageNum) {
+                PageNum end = pageNum + PFM_READ_AHEAD_MAX;
+                unsigned numPages = (unsigned) (mappingSize / pageSize - 1);
+                if (end > numPages) end = numPages;
+                PageNum start = adviseNextPageNum > pageNum ? adviseNextPageNum : pageNum;
+                if (start < end) {
+                    madvise(mapping + BufferPoolManager::pageOffset(start, pageSize),
+                            (size_t) (end - start) * pageSize, MADV_WILLNEED);
+                    prefetchPageCounter += end - start;
+                }
+                adviseNextPageNum = end;
+            }
+            guard.frame = (char *) page;
+            guard.pageNum = pageNum;
+            guard.mapped = true;
+            readPageCounter++;
+            return 0;
+        }
+        bool hit = false;
+        unsigned ring;
+        {
+            std::lock_guard<std::mutex> lock(latch);
+            ring = scanRingLocked();
+        }
+        if (PagedFileManager::instance().bufferPool().pinPage(fileId, pageNum, guard.frameId, guard.frame, hit,
+                                                              ring, forWrite) != 0) {
+            guard.frame = nullptr;
+            return -1;
+        }
+        guard.pageNum = pageNum;
+        guard.mapped = false;
+        readPageCounter++;
+        if (hit) {
+            cacheHitCounter++;
+        } else {
+            cacheMissCounter++;
+        }
+        if (readAhead) detectSequentialAccess(pageNum);
+        return 0;
+    }
+
+    void FileHandle::detectSequentialAccess(PageNum pageNum) {
+        std::lock_guard<std::mutex> lock(latch);
+        ReadAheadState &state = readAhead;
+        if (pageNum == state.lastPageNum) return;
+
+        if (pageNum != state.lastPageNum + 1) {
+            // Random access: stop reading ahead and forget what was queued but not yet issued.
+            if (state.window > 0) PagedFileManager::instance().bufferPool().cancelPrefetch(fileId);
+            state = ReadAheadState{pageNum, pageNum + 1, 1, 0};
+            return;
+        }
+
+        state.lastPageNum = pageNum;
+        if (++state.sequentialRun < 2 || compressed) return;
+        if (state.window == 0) {
+            state.window = PFM_READ_AHEAD_MIN;
+            state.nextPageNum = pageNum + 1;
+        } else if (state.nextPageNum - (pageNum + 1) > state.window / 2) {
+            // More than half of the window is still requested ahead of the reader.
+            return;
+        } else if (state.window < PFM_READ_AHEAD_MAX) {
+            // The reader keeps consuming read-ahead pages, so request bigger batches.
+            state.window *= 2;
+        }
+
+        PageNum end = pageNum + 1 + state.window;
+        unsigned numPages = getNumberOfPages();
+        if (end > numPages) end = numPages;
+        if (state.nextPageNum >= end) return;
+
+        unsigned count = end - state.nextPageNum;
+        BufferPoolManager &bpm = PagedFileManager::instance().bufferPool();
+        if (bpm.prefetch(fileId, state.nextPageNum, count, scanRingLocked()) == 0) {
+            prefetchPageCounter += count;
+            state.nextPageNum = end;
+        }
+    }
+
+    // Scanning handles recycle a private ring of frames instead of displacing pages other operators reuse.
+    unsigned FileHandle::scanRingLocked() {
+        bool scanning = accessPattern == PFM_ACCESS_SEQUENTIAL ||
+                        (accessPattern == PFM_ACCESS_DEFAULT && readAhead.sequentialRun >= PFM_SCAN_RING_THRESHOLD);
+        if (!scanning || mapped) return 0;
+        if (scanRing == 0) scanRing = PagedFileManager::instance().bufferPool().createRing();
+        return scanRing;
+    }
+
+    RC FileHandle::setAccessPattern(AccessPattern pattern) {
+        std::lock_guard<std::mutex> lock(latch);
+        accessPattern = pattern;
+        return 0;
+    }
+
+    RC FileHandle::prefetchPage(PageNum pageNum) {
+        if (fd < 0 || pageNum >= getNumberOfPages()) return -1;
+        if (mapped) {
+            std::lock_guard<std::mutex> lock(latch);
+            madvise(mapping + BufferPoolManager::pageOffset(pageNum, pageSize), pageSize, MADV_WILLNEED);
+            prefetchPageCounter++;
+            return 0;
+        }
+        if (PagedFileManager::instance().bufferPool().prefetch(fileId, pageNum, 1) != 0) return -1;
+        prefetchPageCounter++;
+        return 0;
+    }
+
+    RC FileHandle::flush() {
+        if (fd < 0) return -1;
+        if (mapped) return 0;
+        // One flusher cycle covers every file, so concurrent flushes share their fsyncs.
+        return PagedFileManager::instance().bufferPool().sync();
+    }
+
+    RC FileHandle::pinPageForWrite(PageNum pageNum, WritePageGuard &guard) {
+        if (mapped) return -1;
+        if (pinFrame(pageNum, guard, true, true) != 0) return -1;
+        guard.dirty = true;
+        writePageCounter++;
+        return 0;
     }
 
     RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount) {
-        return -1;
+        readPageCount = readPageCounter;
+        writePageCount = writePageCounter;
+        appendPageCount = appendPageCounter;
+        return 0;
+    }
+
+    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount,
+                                        unsigned &extentCount, unsigned &reservedPageCount) {
+        collectCounterValues(readPageCount, writePageCount, appendPageCount);
+        extentCount = extentCounter;
+        reservedPageCount = 0;
+        if (fd >= 0 && !mapped) {
+            reservedPageCount = PagedFileManager::instance().bufferPool().getReservedPages(fileId);
+        }
+        return 0;
+    }
+
+    RC FileHandle::collectCacheCounterValues(unsigned &hitCount, unsigned &missCount) {
+        hitCount = cacheHitCounter;
+        missCount = cacheMissCounter;
+        return 0;
     }
 
-} // namespace PeterDB
\ No newline at end of file
+} // namespace PeterDB
@@ -0,0 +1,483 @@
+#include "src/include/wal.h"
+#include "src/include/bpm.h"
+
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace PeterDB {
+
+    static const unsigned LOG_MAGIC = 0x474f4c50; // "PLOG"
+    static const unsigned LOG_VERSION = 1;
+
+    // Stored at offset 0; the rest of the first WAL_HEADER_SIZE bytes is zero.
+    typedef struct LogFileHeader {
+        unsigned magic;
+        unsigned version;
+        LSN checkpointLsn;          // the last durable checkpoint record, 0 before the first one
+    } LogFileHeader;
+
+    static std::vector<unsigned> checksumTable() {
+        std::vector<unsigned> table(256);
+        for (unsigned i = 0; i < 256; i++) {
+            unsigned value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? 0xedb88320 ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }
+
+    unsigned logChecksum(const void *data, size_t length) {
+        static const std::vector<unsigned> table = checksumTable();
+        unsigned crc = 0xffffffff;
+        const auto *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < length; i++) {
+            crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffff;
+    }
+
+    // The checksum covers the record from the field after it to the end of the payload.
+    static unsigned recordChecksum(const char *record, unsigned length) {
+        size_t covered = offsetof(LogRecordHeader, lsn);
+        return logChecksum(record + covered, length - covered);
+    }
+
+    void encodeCheckpoint(LSN redoLsn, const std::unordered_map<std::string, unsigned> &logFileIds,
+                          std::vector<char> &payload) {
+        size_t length = sizeof(LSN) + sizeof(unsigned);
+        for (auto &entry : logFileIds) {
+            length += 2 * sizeof(unsigned) + entry.first.size();
+        }
+        payload.resize(length);
+        char *out = payload.data();
+        unsigned count = (unsigned) logFileIds.size();
+        memcpy(out, &redoLsn, sizeof(LSN));
+        memcpy(out + sizeof(LSN), &count, sizeof(unsigned));
+        out += sizeof(LSN) + sizeof(unsigned);
+        for (auto &entry : logFileIds) {
+            unsigned nameLength = (unsigned) entry.first.size();
+            memcpy(out, &entry.second, sizeof(unsigned));
+            memcpy(out + sizeof(unsigned), &nameLength, sizeof(unsigned));
+            memcpy(out + 2 * sizeof(unsigned), entry.first.data(), nameLength);
+            out += 2 * sizeof(unsigned) + nameLength;
+        }
+    }
+
+    RC decodeCheckpoint(const char *payload, unsigned length, LSN &redoLsn,
+                        std::unordered_map<unsigned, std::string> &fileNames) {
+        unsigned count;
+        if (length < sizeof(LSN) + sizeof(unsigned)) return -1;
+        memcpy(&redoLsn, payload, sizeof(LSN));
+        memcpy(&count, payload + sizeof(LSN), sizeof(unsigned));
+        unsigned in = sizeof(LSN) + sizeof(unsigned);
+        for (unsigned i = 0; i < count; i++) {
+            unsigned logFileId, nameLength;
+            if (in + 2 * sizeof(unsigned) > length) return -1;
+            memcpy(&logFileId, payload + in, sizeof(unsigned));
+            memcpy(&nameLength, payload + in + sizeof(unsigned), sizeof(unsigned));
+            in += 2 * sizeof(unsigned);
+            if (in + nameLength > length) return -1;
+            fileNames[logFileId] = std::string(payload + in, nameLength);
+            in += nameLength;
+        }
+        return 0;
+    }
+
+    LogReader::LogReader() : fd(-1), checkpointLsn(0), startLsn(0), position(0) {}
+
+    LogReader::~LogReader() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    RC LogReader::open(const std::string &logFileName) {
+        if (fd >= 0) return -1;
+        int logFd = ::open(logFileName.c_str(), O_RDONLY);
+        if (logFd < 0) return -1;
+        LogFileHeader header{};
+        if (pread(logFd, &header, sizeof(header), 0) != sizeof(header) || header.magic != LOG_MAGIC ||
+            header.version != LOG_VERSION) {
+            ::close(logFd);
+            return -1;
+        }
+        fd = logFd;
+        checkpointLsn = header.checkpointLsn;
+        return 0;
+    }
+
+    LSN LogReader::getCheckpointLsn() const {
+        return checkpointLsn;
+    }
+
+    // The log is read in one piece and cut at the first record that is torn, fails its checksum or was left
+    // behind by an earlier, longer log.
+    RC LogReader::load(LSN lsn) {
+        struct stat st{};
+        if (fd < 0 || lsn < WAL_HEADER_SIZE || fstat(fd, &st) != 0 || lsn > (LSN) st.st_size) return -1;
+        records.resize((size_t) ((LSN) st.st_size - lsn));
+        for (size_t done = 0; done < records.size();) {
+            ssize_t count = pread(fd, &records[done], records.size() - done, (off_t) (lsn + done));
+            if (count <= 0) return -1;
+            done += count;
+        }
+
+        size_t end = 0;
+        while (end + sizeof(LogRecordHeader) <= records.size()) {
+            LogRecordHeader header{};
+            memcpy(&header, &records[end], sizeof(header));
+            if (header.lsn != lsn + end || header.length < sizeof(header) || end + header.length > records.size() ||
+                recordChecksum(&records[end], header.length) != header.checksum) {
+                break;
+            }
+            end += header.length;
+        }
+        records.resize(end);
+        startLsn = lsn;
+        position = 0;
+        return 0;
+    }
+
+    LSN LogReader::getEndLsn() const {
+        return startLsn + records.size();
+    }
+
+    // Records are only byte-aligned in the log, so the header is copied out.
+    const char *LogReader::next(LogRecordHeader &header) {
+        if (position >= records.size()) return nullptr;
+        const char *record = &records[position];
+        memcpy(&header, record, sizeof(header));
+        position += header.length;
+        return record;
+    }
+
+    LogManager &LogManager::instance() {
+        static LogManager _log_manager;
+        return _log_manager;
+    }
+
+    LogManager::LogManager()
+            : fd(-1), syncCommit(true), bufferLsn(0), durableLsn(0), requestedLsn(0), failed(false), stopping(false),
+              nextLogFileId(0), checkpointInterval(WAL_CHECKPOINT_INTERVAL), checkpointLsn(0), redoLsn(0),
+              reclaimedLsn(0), checkpointCount(0), recordCount(0), commitCount(0), syncCount(0) {
+        // The buffer pool must outlive the log, which detaches from it when it is destroyed.
+        PagedFileManager::instance();
+    }
+
+    LogManager::~LogManager() {
+        close();
+    }
+
+    // The file names in use are those of the last checkpoint and of the WAL_FILE records after it, and the
+    // records after it end where a torn tail starts.
+    static RC readLogTail(const std::string &logFileName, LSN &checkpointLsn, LSN &redoLsn,
+                          std::unordered_map<std::string, unsigned> &logFileIds, unsigned &nextLogFileId, LSN &end) {
+        LogReader reader;
+        if (reader.open(logFileName) != 0) return -1;
+        checkpointLsn = reader.getCheckpointLsn();
+        redoLsn = 0;
+        if (reader.load(checkpointLsn != 0 ? checkpointLsn : WAL_HEADER_SIZE) != 0) return -1;
+
+        LogRecordHeader header{};
+        const char *record;
+        while ((record = reader.next(header)) != nullptr) {
+            const char *payload = record + sizeof(LogRecordHeader);
+            unsigned length = header.length - sizeof(LogRecordHeader);
+            if (header.type == WAL_CHECKPOINT) {
+                std::unordered_map<unsigned, std::string> fileNames;
+                LSN checkpointRedoLsn;
+                if (decodeCheckpoint(payload, length, checkpointRedoLsn, fileNames) != 0) return -1;
+                if (header.lsn == checkpointLsn) redoLsn = checkpointRedoLsn;
+                for (auto &entry : fileNames) {
+                    logFileIds[entry.second] = entry.first;
+                    if (entry.first >= nextLogFileId) nextLogFileId = entry.first + 1;
+                }
+            } else if (header.type == WAL_FILE) {
+                logFileIds[std::string(payload, length)] = header.logFileId;
+                if (header.logFileId >= nextLogFileId) nextLogFileId = header.logFileId + 1;
+            }
+        }
+        // The header only points to a checkpoint once it is durable, so it must have been read.
+        if (checkpointLsn != 0 && redoLsn == 0) return -1;
+        end = reader.getEndLsn();
+        return 0;
+    }
+
+    RC LogManager::open(const std::string &logFileName, bool syncCommit) {
+        std::unique_lock<std::mutex> lock(latch);
+        if (fd >= 0) return -1;
+
+        int logFd = ::open(logFileName.c_str(), O_RDWR | O_CREAT, 0644);
+        if (logFd < 0) return -1;
+        LogFileHeader header{};
+        if (pread(logFd, &header, sizeof(header), 0) == 0) {
+            std::vector<char> block(WAL_HEADER_SIZE, 0);
+            header = LogFileHeader{LOG_MAGIC, LOG_VERSION, 0};
+            memcpy(block.data(), &header, sizeof(header));
+            if (pwrite(logFd, block.data(), WAL_HEADER_SIZE, 0) != WAL_HEADER_SIZE || fdatasync(logFd) != 0) {
+                ::close(logFd);
+                return -1;
+            }
+        }
+
+        // A torn tail is cut off, so new records follow the last complete one.
+        std::unordered_map<std::string, unsigned> fileIds;
+        unsigned nextFileId = 0;
+        LSN lastCheckpointLsn, lastRedoLsn, end;
+        if (readLogTail(logFileName, lastCheckpointLsn, lastRedoLsn, fileIds, nextFileId, end) != 0 ||
+            ftruncate(logFd, (off_t) end) != 0 || fdatasync(logFd) != 0) {
+            ::close(logFd);
+            return -1;
+        }
+
+        fd = logFd;
+        this->syncCommit = syncCommit;
+        bufferLsn = durableLsn = requestedLsn = end;
+        failed = false;
+        stopping = false;
+        logFileIds.swap(fileIds);
+        nextLogFileId = nextFileId;
+        checkpointLsn = lastCheckpointLsn;
+        redoLsn = lastRedoLsn;
+        reclaimedLsn = 0;
+        writer = std::thread(&LogManager::runWriter, this);
+        lock.unlock();
+
+        PagedFileManager::instance().bufferPool().setLogManager(this);
+        return 0;
+    }
+
+    RC LogManager::close() {
+        std::lock_guard<std::mutex> checkpointGuard(checkpointLatch);
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (fd < 0) return 0;
+            stopping = true;
+        }
+        flushWanted.notify_all();
+        if (writer.joinable()) writer.join();
+        PagedFileManager::instance().bufferPool().setLogManager(nullptr);
+
+        std::lock_guard<std::mutex> guard(latch);
+        RC rc = failed ? -1 : 0;
+        ::close(fd);
+        fd = -1;
+        flushDone.notify_all();
+        return rc;
+    }
+
+    bool LogManager::isOpen() {
+        std::lock_guard<std::mutex> guard(latch);
+        return fd >= 0;
+    }
+
+    RC LogManager::append(LogRecordType type, const std::string &fileName, PageNum pageNum, unsigned short slotNum,
+                          const void *payload, unsigned length, LSN &lsn) {
+        std::lock_guard<std::mutex> guard(latch);
+        if (fd < 0 || failed || stopping) return -1;
+
+        // A file is named once in the log; records refer to it by number, and checkpoints repeat the names.
+        auto it = logFileIds.find(fileName);
+        if (it == logFileIds.end()) {
+            unsigned logFileId = nextLogFileId++;
+            LSN fileLsn;
+            if (appendLocked(WAL_FILE, logFileId, 0, 0, fileName.data(), (unsigned) fileName.size(), fileLsn) != 0) {
+                return -1;
+            }
+            it = logFileIds.emplace(fileName, logFileId).first;
+        }
+        if (appendLocked(type, it->second, pageNum, slotNum, payload, length, lsn) != 0) return -1;
+        if (buffer.size() >= WAL_BUFFER_SIZE) flushWanted.notify_one();
+        return 0;
+    }
+
+    // The new logFileId is named in the log before the call returns, so whatever a file created under the
+    // same name writes to disk afterwards, restart never redoes the changes of the destroyed one into it.
+    RC LogManager::forgetFile(const std::string &fileName) {
+        LSN lsn;
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (fd < 0) return 0;
+            if (failed || stopping) return -1;
+            auto it = logFileIds.find(fileName);
+            if (it == logFileIds.end()) return 0;
+            it->second = nextLogFileId++;
+            if (appendLocked(WAL_FILE, it->second, 0, 0, fileName.data(), (unsigned) fileName.size(), lsn) != 0) {
+                return -1;
+            }
+        }
+        return flush(lsn);
+    }
+
+    RC LogManager::appendLocked(LogRecordType type, unsigned logFileId, PageNum pageNum, unsigned short slotNum,
+                                const void *payload, unsigned length, LSN &lsn) {
+        unsigned recordLength = sizeof(LogRecordHeader) + length;
+        lsn = bufferLsn + buffer.size();
+        LogRecordHeader header{recordLength, 0, lsn, (unsigned short) type, slotNum, logFileId, pageNum, 0};
+
+        size_t start = buffer.size();
+        buffer.resize(start + recordLength);
+        char *record = &buffer[start];
+        memcpy(record, &header, sizeof(header));
+        if (length > 0) memcpy(record + sizeof(header), payload, length);
+        header.checksum = recordChecksum(record, recordLength);
+        memcpy(record + offsetof(LogRecordHeader, checksum), &header.checksum, sizeof(header.checksum));
+        recordCount++;
+        return 0;
+    }
+
+    RC LogManager::commit(LSN lsn) {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            commitCount++;
+        }
+        return flush(lsn);
+    }
+
+    RC LogManager::flush(LSN lsn) {
+        std::unique_lock<std::mutex> lock(latch);
+        if (lsn < durableLsn) return 0;
+        if (fd < 0 || failed || lsn >= bufferLsn + buffer.size()) return -1;
+
+        if (requestedLsn <= lsn) requestedLsn = lsn + 1;
+        flushWanted.notify_one();
+        while (durableLsn <= lsn && !failed && fd >= 0) {
+            flushDone.wait(lock);
+        }
+        return durableLsn > lsn ? 0 : -1;
+    }
+
+    RC LogManager::commitIfSync(LSN lsn) {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (!syncCommit) return 0;
+        }
+        return commit(lsn);
+    }
+
+    LSN LogManager::getDurableLsn() {
+        std::lock_guard<std::mutex> guard(latch);
+        return durableLsn;
+    }
+
+    LSN LogManager::getEndLsn() {
+        std::lock_guard<std::mutex> guard(latch);
+        return fd < 0 ? 0 : bufferLsn + buffer.size();
+    }
+
+    RC LogManager::sync() {
+        LSN end;
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (fd < 0) return -1;
+            end = bufferLsn + buffer.size();
+        }
+        return flush(end - 1);
+    }
+
+    // The header is rewritten only after the checkpoint record is durable, so it always points to a
+    // complete checkpoint; a crash in between leaves it at the previous one.
+    RC LogManager::checkpoint(LSN redoLsn) {
+        std::lock_guard<std::mutex> checkpointGuard(checkpointLatch);
+        LSN lsn;
+        int logFd;
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (fd < 0 || failed || stopping) return -1;
+            std::vector<char> payload;
+            encodeCheckpoint(redoLsn, logFileIds, payload);
+            if (appendLocked(WAL_CHECKPOINT, 0, 0, 0, payload.data(), (unsigned) payload.size(), lsn) != 0) return -1;
+            logFd = fd;
+        }
+        if (flush(lsn) != 0) return -1;
+
+        LogFileHeader header{LOG_MAGIC, LOG_VERSION, lsn};
+        if (pwrite(logFd, &header, sizeof(header), 0) != sizeof(header) || fdatasync(logFd) != 0) return -1;
+
+        // The block holding the header stays. A file system that cannot punch holes keeps the whole log.
+        LSN start = std::max(reclaimedLsn, (LSN) WAL_RECLAIM_ALIGN);
+        LSN end = redoLsn / WAL_RECLAIM_ALIGN * WAL_RECLAIM_ALIGN;
+        if (end > start && fallocate(logFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) start,
+                                     (off_t) (end - start)) == 0) {
+            reclaimedLsn = end;
+        }
+
+        std::lock_guard<std::mutex> guard(latch);
+        checkpointLsn = lsn;
+        this->redoLsn = redoLsn;
+        checkpointCount++;
+        return 0;
+    }
+
+    RC LogManager::checkpointIfDue(LSN redoLsn) {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            if (fd < 0 || checkpointInterval == 0) return 0;
+            LSN last = checkpointLsn != 0 ? checkpointLsn : WAL_HEADER_SIZE;
+            if (bufferLsn + buffer.size() - last < checkpointInterval) return 0;
+        }
+        return checkpoint(redoLsn);
+    }
+
+    void LogManager::setCheckpointInterval(unsigned long long bytes) {
+        std::lock_guard<std::mutex> guard(latch);
+        checkpointInterval = bytes;
+    }
+
+    RC LogManager::collectCounterValues(unsigned &recordCount, unsigned &commitCount, unsigned &syncCount) {
+        std::lock_guard<std::mutex> guard(latch);
+        recordCount = this->recordCount;
+        commitCount = this->commitCount;
+        syncCount = this->syncCount;
+        return 0;
+    }
+
+    RC LogManager::collectCheckpointCounterValues(unsigned &checkpointCount, LSN &checkpointLsn, LSN &redoLsn) {
+        std::lock_guard<std::mutex> guard(latch);
+        checkpointCount = this->checkpointCount;
+        checkpointLsn = this->checkpointLsn;
+        redoLsn = this->redoLsn;
+        return 0;
+    }
+
+    // Writes out whatever was appended while the previous batch was being written and synced, so commits
+    // arriving during one fsync all share the next.
+    void LogManager::runWriter() {
+        std::unique_lock<std::mutex> lock(latch);
+        while (true) {
+            bool idle = failed || (requestedLsn <= durableLsn && buffer.size() < WAL_BUFFER_SIZE);
+            if (!stopping && idle) {
+                flushWanted.wait_for(lock, std::chrono::milliseconds(WAL_FLUSH_INTERVAL_MS));
+            }
+            if (buffer.empty() || failed) {
+                if (stopping) break;
+                continue;
+            }
+
+            writing.swap(buffer);
+            LSN start = bufferLsn;
+            bufferLsn += writing.size();
+            lock.unlock();
+            bool written = true;
+            for (size_t done = 0; written && done < writing.size();) {
+                ssize_t count = pwrite(fd, writing.data() + done, writing.size() - done, (off_t) (start + done));
+                if (count <= 0) written = false;
+                else done += count;
+            }
+            if (written && fdatasync(fd) != 0) written = false;
+            lock.lock();
+
+            syncCount++;
+            if (written) durableLsn = start + writing.size();
+            else failed = true;
+            writing.clear();
+            flushDone.notify_all();
+        }
+    }
+
+} // namespace PeterDB
@@ -0,0 +1,178 @@
+#include "src/include/fsm.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace PeterDB {
+
+    // Page 0 of a map file; the bucket bytes follow in pages 1 on, one page of entries per map page.
+    // clean is cleared while the map is open, so a map left behind by a crash is rebuilt.
+    typedef struct MapHeader {
+        unsigned magic;
+        unsigned pageSize;                  // of the data file, which sets the bucket width
+        unsigned numPages;
+        unsigned clean;
+    } MapHeader;
+
+    static const unsigned FSM_MAGIC = 0x4D534650; // "PFSM"
+
+    FreeSpaceMap::FreeSpaceMap() : loaded(false), pageSize(0), numPages(0), leaves(0) {}
+
+    FreeSpaceMap::~FreeSpaceMap() {
+        close();
+    }
+
+    std::string FreeSpaceMap::fileNameOf(const std::string &fileName) {
+        return fileName + FSM_FILE_SUFFIX;
+    }
+
+    RC FreeSpaceMap::open(const std::string &fileName, unsigned pageSize, unsigned numPages, bool &rebuild) {
+        if (loaded) return -1;
+        PagedFileManager &pfm = PagedFileManager::instance();
+        std::string mapName = fileNameOf(fileName);
+        this->pageSize = pageSize;
+        this->numPages = 0;
+        leaves = 0;
+        tree.clear();
+
+        rebuild = true;
+        if (pfm.openFile(mapName, mapHandle) == 0) {
+            unsigned entriesPerPage = mapHandle.getPageSize();
+            MapHeader header{};
+            PageGuard guard;
+            if (mapHandle.getNumberOfPages() > 0 && mapHandle.pinPage(0, guard) == 0) {
+                memcpy(&header, guard.data(), sizeof(MapHeader));
+            }
+            guard.release();
+            rebuild = header.magic != FSM_MAGIC || header.pageSize != pageSize || header.numPages != numPages ||
+                      header.clean == 0 ||
+                      mapHandle.getNumberOfPages() < 1 + (numPages + entriesPerPage - 1) / entriesPerPage;
+
+            if (!rebuild) {
+                grow(numPages);
+                for (PageNum first = 0; first < numPages; first += entriesPerPage) {
+                    if (mapHandle.pinPage(1 + first / entriesPerPage, guard) != 0) {
+                        pfm.closeFile(mapHandle);
+                        return -1;
+                    }
+                    unsigned count = std::min(entriesPerPage, numPages - first);
+                    memcpy(&tree[leaves + first], guard.data(), count);
+                }
+                for (unsigned i = leaves - 1; i >= 1; i--) {
+                    tree[i] = std::max(tree[2 * i], tree[2 * i + 1]);
+                }
+                this->numPages = numPages;
+            } else if (pfm.closeFile(mapHandle) != 0) {
+                return -1;
+            }
+        }
+
+        if (rebuild) {
+            pfm.destroyFile(mapName);
+            if (pfm.createFile(mapName) != 0 || pfm.openFile(mapName, mapHandle) != 0) return -1;
+            std::vector<char> page(mapHandle.getPageSize(), 0);
+            if (mapHandle.appendPage(page.data()) != 0) return -1;
+        }
+        mapHandle.setAccessPattern(PFM_ACCESS_RANDOM);
+        loaded = true;
+        return writeHeader(false);
+    }
+
+    RC FreeSpaceMap::close() {
+        if (!loaded) return 0;
+        RC rc = writeHeader(true);
+        if (PagedFileManager::instance().closeFile(mapHandle) != 0) rc = -1;
+        loaded = false;
+        numPages = 0;
+        leaves = 0;
+        tree.clear();
+        return rc;
+    }
+
+    bool FreeSpaceMap::isOpen() const {
+        return loaded;
+    }
+
+    RC FreeSpaceMap::findPage(unsigned length, PageNum &pageNum) {
+        unsigned width = pageSize / FSM_CATEGORIES;
+        unsigned wanted = (length + width - 1) / width;
+        if (numPages == 0 || wanted >= FSM_CATEGORIES || tree[1] < wanted) return -1;
+
+        // Appends leave room at the end, so the last page is tried first, as a scan would.
+        if (tree[leaves + numPages - 1] >= wanted) {
+            pageNum = numPages - 1;
+            return 0;
+        }
+        unsigned i = 1;
+        while (i < leaves) {
+            i = tree[2 * i] >= wanted ? 2 * i : 2 * i + 1;
+        }
+        pageNum = i - leaves;
+        return 0;
+    }
+
+    RC FreeSpaceMap::setFreeSpace(PageNum pageNum, unsigned freeBytes) {
+        if (pageNum >= leaves) grow(pageNum + 1);
+        bool extended = pageNum >= numPages;
+        if (extended) numPages = pageNum + 1;
+
+        auto entry = (unsigned char) category(freeBytes);
+        unsigned i = leaves + pageNum;
+        if (tree[i] == entry && !extended) return 0;
+        tree[i] = entry;
+        for (i /= 2; i >= 1; i /= 2) {
+            unsigned char largest = std::max(tree[2 * i], tree[2 * i + 1]);
+            if (tree[i] == largest) break;
+            tree[i] = largest;
+        }
+        return writeEntry(pageNum, entry);
+    }
+
+    unsigned FreeSpaceMap::getNumberOfPages() const {
+        return numPages;
+    }
+
+    unsigned FreeSpaceMap::category(unsigned freeBytes) const {
+        unsigned bucket = freeBytes / (pageSize / FSM_CATEGORIES);
+        return bucket < FSM_CATEGORIES ? bucket : FSM_CATEGORIES - 1;
+    }
+
+    // Double the leaves until minLeaves fit and rebuild the inner nodes above them.
+    void FreeSpaceMap::grow(unsigned minLeaves) {
+        unsigned newLeaves = leaves == 0 ? 1 : leaves;
+        while (newLeaves < minLeaves) newLeaves *= 2;
+        std::vector<unsigned char> newTree(2 * newLeaves, 0);
+        if (leaves > 0) {
+            std::copy(tree.begin() + leaves, tree.begin() + leaves + numPages, newTree.begin() + newLeaves);
+        }
+        for (unsigned i = newLeaves - 1; i >= 1; i--) {
+            newTree[i] = std::max(newTree[2 * i], newTree[2 * i + 1]);
+        }
+        tree.swap(newTree);
+        leaves = newLeaves;
+    }
+
+    RC FreeSpaceMap::writeHeader(bool clean) {
+        WritePageGuard guard;
+        if (mapHandle.pinPageForWrite(0, guard) != 0) return -1;
+        MapHeader header{FSM_MAGIC, pageSize, numPages, clean ? 1u : 0u};
+        memcpy(guard.data(), &header, sizeof(MapHeader));
+        return 0;
+    }
+
+    RC FreeSpaceMap::writeEntry(PageNum pageNum, unsigned char entry) {
+        unsigned entriesPerPage = mapHandle.getPageSize();
+        PageNum mapPageNum = 1 + pageNum / entriesPerPage;
+        if (mapHandle.getNumberOfPages() <= mapPageNum) {
+            std::vector<char> page(entriesPerPage, 0);
+            while (mapHandle.getNumberOfPages() <= mapPageNum) {
+                if (mapHandle.appendPage(page.data()) != 0) return -1;
+            }
+        }
+        WritePageGuard guard;
+        if (mapHandle.pinPageForWrite(mapPageNum, guard) != 0) return -1;
+        guard.data()[pageNum % entriesPerPage] = (char) entry;
+        return 0;
+    }
+
+} // namespace PeterDB
@@ -1,71 +1,1433 @@
 #include "src/include/rbfm.h"
+#include "src/include/wal.h"
+#include "src/include/fsm.h"
+#include "src/include/zonemap.h"
+#include "src/include/arena.h"
+
+#include <mutex>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
 
 namespace PeterDB {
+
+    // Slotted page layout:
+    //   [record 0][record 1]...free space...[slot n-1]...[slot 0][pageLsn][freeSpaceOffset][slotCount]
+    // Records grow from the start of the page, the slot directory grows backwards from the footer.
+    // A slot is [offset][length]; a length of 0 marks a free slot that the next insert may reuse.
+    // pageLsn is the LSN of the last logged change to the page, 0 if the page was never changed under a log.
+    typedef unsigned short PageOffset;
+
+    static const unsigned FOOTER_SIZE = 2 * sizeof(PageOffset) + sizeof(LSN);
+    static const unsigned SLOT_SIZE = 2 * sizeof(PageOffset);
+
+    // Stored record layout:
+    //   [header][null-indicators][fieldEnd for each field][field values]
+    // The header keeps the field count in its low bits. fieldEnd[i] is the offset, from the start of the
+    // record, just past field i, so any field is located in O(1). VarChars are stored without their length.
+    // A record moved away by an update leaves a tombstone [header][pageNum][slotNum] in its original slot.
+    static const PageOffset RECORD_TOMBSTONE = 0x8000;          // the slot forwards to another RID
+    static const PageOffset RECORD_MOVED = 0x4000;              // reachable only through a tombstone
+    static const PageOffset RECORD_FIELD_MASK = 0x3FFF;
+    static const unsigned TOMBSTONE_SIZE = sizeof(PageOffset) + sizeof(unsigned) + sizeof(PageOffset);
+    static const unsigned MIN_RECORD_SIZE = TOMBSTONE_SIZE;     // every record can become a tombstone in place
+
+    static unsigned nullBytes(unsigned fieldCount) {
+        return (fieldCount + 7) / 8;
+    }
+
+    static bool isNull(const char *nullIndicators, unsigned i) {
+        return nullIndicators[i / 8] & (0x80 >> (i % 8));
+    }
+
+    // The offsets inside a stored record follow its null indicators, so they are copied, never dereferenced.
+    static PageOffset readOffset(const char *at) {
+        PageOffset offset;
+        memcpy(&offset, at, sizeof(PageOffset));
+        return offset;
+    }
+
+    static void writeOffset(char *at, PageOffset offset) {
+        memcpy(at, &offset, sizeof(PageOffset));
+    }
+
+    // The page size is a property of the file (FileHandle::getPageSize), so every page helper takes it.
+    // Offsets are 16 bits wide, which covers the largest page size of 64 KB.
+    static PageOffset *footer(char *page, unsigned pageSize) {
+        return (PageOffset *) (page + pageSize - 2 * sizeof(PageOffset));
+    }
+
+    static const PageOffset *footer(const char *page, unsigned pageSize) {
+        return (const PageOffset *) (page + pageSize - 2 * sizeof(PageOffset));
+    }
+
+    static LSN pageLsn(const char *page, unsigned pageSize) {
+        LSN lsn;
+        memcpy(&lsn, page + pageSize - FOOTER_SIZE, sizeof(LSN));
+        return lsn;
+    }
+
+    static void setPageLsn(char *page, unsigned pageSize, LSN lsn) {
+        memcpy(page + pageSize - FOOTER_SIZE, &lsn, sizeof(LSN));
+    }
+
+    static PageOffset *slot(char *page, unsigned pageSize, unsigned slotNum) {
+        return (PageOffset *) (page + pageSize - FOOTER_SIZE - (slotNum + 1) * SLOT_SIZE);
+    }
+
+    static const PageOffset *slot(const char *page, unsigned pageSize, unsigned slotNum) {
+        return (const PageOffset *) (page + pageSize - FOOTER_SIZE - (slotNum + 1) * SLOT_SIZE);
+    }
+
+    static unsigned freeSpace(const char *page, unsigned pageSize) {
+        return pageSize - FOOTER_SIZE - footer(page, pageSize)[1] * SLOT_SIZE - footer(page, pageSize)[0];
+    }
+
+    static void initPage(char *page, unsigned pageSize) {
+        memset(page, 0, pageSize);
+    }
+
+    // The largest record a page can hold, together with its slot.
+    static unsigned maxRecordSize(unsigned pageSize) {
+        return pageSize - SLOT_SIZE - FOOTER_SIZE;
+    }
+
+    // The first free slot, or slotCount when a new slot has to be added.
+    static unsigned findFreeSlot(const char *page, unsigned pageSize) {
+        unsigned slotCount = footer(page, pageSize)[1];
+        for (unsigned i = 0; i < slotCount; i++) {
+            if (slot(page, pageSize, i)[1] == 0) return i;
+        }
+        return slotCount;
+    }
+
+    // The largest record the page can take now, counting the slot it would add; what the free-space map keeps.
+    static unsigned usableSpace(const char *page, unsigned pageSize) {
+        unsigned space = freeSpace(page, pageSize);
+        if (findFreeSlot(page, pageSize) < footer(page, pageSize)[1]) return space;
+        return space > SLOT_SIZE ? space - SLOT_SIZE : 0;
+    }
+
+    // Fill the given slot; a slot past the directory extends it, and any slots added in between stay free.
+    static void placeRecordAt(char *page, unsigned pageSize, unsigned slotNum, const char *record, unsigned length) {
+        PageOffset *f = footer(page, pageSize);
+        for (; f[1] <= slotNum; f[1]++) {
+            slot(page, pageSize, f[1])[0] = 0;
+            slot(page, pageSize, f[1])[1] = 0;
+        }
+        memcpy(page + f[0], record, length);
+        slot(page, pageSize, slotNum)[0] = f[0];
+        slot(page, pageSize, slotNum)[1] = length;
+        f[0] += length;
+    }
+
+    static unsigned placeRecord(char *page, unsigned pageSize, const char *record, unsigned length) {
+        unsigned slotNum = findFreeSlot(page, pageSize);
+        placeRecordAt(page, pageSize, slotNum, record, length);
+        return slotNum;
+    }
+
+    // Grow or shrink the record in the given slot, shifting the records behind it to keep the page compact.
+    static void resizeRecord(char *page, unsigned pageSize, unsigned slotNum, unsigned newLength) {
+        PageOffset *f = footer(page, pageSize);
+        PageOffset *s = slot(page, pageSize, slotNum);
+        unsigned end = s[0] + s[1];
+        int delta = (int) newLength - (int) s[1];
+        if (delta == 0) return;
+
+        memmove(page + end + delta, page + end, f[0] - end);
+        for (unsigned i = 0; i < f[1]; i++) {
+            PageOffset *other = slot(page, pageSize, i);
+            if (other[1] != 0 && other[0] >= end) other[0] += delta;
+        }
+        f[0] += delta;
+        s[1] = newLength;
+    }
+
+    static void removeRecord(char *page, unsigned pageSize, unsigned slotNum) {
+        resizeRecord(page, pageSize, slotNum, 0);
+        slot(page, pageSize, slotNum)[0] = 0;
+    }
+
+    static unsigned encodedSize(const std::vector<Attribute> &recordDescriptor, const void *data) {
+        unsigned fieldCount = recordDescriptor.size();
+        const char *nulls = (const char *) data;
+        const char *value = nulls + nullBytes(fieldCount);
+        unsigned size = sizeof(PageOffset) + nullBytes(fieldCount) + fieldCount * sizeof(PageOffset);
+        for (unsigned i = 0; i < fieldCount; i++) {
+            if (isNull(nulls, i)) continue;
+            if (recordDescriptor[i].type == TypeVarChar) {
+                unsigned length;
+                memcpy(&length, value, sizeof(unsigned));
+                value += sizeof(unsigned) + length;
+                size += length;
+            } else {
+                value += sizeof(int);
+                size += sizeof(int);
+            }
+        }
+        return size < MIN_RECORD_SIZE ? MIN_RECORD_SIZE : size;
+    }
+
+    static void encodeRecord(const std::vector<Attribute> &recordDescriptor, const void *data, PageOffset flags,
+                             char *record) {
+        unsigned fieldCount = recordDescriptor.size();
+        const char *nulls = (const char *) data;
+        const char *value = nulls + nullBytes(fieldCount);
+
+        PageOffset header = (PageOffset) fieldCount | flags;
+        memcpy(record, &header, sizeof(PageOffset));
+        memcpy(record + sizeof(PageOffset), nulls, nullBytes(fieldCount));
+        char *fieldEnd = record + sizeof(PageOffset) + nullBytes(fieldCount);
+        PageOffset offset = sizeof(PageOffset) + nullBytes(fieldCount) + fieldCount * sizeof(PageOffset);
+
+        for (unsigned i = 0; i < fieldCount; i++) {
+            if (!isNull(nulls, i)) {
+                unsigned length = sizeof(int);
+                if (recordDescriptor[i].type == TypeVarChar) {
+                    memcpy(&length, value, sizeof(unsigned));
+                    value += sizeof(unsigned);
+                }
+                memcpy(record + offset, value, length);
+                value += length;
+                offset += length;
+            }
+            writeOffset(fieldEnd + i * sizeof(PageOffset), offset);
+        }
+    }
+
+    static PageOffset recordHeader(const char *record) {
+        PageOffset header;
+        memcpy(&header, record, sizeof(PageOffset));
+        return header;
+    }
+
+    // Locate field i of a stored record; returns false when the field is NULL or absent.
+    static bool locateField(const char *record, unsigned i, const char *&field, unsigned &length) {
+        unsigned fieldCount = recordHeader(record) & RECORD_FIELD_MASK;
+        if (i >= fieldCount || isNull(record + sizeof(PageOffset), i)) return false;
+        const char *fieldEnd = record + sizeof(PageOffset) + nullBytes(fieldCount);
+        unsigned start = i == 0 ? sizeof(PageOffset) + nullBytes(fieldCount) + fieldCount * sizeof(PageOffset)
+                                : readOffset(fieldEnd + (i - 1) * sizeof(PageOffset));
+        field = record + start;
+        length = readOffset(fieldEnd + i * sizeof(PageOffset)) - start;
+        return true;
+    }
+
+    // Widen the zone of a page with the Int and Real fields of a stored record, each the last four bytes before
+    // its field end; added counts the record as one more of the page, which an update does not.
+    static void widenZone(ZoneMap &map, PageNum pageNum, const char *record, bool added) {
+        const std::vector<unsigned> &fields = map.getFields();
+        unsigned fieldCount = recordHeader(record) & RECORD_FIELD_MASK;
+        const char *nulls = record + sizeof(PageOffset);
+        const char *fieldEnd = nulls + nullBytes(fieldCount);
+        const char *values[ZONE_MAX_FIELDS];
+        for (unsigned zone = 0; zone < fields.size(); zone++) {
+            unsigned i = fields[zone];
+            values[zone] = i < fieldCount && !isNull(nulls, i)
+                           ? record + readOffset(fieldEnd + i * sizeof(PageOffset)) - sizeof(int) : nullptr;
+        }
+        map.widen(pageNum, values, added);
+    }
+
+    // An updated record is in the zone of its RID's page even when it moved, as that is where a scan returns
+    // it. The old values stay in the bounds, so the zone is loose until a scan rebuilds it.
+    static RC updateZone(ZoneMap *zones, PageNum pageNum, const char *record) {
+        if (zones == nullptr) return 0;
+        widenZone(*zones, pageNum, record, false);
+        zones->loosen(pageNum);
+        return zones->save(pageNum);
+    }
+
+    // Append one field in the API format (4-byte length prefix for VarChar) and return the bytes written.
+    static unsigned copyField(const Attribute &attribute, const char *field, unsigned length, char *out) {
+        if (attribute.type != TypeVarChar) {
+            memcpy(out, field, sizeof(int));
+            return sizeof(int);
+        }
+        memcpy(out, &length, sizeof(unsigned));
+        memcpy(out + sizeof(unsigned), field, length);
+        return sizeof(unsigned) + length;
+    }
+
+    // Decode a stored record into the API format and return the bytes written.
+    static unsigned decodeRecord(const std::vector<Attribute> &recordDescriptor, const char *record, void *data) {
+        unsigned fieldCount = recordDescriptor.size();
+        char *nulls = (char *) data;
+        char *out = nulls + nullBytes(fieldCount);
+        memset(nulls, 0, nullBytes(fieldCount));
+
+        for (unsigned i = 0; i < fieldCount; i++) {
+            const char *field;
+            unsigned length;
+            if (!locateField(record, i, field, length)) {
+                nulls[i / 8] |= (char) (0x80 >> (i % 8));
+                continue;
+            }
+            out += copyField(recordDescriptor[i], field, length, out);
+        }
+        return out - nulls;
+    }
+
+    // Pin the page holding rid and follow a tombstone if there is one. On success the guard pins the page
+    // that actually stores the record, and record points into it.
+    static RC locateRecord(FileHandle &fileHandle, const RID &rid, PageGuard &guard, const char *&record) {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (fileHandle.pinPage(rid.pageNum, guard) != 0) return -1;
+        const char *page = guard.data();
+        if (rid.slotNum >= footer(page, pageSize)[1] || slot(page, pageSize, rid.slotNum)[1] == 0) return -1;
+        record = page + slot(page, pageSize, rid.slotNum)[0];
+        if (!(recordHeader(record) & RECORD_TOMBSTONE)) return 0;
+
+        RID target;
+        memcpy(&target.pageNum, record + sizeof(PageOffset), sizeof(unsigned));
+        memcpy(&target.slotNum, record + sizeof(PageOffset) + sizeof(unsigned), sizeof(PageOffset));
+        if (fileHandle.pinPage(target.pageNum, guard) != 0) return -1;
+        page = guard.data();
+        if (target.slotNum >= footer(page, pageSize)[1] || slot(page, pageSize, target.slotNum)[1] == 0) return -1;
+        record = page + slot(page, pageSize, target.slotNum)[0];
+        return 0;
+    }
+
+    // Check that rid names a record before its page is pinned for write, which counts a write and marks the
+    // page dirty whether or not anything changes.
+    static RC checkRecord(FileHandle &fileHandle, const RID &rid) {
+        PageGuard guard;
+        const char *record;
+        return locateRecord(fileHandle, rid, guard, record);
+    }
+
+    // Log a change just made to a page pinned for write and stamp the page with the record's LSN, which also
+    // becomes the operation's latest LSN. Nothing is logged while the log is closed.
+    static RC logChange(FileHandle &fileHandle, WritePageGuard &guard, LogRecordType type, unsigned slotNum,
+                        const char *payload, unsigned length, LSN &lsn) {
+        LogManager &log = LogManager::instance();
+        if (!log.isOpen()) return 0;
+        if (log.append(type, fileHandle.getFileName(), guard.getPageNum(), (unsigned short) slotNum, payload, length,
+                       lsn) != 0) {
+            return -1;
+        }
+        setPageLsn(guard.data(), fileHandle.getPageSize(), lsn);
+        guard.setLsn(lsn);
+        return 0;
+    }
+
+    // Every change of an operation is logged before it returns; with synchronous commits it also waits
+    // until its last record is durable.
+    static RC commitChanges(LSN lsn) {
+        return lsn == 0 ? 0 : LogManager::instance().commitIfSync(lsn);
+    }
+
+    // Store an encoded record: ask the free-space map for a page with room, the last page first, and only
+    // append a new page when no page has room. lsn is set to the LSN of the last change logged.
+    static RC insertEncoded(FileHandle &fileHandle, FreeSpaceMap &map, const char *record, unsigned length,
+                            RID &rid, LSN &lsn) {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (length > maxRecordSize(pageSize)) return -1;
+
+        PageNum pageNum;
+        while (map.findPage(length, pageNum) == 0) {
+            // The map is a hint; a page that turns out fuller than it says is corrected and passed over.
+            PageGuard probe;
+            if (fileHandle.pinPage(pageNum, probe) != 0) return -1;
+            unsigned space = usableSpace(probe.data(), pageSize);
+            if (space < length) {
+                if (map.setFreeSpace(pageNum, space) != 0) return -1;
+                continue;
+            }
+            probe.release();
+
+            WritePageGuard guard;
+            if (fileHandle.pinPageForWrite(pageNum, guard) != 0) return -1;
+            rid.pageNum = pageNum;
+            rid.slotNum = placeRecord(guard.data(), pageSize, record, length);
+            if (logChange(fileHandle, guard, WAL_RECORD_INSERT, rid.slotNum, record, length, lsn) != 0) return -1;
+            return map.setFreeSpace(pageNum, usableSpace(guard.data(), pageSize));
+        }
+
+        ArenaBuffer buffer(pageSize);
+        char *page = buffer.data();
+        initPage(page, pageSize);
+        unsigned numPages = fileHandle.getNumberOfPages();
+        rid.pageNum = numPages;
+        if (!LogManager::instance().isOpen()) {
+            rid.slotNum = placeRecord(page, pageSize, record, length);
+            if (fileHandle.appendPage(page) != 0) return -1;
+            return map.setFreeSpace(numPages, usableSpace(page, pageSize));
+        }
+
+        // Appends are written through, so a logged page is appended empty and filled in the pool, where the
+        // write-ahead rule holds it back until its records are durable.
+        WritePageGuard guard;
+        if (fileHandle.appendPage(page) != 0 || fileHandle.pinPageForWrite(numPages, guard) != 0) return -1;
+        if (logChange(fileHandle, guard, WAL_PAGE_FORMAT, 0, nullptr, 0, lsn) != 0) return -1;
+        rid.slotNum = placeRecord(guard.data(), pageSize, record, length);
+        if (logChange(fileHandle, guard, WAL_RECORD_INSERT, rid.slotNum, record, length, lsn) != 0) return -1;
+        return map.setFreeSpace(numPages, usableSpace(guard.data(), pageSize));
+    }
+
+    // The pages insertRecords fills in memory: pages[0] is page firstPageNum, and with refill set it is the
+    // last page of the file, which is written in place rather than appended.
+    typedef struct PageBatch {
+        char *pages;
+        PageNum firstPageNum;
+        unsigned count;
+        bool refill;
+        unsigned space[RBFM_BATCH_PAGES];   // usableSpace of each page
+    } PageBatch;
+
+    // Write every page of a batch once and record its free space and zone. Under a log each page is logged as
+    // one image; new pages are appended empty and filled in the pool, as a single insert does.
+    static RC writeBatch(FileHandle &fileHandle, FreeSpaceMap &map, ZoneMap *zones, const PageBatch &batch,
+                         LSN &lsn) {
+        unsigned pageSize = fileHandle.getPageSize();
+        unsigned appended = batch.refill ? batch.count - 1 : batch.count;
+        const char *newPages = batch.pages + (batch.count - appended) * pageSize;
+        if (!LogManager::instance().isOpen()) {
+            if (batch.refill && fileHandle.writePage(batch.firstPageNum, batch.pages) != 0) return -1;
+            if (appended > 0 && fileHandle.appendPages(appended, newPages) != 0) return -1;
+        } else {
+            if (appended > 0) {
+                std::vector<char> empty(appended * pageSize, 0);
+                if (fileHandle.appendPages(appended, empty.data()) != 0) return -1;
+            }
+            for (unsigned i = 0; i < batch.count; i++) {
+                const char *page = batch.pages + i * pageSize;
+                WritePageGuard guard;
+                if (fileHandle.pinPageForWrite(batch.firstPageNum + i, guard) != 0) return -1;
+                memcpy(guard.data(), page, pageSize);
+                if (logChange(fileHandle, guard, WAL_PAGE_IMAGE, 0, page, pageSize, lsn) != 0) return -1;
+            }
+        }
+        for (unsigned i = 0; i < batch.count; i++) {
+            if (map.setFreeSpace(batch.firstPageNum + i, batch.space[i]) != 0) return -1;
+            if (zones != nullptr && zones->save(batch.firstPageNum + i) != 0) return -1;
+        }
+        return 0;
+    }
+
+    // The free-space and zone maps of files opened through the manager, by file name.
+    struct FreeSpaceMaps {
+        std::mutex latch;
+        std::unordered_map<std::string, unsigned> openCounts;               // open handles per file name
+        std::unordered_map<std::string, std::unique_ptr<FreeSpaceMap> > maps; // loaded maps
+        std::unordered_map<std::string, std::unique_ptr<ZoneMap> > zoneMaps;
+    };
+
     RecordBasedFileManager &RecordBasedFileManager::instance() {
-        static RecordBasedFileManager _rbf_manager = RecordBasedFileManager();
+        static RecordBasedFileManager _rbf_manager;
         return _rbf_manager;
     }
 
-    RecordBasedFileManager::RecordBasedFileManager() = default;
-
-    RecordBasedFileManager::~RecordBasedFileManager() = default;
+    // The paged file manager is created first, so it is still there when the maps are closed at exit.
+    RecordBasedFileManager::RecordBasedFileManager() : spaceMaps(new FreeSpaceMaps()) {
+        PagedFileManager::instance();
+    }
 
-    RecordBasedFileManager::RecordBasedFileManager(const RecordBasedFileManager &) = default;
+    RecordBasedFileManager::~RecordBasedFileManager() {
+        for (auto &map : spaceMaps->maps) {
+            map.second->close();
+        }
+        for (auto &map : spaceMaps->zoneMaps) {
+            map.second->close();
+        }
+        delete spaceMaps;
+    }
 
-    RecordBasedFileManager &RecordBasedFileManager::operator=(const RecordBasedFileManager &) = default;
+    // The copy operations stay declared and undefined: a copy would share the maps it deletes.
 
     RC RecordBasedFileManager::createFile(const std::string &fileName) {
-        return -1;
+        return createFile(fileName, PAGE_SIZE);
+    }
+
+    RC RecordBasedFileManager::createFile(const std::string &fileName, unsigned pageSize) {
+        if (PagedFileManager::instance().createFile(fileName, pageSize) != 0) return -1;
+        // A map left behind by an earlier file of this name would be rebuilt anyway; drop it now.
+        if (resetFreeSpaceMap(fileName) != 0) return -1;
+        return resetZoneMap(fileName);
     }
 
     RC RecordBasedFileManager::destroyFile(const std::string &fileName) {
-        return -1;
+        resetFreeSpaceMap(fileName);
+        resetZoneMap(fileName);
+        if (PagedFileManager::instance().destroyFile(fileName) != 0) return -1;
+        return LogManager::instance().forgetFile(fileName);
     }
 
     RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
-        return -1;
+        if (PagedFileManager::instance().openFile(fileName, fileHandle) != 0) return -1;
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        spaceMaps->openCounts[fileName]++;
+        return 0;
     }
 
     RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
-        return -1;
+        std::string fileName = fileHandle.getFileName();
+        if (PagedFileManager::instance().closeFile(fileHandle) != 0) return -1;
+
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        auto count = spaceMaps->openCounts.find(fileName);
+        if (count == spaceMaps->openCounts.end() || --count->second > 0) return 0;
+        spaceMaps->openCounts.erase(count);
+        RC rc = 0;
+        auto map = spaceMaps->maps.find(fileName);
+        if (map != spaceMaps->maps.end()) {
+            rc = map->second->close();
+            spaceMaps->maps.erase(map);
+        }
+        auto zones = spaceMaps->zoneMaps.find(fileName);
+        if (zones != spaceMaps->zoneMaps.end()) {
+            if (zones->second->close() != 0) rc = -1;
+            spaceMaps->zoneMaps.erase(zones);
+        }
+        return rc;
+    }
+
+    RC RecordBasedFileManager::resetFreeSpaceMap(const std::string &fileName) {
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        auto map = spaceMaps->maps.find(fileName);
+        if (map != spaceMaps->maps.end()) {
+            map->second->close();
+            spaceMaps->maps.erase(map);
+        }
+        // There is no map file until the first change to the data file.
+        PagedFileManager::instance().destroyFile(FreeSpaceMap::fileNameOf(fileName));
+        return 0;
+    }
+
+    RC RecordBasedFileManager::resetZoneMap(const std::string &fileName) {
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        auto map = spaceMaps->zoneMaps.find(fileName);
+        if (map != spaceMaps->zoneMaps.end()) {
+            map->second->close();
+            spaceMaps->zoneMaps.erase(map);
+        }
+        PagedFileManager::instance().destroyFile(ZoneMap::fileNameOf(fileName));
+        return 0;
+    }
+
+    // The map of the file behind fileHandle, loaded on first use. A map that does not match the file is
+    // rebuilt from the pages, one read each.
+    RC RecordBasedFileManager::freeSpaceMap(FileHandle &fileHandle, FreeSpaceMap *&map) {
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        std::unique_ptr<FreeSpaceMap> &entry = spaceMaps->maps[fileHandle.getFileName()];
+        if (entry) {
+            map = entry.get();
+            return 0;
+        }
+
+        std::unique_ptr<FreeSpaceMap> loaded(new FreeSpaceMap());
+        unsigned pageSize = fileHandle.getPageSize();
+        unsigned numPages = fileHandle.getNumberOfPages();
+        bool rebuild;
+        RC rc = loaded->open(fileHandle.getFileName(), pageSize, numPages, rebuild);
+        for (PageNum pageNum = 0; rc == 0 && rebuild && pageNum < numPages; pageNum++) {
+            PageGuard page;
+            if (fileHandle.pinPage(pageNum, page) != 0 ||
+                loaded->setFreeSpace(pageNum, usableSpace(page.data(), pageSize)) != 0) {
+                rc = -1;
+            }
+        }
+        if (rc != 0) {
+            spaceMaps->maps.erase(fileHandle.getFileName());
+            return -1;
+        }
+        entry = std::move(loaded);
+        map = entry.get();
+        return 0;
+    }
+
+    // The zone map of the file behind fileHandle, loaded on first use with the pages it does not cover unknown,
+    // or nullptr when it is not for recordDescriptor. A change with another descriptor than the map's starts
+    // the map over for it; a scan only gives its descriptor to a map without one.
+    RC RecordBasedFileManager::zoneMap(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                       bool change, ZoneMap *&map) {
+        std::lock_guard<std::mutex> guard(spaceMaps->latch);
+        std::unique_ptr<ZoneMap> &entry = spaceMaps->zoneMaps[fileHandle.getFileName()];
+        if (!entry) {
+            std::unique_ptr<ZoneMap> loaded(new ZoneMap());
+            if (loaded->open(fileHandle.getFileName(), fileHandle.getNumberOfPages()) != 0) {
+                spaceMaps->zoneMaps.erase(fileHandle.getFileName());
+                return -1;
+            }
+            entry = std::move(loaded);
+        }
+        map = entry.get();
+        if (!map->matches(recordDescriptor) && (change || !map->hasDescriptor()) &&
+            map->setDescriptor(recordDescriptor) != 0) {
+            return -1;
+        }
+        if (!map->matches(recordDescriptor)) map = nullptr;
+        return 0;
     }
 
     RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                             const void *data, RID &rid) {
-        return -1;
+        unsigned length = encodedSize(recordDescriptor, data);
+        if (length > maxRecordSize(fileHandle.getPageSize())) return -1;
+
+        FreeSpaceMap *map;
+        ZoneMap *zones;
+        if (freeSpaceMap(fileHandle, map) != 0 || zoneMap(fileHandle, recordDescriptor, true, zones) != 0) return -1;
+        ArenaBuffer buffer(fileHandle.getPageSize());
+        char *record = buffer.data();
+        encodeRecord(recordDescriptor, data, 0, record);
+        LSN lsn = 0;
+        unsigned numPages = fileHandle.getNumberOfPages();
+        if (insertEncoded(fileHandle, *map, record, length, rid, lsn) != 0) return -1;
+        if (zones != nullptr) {
+            if (rid.pageNum >= numPages) zones->clear(rid.pageNum);
+            widenZone(*zones, rid.pageNum, record, true);
+            if (zones->save(rid.pageNum) != 0) return -1;
+        }
+        return commitChanges(lsn);
+    }
+
+    RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                             const std::vector<const void *> &batch, std::vector<RID> &rids) {
+        unsigned pageSize = fileHandle.getPageSize();
+        rids.clear();
+        if (batch.empty()) return 0;
+        for (const void *data : batch) {
+            if (encodedSize(recordDescriptor, data) > maxRecordSize(pageSize)) return -1;
+        }
+        FreeSpaceMap *map;
+        ZoneMap *zones;
+        if (freeSpaceMap(fileHandle, map) != 0 || zoneMap(fileHandle, recordDescriptor, true, zones) != 0) return -1;
+
+        ArenaBuffer buffer(RBFM_BATCH_PAGES * pageSize);
+        PageBatch pages{buffer.data(), fileHandle.getNumberOfPages(), 0, false, {}};
+        ArenaBuffer recordBuffer(pageSize);
+        char *record = recordBuffer.data();
+        unsigned length = encodedSize(recordDescriptor, batch[0]);
+
+        // The last page is continued if it takes at least the first record.
+        if (pages.firstPageNum > 0) {
+            PageGuard last;
+            if (fileHandle.pinPage(pages.firstPageNum - 1, last) != 0) return -1;
+            if (usableSpace(last.data(), pageSize) >= length) {
+                memcpy(pages.pages, last.data(), pageSize);
+                pages.firstPageNum--;
+                pages.count = 1;
+                pages.refill = true;
+                pages.space[0] = usableSpace(pages.pages, pageSize);
+            }
+        }
+
+        LSN lsn = 0;
+        rids.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (i > 0) length = encodedSize(recordDescriptor, batch[i]);
+            encodeRecord(recordDescriptor, batch[i], 0, record);
+
+            // First fit among the pages of the batch, so a large record does not close a page small ones
+            // could still fill.
+            unsigned p = 0;
+            while (p < pages.count && pages.space[p] < length) p++;
+            if (p == pages.count) {
+                if (pages.count == RBFM_BATCH_PAGES) {
+                    if (writeBatch(fileHandle, *map, zones, pages, lsn) != 0) return -1;
+                    pages.firstPageNum += pages.count;
+                    pages.count = 0;
+                    pages.refill = false;
+                    p = 0;
+                }
+                initPage(pages.pages + p * pageSize, pageSize);
+                if (zones != nullptr) zones->clear(pages.firstPageNum + p);
+                pages.count++;
+            }
+            char *page = pages.pages + p * pageSize;
+            RID rid;
+            rid.pageNum = pages.firstPageNum + p;
+            rid.slotNum = placeRecord(page, pageSize, record, length);
+            pages.space[p] = usableSpace(page, pageSize);
+            if (zones != nullptr) widenZone(*zones, rid.pageNum, record, true);
+            rids.push_back(rid);
+        }
+        if (writeBatch(fileHandle, *map, zones, pages, lsn) != 0) return -1;
+        return commitChanges(lsn);
     }
 
     RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                           const RID &rid, void *data) {
-        return -1;
+        PageGuard guard;
+        const char *record;
+        if (locateRecord(fileHandle, rid, guard, record) != 0) return -1;
+        decodeRecord(recordDescriptor, record, data);
+        return 0;
+    }
+
+    // Each pass reads its RIDs in page order and pins every page once. The
+    // first pass reads the RIDs as given; records an update moved away are read by a second pass from the
+    // RIDs their tombstones hold. The tuples are decoded into a staging area and put in order at the end.
+    RC RecordBasedFileManager::readRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                           const std::vector<RID> &rids, std::vector<char> &data,
+                                           std::vector<size_t> &offsets) {
+        unsigned pageSize = fileHandle.getPageSize();
+        // A decoded tuple is at most the stored record plus null indicators and a length for every field.
+        unsigned slack = nullBytes(recordDescriptor.size()) + recordDescriptor.size() * sizeof(unsigned);
+        std::vector<std::pair<RID, size_t> > pending(rids.size());       // a RID to read and its position
+        for (size_t i = 0; i < rids.size(); i++) {
+            pending[i] = std::make_pair(rids[i], i);
+        }
+        std::vector<char> staging;
+        size_t staged = 0;
+        std::vector<std::pair<size_t, size_t> > decoded(rids.size());   // offset and length in staging
+
+        for (int pass = 0; pass < 2 && !pending.empty(); pass++) {
+            std::sort(pending.begin(), pending.end(),
+                      [](const std::pair<RID, size_t> &a, const std::pair<RID, size_t> &b) {
+                          return a.first.pageNum != b.first.pageNum ? a.first.pageNum < b.first.pageNum
+                                                                    : a.first.slotNum < b.first.slotNum;
+                      });
+            std::vector<std::pair<RID, size_t> > forwarded;
+            PageGuard guard;
+            for (size_t i = 0; i < pending.size(); i++) {
+                const RID &rid = pending[i].first;
+                if ((!guard.isPinned() || guard.getPageNum() != rid.pageNum) &&
+                    fileHandle.pinPageNoReadAhead(rid.pageNum, guard) != 0) {
+                    return -1;
+                }
+                const char *page = guard.data();
+                if (rid.slotNum >= footer(page, pageSize)[1] || slot(page, pageSize, rid.slotNum)[1] == 0) return -1;
+                const char *record = page + slot(page, pageSize, rid.slotNum)[0];
+                if (recordHeader(record) & RECORD_TOMBSTONE) {
+                    // Tombstones only ever point at the moved record itself.
+                    if (pass > 0) return -1;
+                    RID target;
+                    memcpy(&target.pageNum, record + sizeof(PageOffset), sizeof(unsigned));
+                    memcpy(&target.slotNum, record + sizeof(PageOffset) + sizeof(unsigned), sizeof(PageOffset));
+                    forwarded.push_back(std::make_pair(target, pending[i].second));
+                    continue;
+                }
+                size_t bound = staged + slot(page, pageSize, rid.slotNum)[1] + slack;
+                if (staging.size() < bound) staging.resize(std::max(bound, 2 * staging.size()));
+                unsigned length = decodeRecord(recordDescriptor, record, staging.data() + staged);
+                decoded[pending[i].second] = std::make_pair(staged, (size_t) length);
+                staged += length;
+            }
+            pending.swap(forwarded);
+        }
+
+        data.resize(staged);
+        offsets.resize(rids.size() + 1);
+        size_t offset = 0;
+        for (size_t i = 0; i < rids.size(); i++) {
+            offsets[i] = offset;
+            memcpy(data.data() + offset, staging.data() + decoded[i].first, decoded[i].second);
+            offset += decoded[i].second;
+        }
+        offsets[rids.size()] = offset;
+        return 0;
     }
 
     RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                             const RID &rid) {
-        return -1;
+        unsigned pageSize = fileHandle.getPageSize();
+        FreeSpaceMap *map;
+        ZoneMap *zones;
+        if (freeSpaceMap(fileHandle, map) != 0 || zoneMap(fileHandle, recordDescriptor, false, zones) != 0) return -1;
+        if (checkRecord(fileHandle, rid) != 0) return -1;
+        LSN lsn = 0;
+        WritePageGuard guard;
+        if (fileHandle.pinPageForWrite(rid.pageNum, guard) != 0) return -1;
+        char *page = guard.data();
+        if (rid.slotNum >= footer(page, pageSize)[1] || slot(page, pageSize, rid.slotNum)[1] == 0) return -1;
+
+        const char *record = page + slot(page, pageSize, rid.slotNum)[0];
+        if (recordHeader(record) & RECORD_TOMBSTONE) {
+            RID target;
+            memcpy(&target.pageNum, record + sizeof(PageOffset), sizeof(unsigned));
+            memcpy(&target.slotNum, record + sizeof(PageOffset) + sizeof(unsigned), sizeof(PageOffset));
+            WritePageGuard targetGuard;
+            if (fileHandle.pinPageForWrite(target.pageNum, targetGuard) != 0) return -1;
+            removeRecord(targetGuard.data(), pageSize, target.slotNum);
+            if (logChange(fileHandle, targetGuard, WAL_RECORD_DELETE, target.slotNum, nullptr, 0, lsn) != 0 ||
+                map->setFreeSpace(target.pageNum, usableSpace(targetGuard.data(), pageSize)) != 0) {
+                return -1;
+            }
+        }
+        removeRecord(page, pageSize, rid.slotNum);
+        if (logChange(fileHandle, guard, WAL_RECORD_DELETE, rid.slotNum, nullptr, 0, lsn) != 0 ||
+            map->setFreeSpace(rid.pageNum, usableSpace(page, pageSize)) != 0) {
+            return -1;
+        }
+        if (zones != nullptr) {
+            zones->loosen(rid.pageNum);
+            if (zones->save(rid.pageNum) != 0) return -1;
+        }
+        return commitChanges(lsn);
     }
 
     RC RecordBasedFileManager::printRecord(const std::vector<Attribute> &recordDescriptor, const void *data,
                                            std::ostream &out) {
-        return -1;
+        unsigned fieldCount = recordDescriptor.size();
+        const char *nulls = (const char *) data;
+        const char *value = nulls + nullBytes(fieldCount);
+
+        for (unsigned i = 0; i < fieldCount; i++) {
+            if (i > 0) out << ", ";
+            out << recordDescriptor[i].name << ": ";
+            if (isNull(nulls, i)) {
+                out << "NULL";
+                continue;
+            }
+            switch (recordDescriptor[i].type) {
+                case TypeInt: {
+                    int intValue;
+                    memcpy(&intValue, value, sizeof(int));
+                    out << intValue;
+                    value += sizeof(int);
+                    break;
+                }
+                case TypeReal: {
+                    float realValue;
+                    memcpy(&realValue, value, sizeof(float));
+                    out << realValue;
+                    value += sizeof(float);
+                    break;
+                }
+                case TypeVarChar: {
+                    unsigned length;
+                    memcpy(&length, value, sizeof(unsigned));
+                    out << std::string(value + sizeof(unsigned), length);
+                    value += sizeof(unsigned) + length;
+                    break;
+                }
+            }
+        }
+        out << std::endl;
+        return 0;
     }
 
     RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                             const void *data, const RID &rid) {
-        return -1;
+        unsigned pageSize = fileHandle.getPageSize();
+        unsigned length = encodedSize(recordDescriptor, data);
+        if (length > maxRecordSize(pageSize)) return -1;
+
+        FreeSpaceMap *map;
+        ZoneMap *zones;
+        if (freeSpaceMap(fileHandle, map) != 0 || zoneMap(fileHandle, recordDescriptor, true, zones) != 0) return -1;
+        if (checkRecord(fileHandle, rid) != 0) return -1;
+        LSN lsn = 0;
+        WritePageGuard guard;
+        if (fileHandle.pinPageForWrite(rid.pageNum, guard) != 0) return -1;
+        char *page = guard.data();
+        if (rid.slotNum >= footer(page, pageSize)[1] || slot(page, pageSize, rid.slotNum)[1] == 0) return -1;
+
+        // Drop a previously forwarded copy; the tombstone left behind is replaced below.
+        const char *current = page + slot(page, pageSize, rid.slotNum)[0];
+        if (recordHeader(current) & RECORD_TOMBSTONE) {
+            RID target;
+            memcpy(&target.pageNum, current + sizeof(PageOffset), sizeof(unsigned));
+            memcpy(&target.slotNum, current + sizeof(PageOffset) + sizeof(unsigned), sizeof(PageOffset));
+            WritePageGuard targetGuard;
+            if (fileHandle.pinPageForWrite(target.pageNum, targetGuard) != 0) return -1;
+            removeRecord(targetGuard.data(), pageSize, target.slotNum);
+            if (logChange(fileHandle, targetGuard, WAL_RECORD_DELETE, target.slotNum, nullptr, 0, lsn) != 0 ||
+                map->setFreeSpace(target.pageNum, usableSpace(targetGuard.data(), pageSize)) != 0) {
+                return -1;
+            }
+        }
+
+        ArenaBuffer buffer(pageSize);
+        char *record = buffer.data();
+        unsigned currentLength = slot(page, pageSize, rid.slotNum)[1];
+        if (length <= currentLength || freeSpace(page, pageSize) >= length - currentLength) {
+            encodeRecord(recordDescriptor, data, 0, record);
+            resizeRecord(page, pageSize, rid.slotNum, length);
+            memcpy(page + slot(page, pageSize, rid.slotNum)[0], record, length);
+            if (logChange(fileHandle, guard, WAL_RECORD_UPDATE, rid.slotNum, record, length, lsn) != 0 ||
+                map->setFreeSpace(rid.pageNum, usableSpace(page, pageSize)) != 0 ||
+                updateZone(zones, rid.pageNum, record) != 0) {
+                return -1;
+            }
+            return commitChanges(lsn);
+        }
+
+        // The page cannot hold the new version: move it and leave a tombstone behind.
+        RID target;
+        encodeRecord(recordDescriptor, data, RECORD_MOVED, record);
+        if (insertEncoded(fileHandle, *map, record, length, target, lsn) != 0) return -1;
+
+        char tombstone[TOMBSTONE_SIZE];
+        PageOffset header = RECORD_TOMBSTONE;
+        memcpy(tombstone, &header, sizeof(PageOffset));
+        memcpy(tombstone + sizeof(PageOffset), &target.pageNum, sizeof(unsigned));
+        memcpy(tombstone + sizeof(PageOffset) + sizeof(unsigned), &target.slotNum, sizeof(PageOffset));
+        resizeRecord(page, pageSize, rid.slotNum, TOMBSTONE_SIZE);
+        memcpy(page + slot(page, pageSize, rid.slotNum)[0], tombstone, TOMBSTONE_SIZE);
+        if (logChange(fileHandle, guard, WAL_RECORD_UPDATE, rid.slotNum, tombstone, TOMBSTONE_SIZE, lsn) != 0 ||
+            map->setFreeSpace(rid.pageNum, usableSpace(page, pageSize)) != 0 ||
+            updateZone(zones, rid.pageNum, record) != 0) {
+            return -1;
+        }
+        return commitChanges(lsn);
+    }
+
+    // Log records describe a change relative to the page state they were made in, and a page on disk holds
+    // exactly the changes up to its pageLsn, so reapplying the later records in LSN order rebuilds the page.
+    RC RecordBasedFileManager::redoChange(char *page, unsigned pageSize, const LogRecordHeader &header,
+                                          const char *payload, bool &applied) {
+        applied = false;
+        if (pageLsn(page, pageSize) >= header.lsn) return 0;
+
+        unsigned length = header.length - sizeof(LogRecordHeader);
+        PageOffset *f = footer(page, pageSize);
+        switch (header.type) {
+            case WAL_PAGE_FORMAT:
+                initPage(page, pageSize);
+                break;
+            case WAL_RECORD_INSERT: {
+                if (header.slotNum < f[1] && slot(page, pageSize, header.slotNum)[1] != 0) return -1;
+                unsigned newSlots = header.slotNum < f[1] ? 0 : header.slotNum + 1 - f[1];
+                if (freeSpace(page, pageSize) < length + newSlots * SLOT_SIZE) return -1;
+                placeRecordAt(page, pageSize, header.slotNum, payload, length);
+                break;
+            }
+            case WAL_RECORD_UPDATE:
+                if (header.slotNum >= f[1] || slot(page, pageSize, header.slotNum)[1] == 0) return -1;
+                resizeRecord(page, pageSize, header.slotNum, length);
+                memcpy(page + slot(page, pageSize, header.slotNum)[0], payload, length);
+                break;
+            case WAL_RECORD_DELETE:
+                if (header.slotNum >= f[1]) return -1;
+                removeRecord(page, pageSize, header.slotNum);
+                break;
+            case WAL_PAGE_IMAGE:
+                if (length != pageSize) return -1;
+                memcpy(page, payload, pageSize);
+                break;
+            default:
+                return -1;
+        }
+        setPageLsn(page, pageSize, header.lsn);
+        applied = true;
+        return 0;
+    }
+
+    LSN RecordBasedFileManager::getPageLsn(const char *page, unsigned pageSize) {
+        return pageLsn(page, pageSize);
     }
 
     RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                              const RID &rid, const std::string &attributeName, void *data) {
-        return -1;
+        unsigned i = 0;
+        while (i < recordDescriptor.size() && recordDescriptor[i].name != attributeName) i++;
+        if (i == recordDescriptor.size()) return -1;
+
+        PageGuard guard;
+        const char *record;
+        if (locateRecord(fileHandle, rid, guard, record) != 0) return -1;
+
+        // The attribute is returned with its own one-byte null indicator.
+        char *out = (char *) data;
+        const char *field;
+        unsigned length;
+        if (!locateField(record, i, field, length)) {
+            out[0] = (char) 0x80;
+            return 0;
+        }
+        out[0] = 0;
+        copyField(recordDescriptor[i], field, length, out + 1);
+        return 0;
+    }
+
+    // Scan comparators: one instance per attribute type and operator, so the operator is a constant the
+    // compiler folds and a record is tested without any switch. value is in the format of a record field.
+    template<CompOp op, typename T>
+    static bool holds(T a, T b) {
+        switch (op) {
+            case EQ_OP:
+                return a == b;
+            case LT_OP:
+                return a < b;
+            case LE_OP:
+                return a <= b;
+            case GT_OP:
+                return a > b;
+            case GE_OP:
+                return a >= b;
+            case NE_OP:
+                return a != b;
+            default:
+                return true;
+        }
+    }
+
+    template<CompOp op, typename T>
+    static bool compareFixed(const char *field, unsigned length, const char *value) {
+        T a, b;
+        memcpy(&a, field, sizeof(T));
+        memcpy(&b, value, sizeof(T));
+        return holds<op>(a, b);
+    }
+
+    template<CompOp op>
+    static bool compareVarChar(const char *field, unsigned length, const char *value) {
+        unsigned valueLength;
+        memcpy(&valueLength, value, sizeof(unsigned));
+        int order = memcmp(field, value + sizeof(unsigned), std::min(length, valueLength));
+        if (order == 0) order = length < valueLength ? -1 : length > valueLength ? 1 : 0;
+        return holds<op>(order, 0);
+    }
+
+    template<CompOp op>
+    static FieldComparator comparatorFor(AttrType type) {
+        switch (type) {
+            case TypeInt:
+                return compareFixed<op, int>;
+            case TypeReal:
+                return compareFixed<op, float>;
+            default:
+                return compareVarChar<op>;
+        }
+    }
+
+    static FieldComparator compileComparator(AttrType type, CompOp compOp) {
+        switch (compOp) {
+            case EQ_OP:
+                return comparatorFor<EQ_OP>(type);
+            case LT_OP:
+                return comparatorFor<LT_OP>(type);
+            case LE_OP:
+                return comparatorFor<LE_OP>(type);
+            case GT_OP:
+                return comparatorFor<GT_OP>(type);
+            case GE_OP:
+                return comparatorFor<GE_OP>(type);
+            case NE_OP:
+                return comparatorFor<NE_OP>(type);
+            default:
+                return nullptr;
+        }
+    }
+
+    // Zone tests: whether a condition can hold for no value from min to max, in the same way as the comparators.
+    template<CompOp op, typename T>
+    static bool excludesRange(const char *minBytes, const char *maxBytes, const char *value) {
+        T min, max, v;
+        memcpy(&min, minBytes, sizeof(T));
+        memcpy(&max, maxBytes, sizeof(T));
+        memcpy(&v, value, sizeof(T));
+        switch (op) {
+            case EQ_OP:
+                return !(min <= v && v <= max);
+            case LT_OP:
+                return !(min < v);
+            case LE_OP:
+                return !(min <= v);
+            case GT_OP:
+                return !(max > v);
+            case GE_OP:
+                return !(max >= v);
+            case NE_OP:
+                return min == v && max == v;
+            default:
+                return false;
+        }
+    }
+
+    template<CompOp op>
+    static ZoneTest zoneTestFor(AttrType type) {
+        switch (type) {
+            case TypeInt:
+                return excludesRange<op, int>;
+            case TypeReal:
+                return excludesRange<op, float>;
+            default:
+                return nullptr;
+        }
+    }
+
+    static ZoneTest compileZoneTest(AttrType type, CompOp compOp) {
+        switch (compOp) {
+            case EQ_OP:
+                return zoneTestFor<EQ_OP>(type);
+            case LT_OP:
+                return zoneTestFor<LT_OP>(type);
+            case LE_OP:
+                return zoneTestFor<LE_OP>(type);
+            case GT_OP:
+                return zoneTestFor<GT_OP>(type);
+            case GE_OP:
+                return zoneTestFor<GE_OP>(type);
+            case NE_OP:
+                return zoneTestFor<NE_OP>(type);
+            default:
+                return nullptr;
+        }
+    }
+
+    // A prior for how often a condition holds, as passed out of tested records: equality rarely, inequality
+    // almost always, a range about a third of the time. The prior counts as a few hundred records, so the
+    // scan's own counts take over quickly.
+    static void estimateSelectivity(CompOp compOp, ScanCondition &condition) {
+        condition.tested = 300;
+        condition.passed = compOp == EQ_OP ? 30 : compOp == NE_OP ? 270 : 100;
+    }
+
+    // Resolve the condition attribute and keep where its field end lies in a record with the descriptor's
+    // field count, which is every record the descriptor wrote.
+    static RC compileCondition(const std::vector<Attribute> &recordDescriptor, const AttributeCondition &term,
+                               ScanCondition &condition) {
+        unsigned i = 0;
+        while (i < recordDescriptor.size() && recordDescriptor[i].name != term.attribute) i++;
+        if (i == recordDescriptor.size() || term.value == nullptr) return -1;
+        condition.compare = compileComparator(recordDescriptor[i].type, term.compOp);
+        if (condition.compare == nullptr) return -1;
+        condition.excludes = compileZoneTest(recordDescriptor[i].type, term.compOp);
+        condition.zone = -1;
+
+        unsigned length = sizeof(int);
+        if (recordDescriptor[i].type == TypeVarChar) {
+            memcpy(&length, term.value, sizeof(unsigned));
+            length += sizeof(unsigned);
+        }
+        const char *bytes = (const char *) term.value;
+        condition.value.assign(bytes, bytes + length);
+        condition.field = i;
+        condition.fieldEndAt = sizeof(PageOffset) + nullBytes(recordDescriptor.size()) + i * sizeof(PageOffset);
+        condition.cost = recordDescriptor[i].type == TypeVarChar ? 2 : 1;
+        estimateSelectivity(term.compOp, condition);
+        return 0;
+    }
+
+    // Resolve every projected attribute to where it lies in a stored record and to its output null bit.
+    static RC compileProjection(const std::vector<Attribute> &recordDescriptor,
+                                const std::vector<std::string> &attributeNames,
+                                std::vector<ProjectedField> &projection) {
+        projection.clear();
+        for (unsigned j = 0; j < attributeNames.size(); j++) {
+            unsigned i = 0;
+            while (i < recordDescriptor.size() && recordDescriptor[i].name != attributeNames[j]) i++;
+            if (i == recordDescriptor.size()) return -1;
+            ProjectedField projected{};
+            projected.field = i;
+            projected.varChar = recordDescriptor[i].type == TypeVarChar;
+            projected.nullByte = sizeof(PageOffset) + i / 8;
+            projected.nullMask = (unsigned char) (0x80 >> (i % 8));
+            projected.fieldEndAt = sizeof(PageOffset) + nullBytes(recordDescriptor.size()) + i * sizeof(PageOffset);
+            projected.outNullByte = j / 8;
+            projected.outNullMask = (unsigned char) (0x80 >> (j % 8));
+            projection.push_back(projected);
+        }
+        return 0;
+    }
+
+    // Field i of a record stored with the scan's descriptor, from where its end offset is kept: it starts
+    // where field i - 1 ends, field 0 where the values do.
+    static void fieldAt(const char *record, unsigned i, unsigned fieldEndAt, unsigned valuesAt, const char *&field,
+                        unsigned &length) {
+        PageOffset start, end;
+        memcpy(&end, record + fieldEndAt, sizeof(PageOffset));
+        if (i == 0) {
+            start = (PageOffset) valuesAt;
+        } else {
+            memcpy(&start, record + fieldEndAt - sizeof(PageOffset), sizeof(PageOffset));
+        }
+        field = record + start;
+        length = end - start;
+    }
+
+    bool RBFM_ScanIterator::qualifies(const char *record) {
+        if (conditions.empty()) return true;
+        if (conditions.size() > 1 && --untilReorder == 0) reorderConditions();
+        bool planned = (recordHeader(record) & RECORD_FIELD_MASK) == fieldCount;
+        for (ScanCondition &condition : conditions) {
+            const char *field;
+            unsigned length;
+            condition.tested++;
+            if (planned) {
+                if (isNull(record + sizeof(PageOffset), condition.field)) return false;
+                fieldAt(record, condition.field, condition.fieldEndAt, valuesAt, field, length);
+            } else if (!locateField(record, condition.field, field, length)) {
+                return false;
+            }
+            if (!condition.compare(field, length, condition.value.data())) return false;
+            condition.passed++;
+        }
+        return true;
+    }
+
+    // Put the condition that rejects the most records per unit of cost first. The counts are halved, so the
+    // order follows the data when its distribution changes along the file.
+    void RBFM_ScanIterator::reorderConditions() {
+        untilReorder = RBFM_SCAN_REORDER_RECORDS;
+        std::stable_sort(conditions.begin(), conditions.end(), [](const ScanCondition &a, const ScanCondition &b) {
+            // (1 - passed / tested) / cost, compared without dividing
+            return (unsigned long long) (a.tested - a.passed) * b.tested * b.cost >
+                   (unsigned long long) (b.tested - b.passed) * a.tested * a.cost;
+        });
+        for (ScanCondition &condition : conditions) {
+            condition.tested = (condition.tested + 1) / 2;
+            condition.passed = std::min(condition.passed / 2, condition.tested);
+        }
+    }
+
+    // The record in slot current of the pinned page, or nullptr for a free slot. A moved record is returned
+    // under the RID of its tombstone, so it is skipped where it is stored and found through the tombstone;
+    // moved then pins the page it is on, which is off the scan's path and must not disturb read-ahead.
+    RC RBFM_ScanIterator::slotRecord(unsigned current, const char *&record, PageGuard &moved) {
+        unsigned pageSize = fileHandle->getPageSize();
+        const char *page = guard.data();
+        const PageOffset *s = slot(page, pageSize, current);
+        record = nullptr;
+        if (s[1] == 0) return 0;
+        PageOffset header = recordHeader(page + s[0]);
+        if (header & RECORD_MOVED) return 0;
+        if (!(header & RECORD_TOMBSTONE)) {
+            record = page + s[0];
+            return 0;
+        }
+
+        RID target;
+        memcpy(&target.pageNum, page + s[0] + sizeof(PageOffset), sizeof(unsigned));
+        memcpy(&target.slotNum, page + s[0] + sizeof(PageOffset) + sizeof(unsigned), sizeof(PageOffset));
+        if (fileHandle->pinPageNoReadAhead(target.pageNum, moved) != 0) return -1;
+        if (target.slotNum >= footer(moved.data(), pageSize)[1] ||
+            slot(moved.data(), pageSize, target.slotNum)[1] == 0) {
+            return -1;
+        }
+        record = moved.data() + slot(moved.data(), pageSize, target.slotNum)[0];
+        return 0;
+    }
+
+    // Whether the zone map shows that page pageNum holds no record the scan returns: it has none at all, or
+    // one of the conditions holds for none of its values.
+    bool RBFM_ScanIterator::skipPage() const {
+        if (zoneMap == nullptr) return false;
+        const PageZone *page = zoneMap->pageZone(pageNum);
+        if (page == nullptr) return false;
+        if (page->records == 0) return true;
+        for (const ScanCondition &condition : conditions) {
+            if (condition.zone < 0) continue;
+            const FieldZone &zone = zoneMap->fieldZone(pageNum, (unsigned) condition.zone);
+            if (zone.values == 0 || condition.excludes(zone.min, zone.max, condition.value.data())) return true;
+        }
+        return false;
+    }
+
+    // Work the zone of the pinned page out again from the records the scan returns at it.
+    RC RBFM_ScanIterator::rebuildZone() {
+        unsigned slotCount = footer(guard.data(), fileHandle->getPageSize())[1];
+        PageGuard moved;
+        zoneMap->clear(pageNum);
+        for (unsigned current = 0; current < slotCount; current++) {
+            const char *record;
+            if (slotRecord(current, record, moved) != 0) return -1;
+            if (record != nullptr) widenZone(*zoneMap, pageNum, record, true);
+        }
+        return zoneMap->save(pageNum);
+    }
+
+    // Pin the page the scan is on, moving past the pages it has finished and those its zone map rules out;
+    // RBFM_EOF after the last page. A page the map has no tight zone for is given one as it is read.
+    RC RBFM_ScanIterator::pinScanPage() {
+        unsigned pageSize = fileHandle->getPageSize();
+        while (true) {
+            if (!guard.isPinned()) {
+                if (pageNum >= fileHandle->getNumberOfPages()) return RBFM_EOF;
+                if (skipPage()) {
+                    skippedPages++;
+                    pageNum++;
+                    slotNum = 0;
+                    continue;
+                }
+                if (fileHandle->pinPage(pageNum, guard) != 0) return -1;
+                if (zoneMap != nullptr) {
+                    const PageZone *page = zoneMap->pageZone(pageNum);
+                    if ((page == nullptr || page->state == ZONE_LOOSE) && rebuildZone() != 0) return -1;
+                }
+            }
+            if (slotNum < footer(guard.data(), pageSize)[1]) return 0;
+            guard.release();
+            pageNum++;
+            slotNum = 0;
+        }
+    }
+
+    // Records are visited in RID order; only the projected fields of a qualifying one are copied out.
+    RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
+        if (fileHandle == nullptr) return RBFM_EOF;
+        PageGuard moved;
+        RC rc;
+        while ((rc = pinScanPage()) == 0) {
+            unsigned current = slotNum++;
+            const char *record;
+            if (slotRecord(current, record, moved) != 0) return -1;
+            if (record == nullptr || !qualifies(record)) continue;
+            rid.pageNum = pageNum;
+            rid.slotNum = (unsigned short) current;
+            project(record, (char *) data);
+            return 0;
+        }
+        return rc;
+    }
+
+    // The slots of a pinned page are gone through in one loop, which appends every qualifying record.
+    RC RBFM_ScanIterator::getNextBatch(RecordBatch &batch) {
+        batch.rows = 0;
+        if (batch.capacity == 0) batch.capacity = RBFM_SCAN_BATCH_ROWS;
+        batch.rids.resize(batch.capacity);
+        batch.columns.resize(projection.size());
+        for (unsigned j = 0; j < projection.size(); j++) {
+            ColumnVector &column = batch.columns[j];
+            column.type = recordDescriptor[projection[j].field].type;
+            column.ints.resize(column.type == TypeInt ? batch.capacity : 0);
+            column.reals.resize(column.type == TypeReal ? batch.capacity : 0);
+            column.offsets.assign(column.type == TypeVarChar ? 1 : 0, 0);
+            column.bytes.clear();
+            column.nulls.assign((batch.capacity + 7) / 8, 0);
+        }
+        if (fileHandle == nullptr) return RBFM_EOF;
+
+        RC rc = 0;
+        PageGuard moved;
+        while (batch.rows < batch.capacity && (rc = pinScanPage()) == 0) {
+            unsigned slotCount = footer(guard.data(), fileHandle->getPageSize())[1];
+            for (; slotNum < slotCount && batch.rows < batch.capacity; slotNum++) {
+                const char *record;
+                if (slotRecord(slotNum, record, moved) != 0) return -1;
+                if (record == nullptr || !qualifies(record)) continue;
+                batch.rids[batch.rows].pageNum = pageNum;
+                batch.rids[batch.rows].slotNum = (unsigned short) slotNum;
+                append(record, batch);
+                batch.rows++;
+            }
+        }
+        batch.rids.resize(batch.rows);
+        for (ColumnVector &column : batch.columns) {
+            if (column.type == TypeInt) column.ints.resize(batch.rows);
+            if (column.type == TypeReal) column.reals.resize(batch.rows);
+            column.nulls.resize((batch.rows + 7) / 8);
+        }
+        if (rc != 0 && rc != RBFM_EOF) return rc;
+        return batch.rows == 0 ? RBFM_EOF : 0;
+    }
+
+    // Locate a projected field of a record; false when it is NULL.
+    static bool locateProjected(const char *record, bool planned, const ProjectedField &projected,
+                                unsigned valuesAt, const char *&field, unsigned &length) {
+        if (!planned) return locateField(record, projected.field, field, length);
+        if (record[projected.nullByte] & projected.nullMask) return false;
+        fieldAt(record, projected.field, projected.fieldEndAt, valuesAt, field, length);
+        return true;
+    }
+
+    // Copy the projected fields straight from the stored record, in the order asked for.
+    void RBFM_ScanIterator::project(const char *record, char *data) {
+        memset(data, 0, outNullBytes);
+        char *out = data + outNullBytes;
+        bool planned = (recordHeader(record) & RECORD_FIELD_MASK) == fieldCount;
+        for (const ProjectedField &projected : projection) {
+            const char *field;
+            unsigned length;
+            if (!locateProjected(record, planned, projected, valuesAt, field, length)) {
+                data[projected.outNullByte] |= (char) projected.outNullMask;
+                continue;
+            }
+            if (projected.varChar) {
+                memcpy(out, &length, sizeof(unsigned));
+                out += sizeof(unsigned);
+            }
+            memcpy(out, field, length);
+            out += length;
+        }
+    }
+
+    // Add the projected fields of a record to the columns of batch as row batch.rows.
+    void RBFM_ScanIterator::append(const char *record, RecordBatch &batch) {
+        unsigned row = batch.rows;
+        bool planned = (recordHeader(record) & RECORD_FIELD_MASK) == fieldCount;
+        for (unsigned j = 0; j < projection.size(); j++) {
+            ColumnVector &column = batch.columns[j];
+            const char *field;
+            unsigned length;
+            bool present = locateProjected(record, planned, projection[j], valuesAt, field, length);
+            if (!present) column.nulls[row / 8] |= (unsigned char) (0x80 >> (row % 8));
+            switch (column.type) {
+                case TypeInt:
+                    if (present) {
+                        memcpy(&column.ints[row], field, sizeof(int));
+                    } else {
+                        column.ints[row] = 0;
+                    }
+                    break;
+                case TypeReal:
+                    if (present) {
+                        memcpy(&column.reals[row], field, sizeof(float));
+                    } else {
+                        column.reals[row] = 0;
+                    }
+                    break;
+                case TypeVarChar:
+                    if (present) column.bytes.insert(column.bytes.end(), field, field + length);
+                    column.offsets.push_back((unsigned) column.bytes.size());
+                    break;
+            }
+        }
+    }
+
+    unsigned RBFM_ScanIterator::getSkippedPages() const {
+        return skippedPages;
+    }
+
+    RC RBFM_ScanIterator::close() {
+        guard.release();
+        fileHandle = nullptr;
+        zoneMap = nullptr;
+        recordDescriptor.clear();
+        projection.clear();
+        conditions.clear();
+        return 0;
     }
 
     RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                     const std::string &conditionAttribute, const CompOp compOp, const void *value,
                                     const std::vector<std::string> &attributeNames,
                                     RBFM_ScanIterator &rbfm_ScanIterator) {
-        return -1;
+        std::vector<AttributeCondition> conditions;
+        if (compOp != NO_OP) conditions.push_back(AttributeCondition{conditionAttribute, compOp, value});
+        return scan(fileHandle, recordDescriptor, conditions, attributeNames, rbfm_ScanIterator);
     }
 
-} // namespace PeterDB
+    RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                    const std::vector<AttributeCondition> &conditions,
+                                    const std::vector<std::string> &attributeNames,
+                                    RBFM_ScanIterator &rbfm_ScanIterator) {
+        RBFM_ScanIterator &iterator = rbfm_ScanIterator;
+        iterator.close();
+        ZoneMap *zones;
+        if (zoneMap(fileHandle, recordDescriptor, false, zones) != 0) return -1;
+        for (const AttributeCondition &term : conditions) {
+            if (term.compOp == NO_OP) continue;
+            ScanCondition condition{};
+            if (compileCondition(recordDescriptor, term, condition) != 0) return -1;
+            if (zones != nullptr && condition.excludes != nullptr) condition.zone = zones->zoneOf(condition.field);
+            iterator.conditions.push_back(condition);
+        }
+        if (compileProjection(recordDescriptor, attributeNames, iterator.projection) != 0) {
+            iterator.conditions.clear();
+            return -1;
+        }
 
+        unsigned fieldCount = recordDescriptor.size();
+        iterator.fileHandle = &fileHandle;
+        iterator.recordDescriptor = recordDescriptor;
+        iterator.fieldCount = fieldCount;
+        iterator.valuesAt = sizeof(PageOffset) + nullBytes(fieldCount) + fieldCount * sizeof(PageOffset);
+        iterator.outNullBytes = nullBytes(attributeNames.size());
+        iterator.pageNum = 0;
+        iterator.slotNum = 0;
+        iterator.zoneMap = zones;
+        iterator.skippedPages = 0;
+        // Sort the estimates right away, then again once the scan has counts of its own.
+        iterator.untilReorder = 1;
+        return 0;
+    }
+
+} // namespace PeterDB
@@ -0,0 +1,216 @@
+#include "src/include/recovery.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <sys/stat.h>
+
+namespace PeterDB {
+
+    // A page change found by analysis; record points into the log tail loaded by the LogReader.
+    typedef struct RedoRecord {
+        unsigned logFileId;
+        PageNum pageNum;
+        const char *record;
+    } RedoRecord;
+
+    typedef struct RedoCounts {
+        unsigned redone;
+        unsigned skipped;
+        unsigned pages;
+    } RedoCounts;
+
+    typedef std::unordered_map<unsigned, std::unique_ptr<FileHandle> > RedoFiles;     // logFileId -> open file
+
+    static unsigned partitionOf(unsigned logFileId, PageNum pageNum, unsigned numThreads) {
+        unsigned long long key = ((unsigned long long) logFileId << 32) | pageNum;
+        return (unsigned) ((key * 0x9e3779b97f4a7c15ull) >> 32) % numThreads;
+    }
+
+    // Redo one partition page by page. Analysis appended the records in LSN order, and the stable sort keeps
+    // that order among the records of a page.
+    static RC redoPartition(std::vector<RedoRecord> &records, const RedoFiles &files, RedoCounts &counts) {
+        RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+        std::stable_sort(records.begin(), records.end(), [](const RedoRecord &a, const RedoRecord &b) {
+            return a.logFileId != b.logFileId ? a.logFileId < b.logFileId : a.pageNum < b.pageNum;
+        });
+
+        for (size_t first = 0, last; first < records.size(); first = last) {
+            unsigned logFileId = records[first].logFileId;
+            PageNum pageNum = records[first].pageNum;
+            for (last = first + 1; last < records.size(); last++) {
+                if (records[last].logFileId != logFileId || records[last].pageNum != pageNum) break;
+            }
+            auto file = files.find(logFileId);
+            if (file == files.end()) {
+                counts.skipped += last - first;
+                continue;
+            }
+            FileHandle &fileHandle = *file->second;
+            unsigned pageSize = fileHandle.getPageSize();
+
+            // A page written back after its last change is only read; a write pin would make it dirty.
+            LogRecordHeader header{};
+            memcpy(&header, records[last - 1].record, sizeof(header));
+            {
+                PageGuard probe;
+                if (fileHandle.pinPage(pageNum, probe) != 0) return -1;
+                if (rbfm.getPageLsn(probe.data(), pageSize) >= header.lsn) {
+                    counts.skipped += last - first;
+                    continue;
+                }
+            }
+
+            WritePageGuard guard;
+            if (fileHandle.pinPageForWrite(pageNum, guard) != 0) return -1;
+            for (size_t i = first; i < last; i++) {
+                bool applied;
+                memcpy(&header, records[i].record, sizeof(header));
+                if (rbfm.redoChange(guard.data(), pageSize, header, records[i].record + sizeof(LogRecordHeader),
+                                    applied) != 0) {
+                    return -1;
+                }
+                if (applied) {
+                    counts.redone++;
+                } else {
+                    counts.skipped++;
+                }
+            }
+            counts.pages++;
+        }
+        return 0;
+    }
+
+    RecoveryManager &RecoveryManager::instance() {
+        static RecoveryManager _recovery_manager;
+        return _recovery_manager;
+    }
+
+    RecoveryManager::RecoveryManager() : recordCount(0), redoCount(0), skipCount(0), pageCount(0) {}
+
+    RecoveryManager::~RecoveryManager() = default;
+
+    RC RecoveryManager::restart(const std::string &logFileName, bool syncCommit, unsigned numThreads) {
+        LogManager &log = LogManager::instance();
+        if (log.isOpen()) return -1;
+        recordCount = redoCount = skipCount = pageCount = 0;
+        if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 1;
+
+        // Without a log there is nothing to recover.
+        struct stat st{};
+        if (::stat(logFileName.c_str(), &st) == 0 && recover(logFileName, numThreads) != 0) return -1;
+        if (log.open(logFileName, syncCommit) != 0) return -1;
+        // Every page is on disk now, so the next restart starts after everything logged so far.
+        return log.checkpoint(log.getEndLsn());
+    }
+
+    RC RecoveryManager::recover(const std::string &logFileName, unsigned numThreads) {
+        LogReader reader;
+        if (reader.open(logFileName) != 0) return -1;
+
+        // The last checkpoint knows where redo starts and which files the earlier records named.
+        std::unordered_map<unsigned, std::string> fileNames;
+        LSN redoLsn = WAL_HEADER_SIZE;
+        LogRecordHeader header{};
+        const char *record;
+        if (reader.getCheckpointLsn() != 0) {
+            if (reader.load(reader.getCheckpointLsn()) != 0 || (record = reader.next(header)) == nullptr ||
+                header.type != WAL_CHECKPOINT ||
+                decodeCheckpoint(record + sizeof(LogRecordHeader), header.length - sizeof(LogRecordHeader), redoLsn,
+                                 fileNames) != 0) {
+                return -1;
+            }
+        }
+        if (reader.load(redoLsn) != 0) return -1;
+
+        std::vector<std::vector<RedoRecord> > partitions(numThreads);
+        std::unordered_map<unsigned, PageNum> numPages;                     // logFileId -> pages the log refers to
+        while ((record = reader.next(header)) != nullptr) {
+            const char *payload = record + sizeof(LogRecordHeader);
+            unsigned length = header.length - sizeof(LogRecordHeader);
+            if (header.type == WAL_FILE) {
+                fileNames[header.logFileId] = std::string(payload, length);
+                continue;
+            }
+            if (header.type == WAL_CHECKPOINT) {
+                LSN laterRedoLsn;
+                if (decodeCheckpoint(payload, length, laterRedoLsn, fileNames) != 0) return -1;
+                continue;
+            }
+            partitions[partitionOf(header.logFileId, header.pageNum, numThreads)].push_back(
+                    RedoRecord{header.logFileId, header.pageNum, record});
+            PageNum &pages = numPages[header.logFileId];
+            if (header.pageNum >= pages) pages = header.pageNum + 1;
+            recordCount++;
+        }
+
+        // logFileIds only grow, so the file of a name is the one with the largest logFileId; the others were
+        // destroyed, and a checkpoint taken since may no longer name them at all.
+        std::unordered_map<std::string, unsigned> latestIds;
+        for (auto &entry : fileNames) {
+            auto latest = latestIds.emplace(entry.second, entry.first).first;
+            if (entry.first > latest->second) latest->second = entry.first;
+        }
+
+        // Pages appended but never written back come back empty; their records format them again.
+        // The records of a file destroyed since are skipped, even if a file of the same name exists again.
+        RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+        RedoFiles files;
+        RC rc = 0;
+        for (auto &entry : numPages) {
+            auto name = fileNames.find(entry.first);
+            if (name == fileNames.end() || latestIds[name->second] != entry.first) continue;
+            std::unique_ptr<FileHandle> fileHandle(new FileHandle());
+            if (rbfm.openFile(name->second, *fileHandle) != 0) continue;
+            std::vector<char> page(fileHandle->getPageSize(), 0);
+            while (rc == 0 && fileHandle->getNumberOfPages() < entry.second) {
+                if (fileHandle->appendPage(page.data()) != 0) rc = -1;
+            }
+            files[entry.first] = std::move(fileHandle);
+        }
+
+        if (rc == 0) {
+            std::vector<RedoCounts> counts(numThreads, RedoCounts{0, 0, 0});
+            std::vector<RC> results(numThreads, 0);
+            std::vector<std::thread> workers;
+            for (unsigned i = 0; i < numThreads; i++) {
+                workers.emplace_back([&partitions, &files, &counts, &results, i] {
+                    results[i] = redoPartition(partitions[i], files, counts[i]);
+                });
+            }
+            for (unsigned i = 0; i < numThreads; i++) {
+                workers[i].join();
+                if (results[i] != 0) rc = -1;
+                redoCount += counts[i].redone;
+                skipCount += counts[i].skipped;
+                pageCount += counts[i].pages;
+            }
+        }
+
+        // One sync covers every file, so the checkpoint after it may count on all the redone pages.
+        if (rc == 0 && !files.empty() && files.begin()->second->flush() != 0) rc = -1;
+        // The free-space and zone maps do not know about the redone changes; they are rebuilt on the next change
+        // and as scans read the pages.
+        for (auto &file : files) {
+            if (rbfm.closeFile(*file.second) != 0 || rbfm.resetFreeSpaceMap(fileNames[file.first]) != 0 ||
+                rbfm.resetZoneMap(fileNames[file.first]) != 0) {
+                rc = -1;
+            }
+        }
+        return rc;
+    }
+
+    RC RecoveryManager::collectCounterValues(unsigned &recordCount, unsigned &redoCount, unsigned &skipCount,
+                                             unsigned &pageCount) {
+        recordCount = this->recordCount;
+        redoCount = this->redoCount;
+        skipCount = this->skipCount;
+        pageCount = this->pageCount;
+        return 0;
+    }
+
+} // namespace PeterDB
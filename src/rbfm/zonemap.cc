@@ -0,0 +1,272 @@
+#include "src/include/zonemap.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace PeterDB {
+
+    // Page 0 of a map file, followed by the AttrType of every field of the descriptor, one byte each. The
+    // entries follow in pages 1 on, as many whole entries per page as fit. clean is cleared while the map is
+    // open, so a map left behind by a crash is not trusted.
+    typedef struct MapHeader {
+        unsigned magic;
+        unsigned numPages;
+        unsigned clean;
+        unsigned fieldCount;
+    } MapHeader;
+
+    static const unsigned ZONE_MAGIC = 0x4D5A4650; // "PFZM"
+
+    template<typename T>
+    static void widenBounds(FieldZone &bounds, const char *value) {
+        T v, min, max;
+        memcpy(&v, value, sizeof(T));
+        memcpy(&min, bounds.min, sizeof(T));
+        memcpy(&max, bounds.max, sizeof(T));
+        if (v < min) memcpy(bounds.min, value, sizeof(T));
+        if (v > max) memcpy(bounds.max, value, sizeof(T));
+    }
+
+    ZoneMap::ZoneMap() : loaded(false), numPages(0) {}
+
+    ZoneMap::~ZoneMap() {
+        close();
+    }
+
+    std::string ZoneMap::fileNameOf(const std::string &fileName) {
+        return fileName + ZONE_FILE_SUFFIX;
+    }
+
+    RC ZoneMap::open(const std::string &fileName, unsigned numPages) {
+        if (loaded) return -1;
+        PagedFileManager &pfm = PagedFileManager::instance();
+        std::string mapName = fileNameOf(fileName);
+        types.clear();
+        fields.clear();
+        pages.clear();
+        zones.clear();
+        this->numPages = 0;
+
+        bool trusted = false;
+        if (pfm.openFile(mapName, mapHandle) == 0) {
+            unsigned mapPageSize = mapHandle.getPageSize();
+            MapHeader header{};
+            PageGuard guard;
+            if (mapHandle.getNumberOfPages() > 0 && mapHandle.pinPage(0, guard) == 0) {
+                memcpy(&header, guard.data(), sizeof(MapHeader));
+                trusted = header.magic == ZONE_MAGIC && header.clean != 0 && header.numPages <= numPages &&
+                          header.fieldCount <= mapPageSize - sizeof(MapHeader);
+                if (trusted) {
+                    const auto *stored = (const unsigned char *) guard.data() + sizeof(MapHeader);
+                    types.assign(stored, stored + header.fieldCount);
+                    for (unsigned i = 0; i < types.size(); i++) {
+                        if (types[i] != TypeVarChar) fields.push_back(i);
+                    }
+                    trusted = fields.size() <= ZONE_MAX_FIELDS && entrySize() <= mapPageSize;
+                }
+            }
+            guard.release();
+
+            if (trusted) {
+                grow(numPages);
+                unsigned perPage = mapPageSize / entrySize();
+                for (PageNum first = 0; first < header.numPages; first += perPage) {
+                    PageNum mapPageNum = 1 + first / perPage;
+                    if (mapPageNum >= mapHandle.getNumberOfPages()) break;
+                    if (mapHandle.pinPage(mapPageNum, guard) != 0) {
+                        pfm.closeFile(mapHandle);
+                        return -1;
+                    }
+                    unsigned count = std::min(perPage, header.numPages - first);
+                    for (unsigned e = 0; e < count; e++) {
+                        const char *entry = guard.data() + e * entrySize();
+                        memcpy(&pages[first + e], entry, sizeof(PageZone));
+                        if (!fields.empty()) {
+                            memcpy(&zones[(first + e) * fields.size()], entry + sizeof(PageZone),
+                                   fields.size() * sizeof(FieldZone));
+                        }
+                    }
+                }
+            } else {
+                types.clear();
+                fields.clear();
+                if (pfm.closeFile(mapHandle) != 0) return -1;
+            }
+        }
+
+        if (!trusted) {
+            if (recreate(mapName) != 0) return -1;
+            grow(numPages);
+        }
+        mapHandle.setAccessPattern(PFM_ACCESS_RANDOM);
+        loaded = true;
+        return writeHeader(false);
+    }
+
+    RC ZoneMap::close() {
+        if (!loaded) return 0;
+        RC rc = writeHeader(true);
+        if (PagedFileManager::instance().closeFile(mapHandle) != 0) rc = -1;
+        loaded = false;
+        types.clear();
+        fields.clear();
+        numPages = 0;
+        pages.clear();
+        zones.clear();
+        return rc;
+    }
+
+    bool ZoneMap::isOpen() const {
+        return loaded;
+    }
+
+    bool ZoneMap::hasDescriptor() const {
+        return !types.empty();
+    }
+
+    bool ZoneMap::matches(const std::vector<Attribute> &recordDescriptor) const {
+        if (types.size() != recordDescriptor.size()) return false;
+        for (unsigned i = 0; i < types.size(); i++) {
+            if (types[i] != recordDescriptor[i].type) return false;
+        }
+        return true;
+    }
+
+    // The entries written for the old descriptor go with the old map file. A descriptor whose types or
+    // entries do not fit in a map page leaves the map without one, and every page unknown.
+    RC ZoneMap::setDescriptor(const std::vector<Attribute> &recordDescriptor) {
+        if (!loaded) return -1;
+        types.clear();
+        fields.clear();
+        if (recreate(mapHandle.getFileName()) != 0) return -1;
+
+        unsigned mapPageSize = mapHandle.getPageSize();
+        std::vector<unsigned> newFields;
+        for (unsigned i = 0; i < recordDescriptor.size(); i++) {
+            if (recordDescriptor[i].type != TypeVarChar) newFields.push_back(i);
+        }
+        bool fits = recordDescriptor.size() <= mapPageSize - sizeof(MapHeader) && newFields.size() <= ZONE_MAX_FIELDS &&
+                    sizeof(PageZone) + newFields.size() * sizeof(FieldZone) <= mapPageSize;
+        if (fits) {
+            for (const Attribute &attribute : recordDescriptor) {
+                types.push_back((unsigned char) attribute.type);
+            }
+            fields.swap(newFields);
+        }
+        forget();
+        return writeHeader(false);
+    }
+
+    const std::vector<unsigned> &ZoneMap::getFields() const {
+        return fields;
+    }
+
+    int ZoneMap::zoneOf(unsigned field) const {
+        auto found = std::lower_bound(fields.begin(), fields.end(), field);
+        return found != fields.end() && *found == field ? (int) (found - fields.begin()) : -1;
+    }
+
+    const PageZone *ZoneMap::pageZone(PageNum pageNum) const {
+        if (pageNum >= numPages || pages[pageNum].state == ZONE_UNKNOWN) return nullptr;
+        return &pages[pageNum];
+    }
+
+    const FieldZone &ZoneMap::fieldZone(PageNum pageNum, unsigned zone) const {
+        return zones[pageNum * fields.size() + zone];
+    }
+
+    void ZoneMap::clear(PageNum pageNum) {
+        grow(pageNum + 1);
+        pages[pageNum] = PageZone{0, ZONE_EXACT};
+        std::fill(zones.begin() + pageNum * fields.size(), zones.begin() + (pageNum + 1) * fields.size(),
+                  FieldZone{});
+    }
+
+    void ZoneMap::widen(PageNum pageNum, const char *const *values, bool added) {
+        if (pageZone(pageNum) == nullptr) return;
+        if (added) pages[pageNum].records++;
+        FieldZone *bounds = &zones[pageNum * fields.size()];
+        for (unsigned zone = 0; zone < fields.size(); zone++, bounds++) {
+            const char *value = values[zone];
+            if (value == nullptr) {
+                bounds->nulls++;
+            } else if (bounds->values++ == 0) {
+                memcpy(bounds->min, value, sizeof(int));
+                memcpy(bounds->max, value, sizeof(int));
+            } else if (types[fields[zone]] == TypeInt) {
+                widenBounds<int>(*bounds, value);
+            } else {
+                widenBounds<float>(*bounds, value);
+            }
+        }
+    }
+
+    void ZoneMap::loosen(PageNum pageNum) {
+        if (pageZone(pageNum) != nullptr) pages[pageNum].state = ZONE_LOOSE;
+    }
+
+    RC ZoneMap::save(PageNum pageNum) {
+        if (!hasDescriptor() || pageNum >= numPages) return 0;
+        unsigned mapPageSize = mapHandle.getPageSize();
+        unsigned perPage = mapPageSize / entrySize();
+        PageNum mapPageNum = 1 + pageNum / perPage;
+        if (mapHandle.getNumberOfPages() <= mapPageNum) {
+            // Pages of zeros hold unknown entries.
+            std::vector<char> page(mapPageSize, 0);
+            while (mapHandle.getNumberOfPages() <= mapPageNum) {
+                if (mapHandle.appendPage(page.data()) != 0) return -1;
+            }
+        }
+        WritePageGuard guard;
+        if (mapHandle.pinPageForWrite(mapPageNum, guard) != 0) return -1;
+        char *entry = guard.data() + (pageNum % perPage) * entrySize();
+        memcpy(entry, &pages[pageNum], sizeof(PageZone));
+        if (!fields.empty()) {
+            memcpy(entry + sizeof(PageZone), &zones[pageNum * fields.size()], fields.size() * sizeof(FieldZone));
+        }
+        return 0;
+    }
+
+    unsigned ZoneMap::getNumberOfPages() const {
+        return numPages;
+    }
+
+    unsigned ZoneMap::entrySize() const {
+        return sizeof(PageZone) + fields.size() * sizeof(FieldZone);
+    }
+
+    // Cover minPages data pages; the pages added are unknown.
+    void ZoneMap::grow(unsigned minPages) {
+        if (minPages <= numPages) return;
+        pages.resize(minPages, PageZone{0, ZONE_UNKNOWN});
+        zones.resize(minPages * fields.size(), FieldZone{});
+        numPages = minPages;
+    }
+
+    void ZoneMap::forget() {
+        pages.assign(numPages, PageZone{0, ZONE_UNKNOWN});
+        zones.assign(numPages * fields.size(), FieldZone{});
+    }
+
+    // Start an empty map file: a header page and no entries.
+    RC ZoneMap::recreate(const std::string &mapName) {
+        PagedFileManager &pfm = PagedFileManager::instance();
+        if (loaded && pfm.closeFile(mapHandle) != 0) return -1;
+        pfm.destroyFile(mapName);
+        if (pfm.createFile(mapName) != 0 || pfm.openFile(mapName, mapHandle) != 0) return -1;
+        std::vector<char> page(mapHandle.getPageSize(), 0);
+        if (mapHandle.appendPage(page.data()) != 0) return -1;
+        mapHandle.setAccessPattern(PFM_ACCESS_RANDOM);
+        return 0;
+    }
+
+    RC ZoneMap::writeHeader(bool clean) {
+        WritePageGuard guard;
+        if (mapHandle.pinPageForWrite(0, guard) != 0) return -1;
+        MapHeader header{ZONE_MAGIC, numPages, clean ? 1u : 0u, (unsigned) types.size()};
+        memcpy(guard.data(), &header, sizeof(MapHeader));
+        if (!types.empty()) memcpy(guard.data() + sizeof(MapHeader), types.data(), types.size());
+        return 0;
+    }
+
+} // namespace PeterDB
@@ -38,6 +38,11 @@ namespace PeterDB {
         return -1;
     }
 
+    RC RelationManager::insertTuples(const std::string &tableName, const std::vector<const void *> &tuples,
+                                     std::vector<RID> &rids) {
+        return -1;
+    }
+
     RC RelationManager::deleteTuple(const std::string &tableName, const RID &rid) {
         return -1;
     }
@@ -50,6 +55,11 @@ namespace PeterDB {
         return -1;
     }
 
+    RC RelationManager::readTuples(const std::string &tableName, const std::vector<RID> &rids, std::vector<char> &data,
+                                   std::vector<size_t> &offsets) {
+        return -1;
+    }
+
     RC RelationManager::printTuple(const std::vector<Attribute> &attrs, const void *data, std::ostream &out) {
         return -1;
     }
@@ -68,6 +78,13 @@ namespace PeterDB {
         return -1;
     }
 
+    RC RelationManager::scan(const std::string &tableName,
+                             const std::vector<AttributeCondition> &conditions,
+                             const std::vector<std::string> &attributeNames,
+                             RM_ScanIterator &rm_ScanIterator) {
+        return -1;
+    }
+
     RM_ScanIterator::RM_ScanIterator() = default;
 
     RM_ScanIterator::~RM_ScanIterator() = default;
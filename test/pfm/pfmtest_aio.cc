@@ -0,0 +1,144 @@
+#include <cerrno>
+#include <memory>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "src/include/aio.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    // A plain file of numPages pages written and read by a backend directly, without the buffer pool.
+    class PFM_AIO_Test : public PFM_File_Test {
+    public:
+        void SetUp() override {
+            PFM_File_Test::SetUp();
+            fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            ASSERT_GE(fd, 0) << "Creating the file should not fail.";
+            ASSERT_EQ(ftruncate(fd, (off_t) numPages * PAGE_SIZE), 0);
+        }
+
+        void TearDown() override {
+            if (fd >= 0) close(fd);
+            remove(fileName.c_str());
+        }
+
+    protected:
+        const unsigned numPages = 16;           // the queue depth asked for, so one batch fills the queue
+        int fd = -1;
+
+        static char pageValue(unsigned pageNum) {
+            return (char) ('A' + pageNum);
+        }
+
+        static void prepare(PeterDB::IORequest &request, int fd, unsigned pageNum, void *buffer, bool write) {
+            request = PeterDB::IORequest{};
+            request.fd = fd;
+            request.offset = (off_t) pageNum * PAGE_SIZE;
+            request.buffer = buffer;
+            request.length = PAGE_SIZE;
+            request.write = write;
+            request.context = &request;
+        }
+
+        // Reap count requests, at least one at a time, and check that each is one of those submitted.
+        static void reap(PeterDB::AsyncIOBackend &backend, std::vector<PeterDB::IORequest> &requests,
+                         unsigned count, std::set<PeterDB::IORequest *> &completed) {
+            std::vector<PeterDB::IORequest *> batch(count);
+            while (completed.size() < count) {
+                unsigned reaped = backend.complete(batch.data(), count, 1);
+                ASSERT_GT(reaped, 0) << "complete() should wait for a request still in flight.";
+                for (unsigned i = 0; i < reaped; i++) {
+                    ASSERT_GE(batch[i], &requests.front());
+                    ASSERT_LE(batch[i], &requests.back()) << "A completion should be one of the requests submitted.";
+                    EXPECT_EQ(batch[i]->context, batch[i]) << "The context should come back untouched.";
+                    EXPECT_TRUE(completed.insert(batch[i]).second) << "A request should complete only once.";
+                }
+            }
+        }
+
+        void checkBackend(PeterDB::AsyncIOBackend &backend) {
+            ASSERT_GE(backend.getQueueDepth(), numPages);
+
+            // Every page is written in one batch, and a request past the queue depth is refused meanwhile.
+            std::vector<std::vector<char> > pages(numPages);
+            std::vector<PeterDB::IORequest> requests(numPages);
+            std::vector<PeterDB::IORequest *> batch;
+            for (unsigned i = 0; i < numPages; i++) {
+                pages[i].assign(PAGE_SIZE, pageValue(i));
+                prepare(requests[i], fd, i, pages[i].data(), true);
+                batch.push_back(&requests[i]);
+            }
+            ASSERT_EQ(backend.submit(batch.data(), numPages), success) << "Submitting the writes should not fail.";
+            if (backend.getQueueDepth() == numPages) {
+                PeterDB::IORequest extra;
+                prepare(extra, fd, 0, pages[0].data(), false);
+                PeterDB::IORequest *extraRequest = &extra;
+                EXPECT_EQ(backend.submit(&extraRequest, 1), -1) << "A full queue should refuse another request.";
+            }
+            std::set<PeterDB::IORequest *> completed;
+            ASSERT_NO_FATAL_FAILURE(reap(backend, requests, numPages, completed));
+            for (PeterDB::IORequest &request : requests) EXPECT_EQ(request.result, PAGE_SIZE);
+            for (unsigned i = 0; i < numPages; i++) {
+                char value = 0;
+                ASSERT_EQ(pread(fd, &value, 1, (off_t) i * PAGE_SIZE + PAGE_SIZE - 1), 1);
+                EXPECT_EQ(value, pageValue(i)) << "Page " << i << " should have been written.";
+            }
+
+            // Reads go in two batches in reverse order and are reaped as they finish.
+            std::vector<std::vector<char> > buffers(numPages, std::vector<char>(PAGE_SIZE, 0));
+            batch.clear();
+            for (unsigned i = numPages; i-- > 0;) {
+                prepare(requests[i], fd, i, buffers[i].data(), false);
+                batch.push_back(&requests[i]);
+            }
+            ASSERT_EQ(backend.submit(batch.data(), numPages / 2), success) << "Submitting reads should not fail.";
+            ASSERT_EQ(backend.submit(batch.data() + numPages / 2, numPages - numPages / 2), success);
+            completed.clear();
+            ASSERT_NO_FATAL_FAILURE(reap(backend, requests, numPages, completed));
+            for (unsigned i = 0; i < numPages; i++) {
+                EXPECT_EQ(requests[i].result, PAGE_SIZE);
+                EXPECT_EQ(buffers[i][0], pageValue(i)) << "Page " << i << " should have been read.";
+                EXPECT_EQ(buffers[i][PAGE_SIZE - 1], pageValue(i));
+            }
+
+            // A failed request completes like any other, with -errno as its result.
+            PeterDB::IORequest failed;
+            prepare(failed, -1, 0, buffers[0].data(), false);
+            PeterDB::IORequest *failedRequest = &failed, *reaped = nullptr;
+            ASSERT_EQ(backend.submit(&failedRequest, 1), success);
+            ASSERT_EQ(backend.complete(&reaped, 1, 1), 1);
+            EXPECT_EQ(reaped, &failed);
+            EXPECT_EQ(failed.result, -EBADF) << "A read of a bad descriptor should fail with EBADF.";
+            EXPECT_EQ(backend.complete(&reaped, 1, 1), 0) << "With nothing in flight, complete() should not wait.";
+        }
+    };
+
+    TEST_F (PFM_AIO_Test, io_uring_backend_completes_every_request) {
+        // Functions Tested:
+        // 1. IOUringBackend::submit of a batch filling the queue, and of two smaller batches
+        // 2. complete() returns each request once, with its context and the bytes transferred or -errno
+
+        std::unique_ptr<PeterDB::IOUringBackend> backend(PeterDB::IOUringBackend::create(numPages));
+        if (backend == nullptr) GTEST_SKIP() << "The kernel does not allow io_uring here.";
+        EXPECT_STREQ(backend->getName(), "io_uring");
+        ASSERT_NO_FATAL_FAILURE(checkBackend(*backend));
+    }
+
+    TEST_F (PFM_AIO_Test, thread_pool_backend_completes_every_request) {
+        // Functions Tested:
+        // 1. ThreadPoolIOBackend::submit of a batch filling the queue, and of two smaller batches
+        // 2. complete() returns each request once, with its context and the bytes transferred or -errno
+        // 3. AsyncIOBackend::create falls back to the thread pool when io_uring is not allowed
+
+        PeterDB::ThreadPoolIOBackend backend(numPages);
+        EXPECT_STREQ(backend.getName(), "threadpool");
+        ASSERT_NO_FATAL_FAILURE(checkBackend(backend));
+
+        std::unique_ptr<PeterDB::AsyncIOBackend> fallback(PeterDB::AsyncIOBackend::create(numPages, false));
+        ASSERT_NE(fallback, nullptr);
+        EXPECT_STREQ(fallback->getName(), "threadpool");
+    }
+
+} // namespace PeterDBTesting
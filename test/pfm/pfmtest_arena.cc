@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "src/include/arena.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class PFM_Arena_Test : public ::testing::Test {
+    protected:
+        PeterDB::FrameArena &arena = PeterDB::FrameArena::instance();
+        unsigned allocates = 0, refills = 0, maps = 0, hugeMaps = 0;
+
+        // Remember the counters, so a test can check what happened since.
+        void snapshot() {
+            ASSERT_EQ(arena.collectCounterValues(allocates, refills, maps, hugeMaps), success);
+        }
+
+        static bool pageAligned(const void *buffer) {
+            return (uintptr_t) buffer % PFM_MIN_PAGE_SIZE == 0;
+        }
+    };
+
+    TEST_F (PFM_Arena_Test, buffers_are_page_aligned_and_reused) {
+        // Functions Tested:
+        // 1. FrameArena::allocate of every size class, of odd sizes and of a region past PFM_MAX_PAGE_SIZE
+        // 2. A released buffer is handed out again by the same thread without a refill or a new mapping
+        // 3. Buffers of an exited thread are reused by others
+        // 4. collectCounterValues
+
+        for (size_t size : {(size_t) 1, (size_t) PFM_MIN_PAGE_SIZE, (size_t) 5000, (size_t) 16384,
+                            (size_t) PFM_MAX_PAGE_SIZE, (size_t) PFM_MAX_PAGE_SIZE + 1,
+                            (size_t) ARENA_HUGE_PAGE_SIZE + 12345}) {
+            char *buffer = (char *) arena.allocate(size);
+            ASSERT_NE(buffer, nullptr) << "Allocating " << size << " bytes should not fail.";
+            EXPECT_TRUE(pageAligned(buffer)) << "A buffer of " << size << " bytes should be page aligned.";
+            buffer[0] = 'a';
+            buffer[size - 1] = 'z';
+            arena.release(buffer, size);
+        }
+
+        const size_t size = 2 * PFM_MIN_PAGE_SIZE;
+        void *first = arena.allocate(size);
+        arena.release(first, size);
+        ASSERT_NO_FATAL_FAILURE(snapshot());
+        for (unsigned i = 0; i < 100; i++) {
+            void *buffer = arena.allocate(size);
+            EXPECT_EQ(buffer, first) << "The buffer just released should be handed out again.";
+            arena.release(buffer, size);
+        }
+        unsigned allocatesBefore = allocates, refillsBefore = refills, mapsBefore = maps;
+        ASSERT_NO_FATAL_FAILURE(snapshot());
+        EXPECT_EQ(allocates - allocatesBefore, 100);
+        EXPECT_EQ(refills, refillsBefore) << "Reusing a buffer of the thread should not refill its list.";
+        EXPECT_EQ(maps, mapsBefore) << "Reusing a buffer should not map memory.";
+        EXPECT_LE(hugeMaps, maps);
+
+        // More buffers than a thread keeps overflow into the arena and come back from there.
+        std::set<void *> released;
+        std::thread worker([this, &released] {
+            std::vector<void *> buffers;
+            for (unsigned i = 0; i < 4 * ARENA_THREAD_CACHE; i++) buffers.push_back(arena.allocate(size));
+            for (void *buffer : buffers) {
+                released.insert(buffer);
+                arena.release(buffer, size);
+            }
+        });
+        worker.join();
+        EXPECT_EQ(released.size(), 4 * ARENA_THREAD_CACHE) << "Buffers in use should be distinct.";
+        ASSERT_NO_FATAL_FAILURE(snapshot());
+        mapsBefore = maps;
+        std::vector<void *> buffers;
+        for (unsigned i = 0; i < 4 * ARENA_THREAD_CACHE; i++) buffers.push_back(arena.allocate(size));
+        ASSERT_NO_FATAL_FAILURE(snapshot());
+        EXPECT_EQ(maps, mapsBefore) << "The buffers of the exited thread should be reused.";
+        EXPECT_EQ(std::set<void *>(buffers.begin(), buffers.end()).size(), buffers.size());
+        for (void *buffer : buffers) arena.release(buffer, size);
+    }
+
+    TEST_F (PFM_Arena_Test, arena_buffer_owns_its_memory) {
+        // Functions Tested:
+        // 1. ArenaBuffer of the default and of a given size
+        // 2. Its buffer goes back to the arena when it goes out of scope
+        // 3. A size the arena cannot map throws std::bad_alloc
+
+        const void *previous;
+        {
+            PeterDB::ArenaBuffer buffer;
+            EXPECT_EQ(buffer.size(), PFM_MAX_PAGE_SIZE);
+            ASSERT_NE(buffer.data(), nullptr);
+            EXPECT_TRUE(pageAligned(buffer.data()));
+            buffer.data()[PFM_MAX_PAGE_SIZE - 1] = 'z';
+            previous = buffer.data();
+        }
+        {
+            PeterDB::ArenaBuffer buffer;
+            EXPECT_EQ(buffer.data(), previous) << "The released buffer should be handed out again.";
+        }
+        PeterDB::ArenaBuffer small(100);
+        EXPECT_EQ(small.size(), 100);
+        EXPECT_TRUE(pageAligned(small.data()));
+
+        EXPECT_THROW(PeterDB::ArenaBuffer huge((size_t) 1 << 62), std::bad_alloc)
+                                    << "A buffer larger than the address space should not be handed out.";
+    }
+
+} // namespace PeterDBTesting
@@ -0,0 +1,180 @@
+#include <cstring>
+#include <random>
+
+#include "src/include/pfm.h"
+#include "src/include/compress.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class PFM_Compress_Test : public PFM_File_Test {
+    public:
+        void SetUp() override {
+            pfm.destroyFile(fileName);
+            PFM_File_Test::SetUp();
+        }
+
+        void TearDown() override {
+            ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+            pfm.destroyFile(fileName);
+        }
+
+    protected:
+        const unsigned guardSize = 256;                // bytes past the target a decoder must leave alone
+        const char guardByte = 0x5a;
+
+        // A page of uniformly random bytes, which does not compress.
+        static std::vector<char> randomPage(unsigned seed) {
+            std::mt19937 random(seed);
+            std::vector<char> page(PAGE_SIZE);
+            for (char &c : page) c = (char) (random() & 0xff);
+            return page;
+        }
+
+        // A page laid out like a slotted page: records of repeated fields at the front, a directory at the
+        // back and zeros in between.
+        static std::vector<char> slottedPage(unsigned seed) {
+            std::vector<char> page(PAGE_SIZE, 0);
+            unsigned offset = 0;
+            for (unsigned i = 0; i < 40; i++) {
+                std::string record = "employee" + std::to_string(seed * 100 + i) + "|" + std::to_string(20 + i % 50);
+                memcpy(page.data() + offset, record.data(), record.size());
+                offset += (unsigned) record.size();
+                unsigned short slot[2] = {(unsigned short) offset, (unsigned short) record.size()};
+                memcpy(page.data() + PAGE_SIZE - 4 * (i + 1), slot, sizeof(slot));
+            }
+            return page;
+        }
+
+        static std::vector<char> compress(const std::vector<char> &page) {
+            std::vector<char> compressed(2 * PAGE_SIZE);
+            unsigned length = PeterDB::PageCodec::compress(page.data(), (unsigned) page.size(), compressed.data(),
+                                                           (unsigned) compressed.size());
+            EXPECT_GT(length, 0) << "Compressing into twice the page size should not fail.";
+            compressed.resize(length);
+            return compressed;
+        }
+
+        // Decode into a target of targetSize bytes followed by a guard region, which must come back untouched.
+        PeterDB::RC decompress(const char *source, unsigned size, unsigned targetSize,
+                               std::vector<char> &target) {
+            target.assign(targetSize + guardSize, guardByte);
+            PeterDB::RC rc = PeterDB::PageCodec::decompress(source, size, target.data(), targetSize);
+            for (unsigned i = targetSize; i < target.size(); i++) {
+                EXPECT_EQ(target[i], guardByte) << "Decoding wrote past its target, at byte " << i << ".";
+                if (target[i] != guardByte) break;
+            }
+            return rc;
+        }
+
+        void reopen(PeterDB::FileHandle &fileHandle) {
+            // Evict the file from the cache of idle files, so it is read back from disk.
+            ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+            ASSERT_EQ(pfm.setFileCacheSize(0), success);
+            ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        }
+    };
+
+    TEST_F (PFM_Compress_Test, codec_round_trips_pages) {
+        // Functions Tested:
+        // 1. PageCodec::compress and decompress of all-zero, slotted and random pages
+        // 2. A random page grows, and does not fit in less than a page
+
+        std::vector<char> zeros(PAGE_SIZE, 0), slotted = slottedPage(1), random = randomPage(1);
+        std::vector<char> target;
+        for (const std::vector<char> *page : {&zeros, &slotted, &random}) {
+            std::vector<char> compressed = compress(*page);
+            ASSERT_EQ(decompress(compressed.data(), (unsigned) compressed.size(), PAGE_SIZE, target), success)
+                                        << "Decoding a compressed page should not fail.";
+            EXPECT_EQ(memcmp(target.data(), page->data(), PAGE_SIZE), 0) << "The page should round trip.";
+        }
+
+        EXPECT_LT(compress(zeros).size(), 64) << "A page of zeros should shrink to a few bytes.";
+        EXPECT_LT(compress(slotted).size(), PAGE_SIZE / 2) << "A slotted page should compress.";
+        EXPECT_GE(compress(random).size(), PAGE_SIZE) << "A random page should not compress.";
+
+        std::vector<char> small(PAGE_SIZE - PFM_COMPRESSED_SLOT_ALIGN);
+        EXPECT_EQ(PeterDB::PageCodec::compress(random.data(), PAGE_SIZE, small.data(), (unsigned) small.size()), 0)
+                                    << "Compressing into too small a target should report that it does not fit.";
+    }
+
+    TEST_F (PFM_Compress_Test, codec_rejects_truncated_and_corrupt_input) {
+        // Functions Tested:
+        // 1. PageCodec::decompress of every truncation of a compressed page
+        // 2. A match offset of 0 and one reaching before the start of the page
+        // 3. A target smaller than the page
+        // 4. Random byte flips never make the decoder write past its target
+
+        std::vector<char> slotted = slottedPage(2), target;
+        std::vector<char> compressed = compress(slotted);
+        for (unsigned size = 0; size < compressed.size(); size++) {
+            PeterDB::RC rc = decompress(compressed.data(), size, PAGE_SIZE, target);
+            // A page ending in a match ends in an empty last sequence, and the stream is complete without it.
+            if (size + 1 == compressed.size() && compressed[size] == 0) continue;
+            EXPECT_EQ(rc, -1)
+                                        << "Decoding " << size << " of " << compressed.size() << " bytes should fail.";
+        }
+        EXPECT_EQ(decompress(compressed.data(), (unsigned) compressed.size(), PAGE_SIZE / 2, target), -1)
+                                    << "Decoding into a target smaller than the page should fail.";
+
+        // A page of zeros is one literal, then a match at offset 1 covering the rest of the page.
+        std::vector<char> zeros = compress(std::vector<char>(PAGE_SIZE, 0));
+        ASSERT_EQ((unsigned char) zeros[0] >> 4, 1) << "The first sequence should hold one literal.";
+        ASSERT_EQ(decompress(zeros.data(), (unsigned) zeros.size(), PAGE_SIZE, target), success);
+        for (unsigned offset : {0u, 2u, 0xffffu}) {
+            std::vector<char> corrupt = zeros;
+            corrupt[2] = (char) (offset & 0xff);
+            corrupt[3] = (char) (offset >> 8);
+            EXPECT_EQ(decompress(corrupt.data(), (unsigned) corrupt.size(), PAGE_SIZE, target), -1)
+                                        << "A match at offset " << offset << " should be rejected.";
+        }
+
+        std::mt19937 random(2);
+        for (unsigned i = 0; i < 1000; i++) {
+            std::vector<char> corrupt = compressed;
+            corrupt[random() % corrupt.size()] ^= (char) (1 + random() % 255);
+            decompress(corrupt.data(), (unsigned) corrupt.size(), PAGE_SIZE, target);
+            if (HasFailure()) break;
+        }
+    }
+
+    TEST_F (PFM_Compress_Test, compressed_file_survives_reopen) {
+        // Functions Tested:
+        // 1. createCompressedFile, appendPage, writePage and readPage
+        // 2. A page rewritten as random bytes outgrows its slot and moves, one rewritten as zeros shrinks
+        // 3. Every page reads back after the file is closed, evicted from the file cache and reopened
+
+        const unsigned numPages = 50, grownPage = 7, shrunkPage = 20;
+        ASSERT_EQ(pfm.createCompressedFile(fileName), success) << "Creating the file should not fail.";
+        PeterDB::FileHandle fileHandle;
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+
+        std::vector<std::vector<char> > pages;
+        for (unsigned i = 0; i < numPages; i++) {
+            pages.push_back(slottedPage(i));
+            ASSERT_EQ(fileHandle.appendPage(pages[i].data()), success) << "Appending a page should not fail.";
+        }
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages);
+        ASSERT_NO_FATAL_FAILURE(reopen(fileHandle));
+        EXPECT_LT(getFileSize(fileName), (std::streamoff) numPages * PAGE_SIZE / 2)
+                                    << "Slotted pages should be stored compressed.";
+
+        pages[grownPage] = randomPage(grownPage);
+        pages[shrunkPage].assign(PAGE_SIZE, 0);
+        ASSERT_EQ(fileHandle.writePage(grownPage, pages[grownPage].data()), success)
+                                    << "Writing a page that outgrows its slot should not fail.";
+        ASSERT_EQ(fileHandle.writePage(shrunkPage, pages[shrunkPage].data()), success)
+                                    << "Writing a page should not fail.";
+        ASSERT_NO_FATAL_FAILURE(reopen(fileHandle));
+
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "Rewriting pages should not change the page count.";
+        std::vector<char> page(PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.readPage(i, page.data()), success) << "Reading page " << i << " should not fail.";
+            EXPECT_EQ(memcmp(page.data(), pages[i].data(), PAGE_SIZE), 0) << "Page " << i << " should read back.";
+        }
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+    }
+
+} // namespace PeterDBTesting
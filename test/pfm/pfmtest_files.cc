@@ -0,0 +1,203 @@
+#include <string>
+#include <vector>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    // A freshly created file, with background write-back off so written pages stay dirty in the pool.
+    class PFM_Files_Test : public PFM_File_Test {
+    public:
+        void SetUp() override {
+            pfm.destroyFile(fileName);
+            PFM_File_Test::SetUp();
+            ASSERT_EQ(pfm.setFlushInterval(0), success);
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should not fail.";
+        }
+
+        void TearDown() override {
+            // Either handle may be closed already, and closing it again fails harmlessly.
+            pfm.closeFile(mappedHandle);
+            pfm.closeFile(fileHandle);
+            ASSERT_EQ(pfm.setFlushInterval(BPM_FLUSH_INTERVAL_MS), success);
+            ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+            pfm.destroyFile(fileName);
+        }
+
+    protected:
+        PeterDB::FileHandle fileHandle, mappedHandle;
+
+        static std::vector<char> page(char value, unsigned pageSize = PAGE_SIZE) {
+            return std::vector<char>(pageSize, value);
+        }
+
+        void appendPages(unsigned count, char value) {
+            for (unsigned i = 0; i < count; i++) {
+                ASSERT_EQ(fileHandle.appendPage(page(value).data()), success) << "Appending a page should not fail.";
+            }
+        }
+
+        // Check the first and last byte of a page read through handle.
+        static void readPage(PeterDB::FileHandle &handle, PeterDB::PageNum pageNum, char value) {
+            std::vector<char> data(handle.getPageSize(), 0);
+            ASSERT_EQ(handle.readPage(pageNum, data.data()), success) << "Reading page " << pageNum << " failed.";
+            EXPECT_EQ(data.front(), value) << "Page " << pageNum << " has the wrong contents.";
+            EXPECT_EQ(data.back(), value) << "Page " << pageNum << " has the wrong contents.";
+        }
+    };
+
+    TEST_F (PFM_Files_Test, mapped_handle_sees_pool_writes_and_appends) {
+        // Functions Tested:
+        // 1. openFileMapped writes back pages still dirty in the buffer pool before it maps the file
+        // 2. Pages appended through the pool after mapping become visible, also to a guard pinned before
+        // 3. writePage, appendPage and pinPageForWrite on a mapped handle fail and change nothing
+
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_NO_FATAL_FAILURE(appendPages(8, 'a'));
+        ASSERT_EQ(fileHandle.writePage(3, page('w').data()), success) << "Writing a page should not fail.";
+
+        ASSERT_EQ(pfm.openFileMapped(fileName, mappedHandle), success) << "Mapping the file should not fail.";
+        EXPECT_EQ(mappedHandle.getNumberOfPages(), 8);
+        ASSERT_NO_FATAL_FAILURE(readPage(mappedHandle, 3, 'w'));
+        ASSERT_NO_FATAL_FAILURE(readPage(mappedHandle, 7, 'a'));
+        PeterDB::PageGuard guard;
+        ASSERT_EQ(mappedHandle.pinPage(2, guard), success) << "Pinning a mapped page should not fail.";
+        EXPECT_NE(mappedHandle.pinPage(8, guard), success) << "A page past the end should not be pinned.";
+        ASSERT_EQ(mappedHandle.pinPage(2, guard), success);
+
+        // Enough pages that the mapping has to grow, possibly to a new address.
+        ASSERT_NO_FATAL_FAILURE(appendPages(600, 'b'));
+        EXPECT_EQ(mappedHandle.getNumberOfPages(), 608) << "The mapped handle should see the appended pages.";
+        ASSERT_NO_FATAL_FAILURE(readPage(mappedHandle, 607, 'b'));
+        PeterDB::PageGuard appendedGuard;
+        ASSERT_EQ(mappedHandle.pinPage(300, appendedGuard), success);
+        EXPECT_EQ(appendedGuard.data()[0], 'b');
+        EXPECT_EQ(guard.data()[PAGE_SIZE - 1], 'a') << "A guard pinned before the mapping grew should stay valid.";
+        guard.release();
+        appendedGuard.release();
+
+        PeterDB::WritePageGuard writeGuard;
+        EXPECT_EQ(mappedHandle.writePage(0, page('x').data()), -1) << "A mapped handle should not write.";
+        EXPECT_EQ(mappedHandle.appendPage(page('x').data()), -1) << "A mapped handle should not append.";
+        EXPECT_EQ(mappedHandle.pinPageForWrite(0, writeGuard), -1) << "A mapped handle should not pin for write.";
+        EXPECT_FALSE(writeGuard.isPinned());
+        EXPECT_EQ(mappedHandle.getNumberOfPages(), 608);
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 0, 'a'));
+        ASSERT_EQ(pfm.closeFile(mappedHandle), success) << "Closing the mapped handle should not fail.";
+    }
+
+    TEST_F (PFM_Files_Test, page_size_is_recorded_and_checked) {
+        // Functions Tested:
+        // 1. createFile with a page size other than PAGE_SIZE, which getPageSize reports
+        // 2. The size comes from the file header after the file is evicted from the file cache and reopened
+        // 3. Sizes that are not a power of two or lie outside PFM_MIN_PAGE_SIZE..PFM_MAX_PAGE_SIZE are rejected
+
+        const unsigned pageSize = 4 * PAGE_SIZE, numPages = 5;
+        ASSERT_EQ(pfm.destroyFile(fileName), success);
+        ASSERT_EQ(pfm.createFile(fileName, pageSize), success) << "Creating a file of 16 KB pages should not fail.";
+        EXPECT_EQ(getFileSize(fileName), (std::streamoff) pageSize) << "The header should fill a whole page.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        EXPECT_EQ(fileHandle.getPageSize(), pageSize);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(page((char) ('a' + i), pageSize).data()), success);
+        }
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(pfm.setFileCacheSize(0), success);
+        ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+        EXPECT_EQ(getFileSize(fileName), (std::streamoff) (numPages + 1) * pageSize);
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Reopening the file should not fail.";
+        EXPECT_EQ(fileHandle.getPageSize(), pageSize) << "The page size should survive a reopen.";
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, i, (char) ('a' + i)));
+        }
+
+        const std::string otherName = fileName + "_sized";
+        for (unsigned invalid : {0u, 1024u, 2048u, 4095u, 6144u, 12288u, 65535u, 131072u, 0x80000000u}) {
+            EXPECT_EQ(pfm.createFile(otherName, invalid), -1) << "A page size of " << invalid << " should be rejected.";
+            EXPECT_FALSE(fileExists(otherName)) << "A rejected file should not be created.";
+            remove(otherName.c_str());
+        }
+        for (unsigned valid : {(unsigned) PFM_MIN_PAGE_SIZE, (unsigned) PFM_MAX_PAGE_SIZE}) {
+            ASSERT_EQ(pfm.createFile(otherName, valid), success) << "A page size of " << valid << " is allowed.";
+            PeterDB::FileHandle otherHandle;
+            ASSERT_EQ(pfm.openFile(otherName, otherHandle), success);
+            EXPECT_EQ(otherHandle.getPageSize(), valid);
+            ASSERT_EQ(pfm.closeFile(otherHandle), success);
+            ASSERT_EQ(pfm.destroyFile(otherName), success);
+        }
+    }
+
+    TEST_F (PFM_Files_Test, file_cache_reuses_evicts_and_forgets_files) {
+        // Functions Tested:
+        // 1. Reopening a closed file is served by the file cache, counted by collectFileCacheCounterValues
+        // 2. setFileCacheSize evicts the least recently closed idle files first
+        // 3. destroyFile and createFile of a cached name, also while it is open, give a fresh empty file
+
+        unsigned opens, hits, evicts, opensBefore, hitsBefore, evictsBefore;
+        ASSERT_EQ(pfm.collectFileCacheCounterValues(opensBefore, hitsBefore, evictsBefore), success);
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Reopening the file should not fail.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success);
+        ASSERT_EQ(pfm.collectFileCacheCounterValues(opens, hits, evicts), success);
+        EXPECT_EQ(opens - opensBefore, 1) << "Only the first open should reach the file system.";
+        EXPECT_EQ(hits - hitsBefore, 1) << "The reopen should be served by the cache.";
+        EXPECT_EQ(evicts - evictsBefore, 0) << "A closed file should stay cached.";
+
+        // Idle, least recently closed first: fileName, then names[0], names[1], names[2].
+        std::vector<std::string> names;
+        for (unsigned i = 0; i < 3; i++) {
+            names.push_back(fileName + "_" + std::to_string(i));
+            pfm.destroyFile(names[i]);
+            ASSERT_EQ(pfm.createFile(names[i]), success) << "Creating the file should not fail.";
+            PeterDB::FileHandle handle;
+            ASSERT_EQ(pfm.openFile(names[i], handle), success) << "Opening the file should not fail.";
+            ASSERT_EQ(pfm.closeFile(handle), success) << "Closing the file should not fail.";
+        }
+        ASSERT_EQ(pfm.collectFileCacheCounterValues(opensBefore, hitsBefore, evictsBefore), success);
+        ASSERT_EQ(pfm.setFileCacheSize(2), success);
+        ASSERT_EQ(pfm.collectFileCacheCounterValues(opens, hits, evicts), success);
+        EXPECT_EQ(evicts - evictsBefore, 2) << "Shrinking the cache should evict the files past its size.";
+        for (unsigned i : {2u, 1u, 0u}) {
+            PeterDB::FileHandle handle;
+            ASSERT_EQ(pfm.openFile(names[i], handle), success) << "Opening the file should not fail.";
+            ASSERT_EQ(pfm.closeFile(handle), success) << "Closing the file should not fail.";
+        }
+        ASSERT_EQ(pfm.collectFileCacheCounterValues(opens, hits, evicts), success);
+        EXPECT_EQ(hits - hitsBefore, 2) << "The two most recently closed files should have stayed cached.";
+        EXPECT_EQ(opens - opensBefore, 1) << "The least recently closed file should have been evicted.";
+        ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+        for (const std::string &name : names) ASSERT_EQ(pfm.destroyFile(name), success);
+
+        // Recreated while cached and idle.
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(fileHandle.appendPage(page('a').data()), success) << "Appending a page should not fail.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(pfm.destroyFile(fileName), success) << "Destroying a cached file should not fail.";
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Recreating the file should not fail.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the new file should not fail.";
+        EXPECT_EQ(fileHandle.getNumberOfPages(), 0) << "The new file should not show pages of the old one.";
+
+        // Recreated while the old file is still open: each handle keeps its own file.
+        ASSERT_EQ(fileHandle.appendPage(page('b').data()), success);
+        ASSERT_EQ(pfm.destroyFile(fileName), success) << "Destroying an open file should not fail.";
+        ASSERT_EQ(pfm.createFile(fileName), success) << "Recreating the file should not fail.";
+        PeterDB::FileHandle newHandle;
+        ASSERT_EQ(pfm.openFile(fileName, newHandle), success) << "Opening the new file should not fail.";
+        EXPECT_EQ(newHandle.getNumberOfPages(), 0) << "The new file should not show pages of the open one.";
+        ASSERT_EQ(newHandle.appendPage(page('c').data()), success);
+        EXPECT_EQ(fileHandle.getNumberOfPages(), 1);
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 0, 'b'));
+        ASSERT_NO_FATAL_FAILURE(readPage(newHandle, 0, 'c'));
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the destroyed file should not fail.";
+        ASSERT_EQ(pfm.closeFile(newHandle), success) << "Closing the new file should not fail.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success);
+        EXPECT_EQ(fileHandle.getNumberOfPages(), 1);
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 0, 'c'));
+    }
+
+} // namespace PeterDBTesting
@@ -0,0 +1,449 @@
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    // A file of numPages pages, page i filled with pageValue(i), open in fileHandle. Nothing is written back
+    // in the background, so a page on disk changes only when the pool writes it back itself.
+    class PFM_Pool_Test : public PFM_File_Test {
+    public:
+        void SetUp() override {
+            pfm.destroyFile(fileName);
+            PFM_File_Test::SetUp();
+            pfm.setFlushInterval(0);
+            ASSERT_EQ(pfm.createFile(fileName), success) << "Creating the file should not fail.";
+            ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+            for (unsigned i = 0; i < numPages; i++) {
+                ASSERT_EQ(fileHandle.appendPage(page(pageValue(i)).data()), success)
+                                            << "Appending a page should not fail.";
+            }
+        }
+
+        void TearDown() override {
+            // A test may have closed the handle already.
+            pfm.closeFile(fileHandle);
+            pfm.setFlushInterval(BPM_FLUSH_INTERVAL_MS);
+            pfm.setExtentSize(BPM_EXTENT_SIZE);
+            ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+            ASSERT_EQ(pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES), success) << "Restoring the pool should not fail.";
+            pfm.destroyFile(fileName);
+        }
+
+    protected:
+        const unsigned numPages = 64;
+        PeterDB::FileHandle fileHandle;
+
+        static char pageValue(unsigned pageNum) {
+            return (char) (pageNum % 96 + 30);
+        }
+
+        static std::vector<char> page(char value) {
+            return std::vector<char>(PAGE_SIZE, value);
+        }
+
+        // The first byte of a page as the file holds it, past the buffer pool.
+        char onDisk(PeterDB::PageNum pageNum) {
+            char value = 0;
+            int fd = open(fileName.c_str(), O_RDONLY);
+            EXPECT_GE(fd, 0) << "Opening the file for reading should not fail.";
+            EXPECT_EQ(pread(fd, &value, 1, PeterDB::BufferPoolManager::pageOffset(pageNum, PAGE_SIZE)), 1);
+            close(fd);
+            return value;
+        }
+
+        // Closed files stay registered in the file cache; evicting it is what closes one for good.
+        void evictClosedFiles() {
+            ASSERT_EQ(pfm.setFileCacheSize(0), success) << "Evicting the closed files should not fail.";
+            ASSERT_EQ(pfm.setFileCacheSize(PFM_FILE_CACHE_SIZE), success);
+        }
+
+        // Resizing fails while any frame is pinned, which tells whether the guards let go of their pins.
+        bool pinned() {
+            return pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES) != success;
+        }
+
+        void readPage(PeterDB::FileHandle &handle, PeterDB::PageNum pageNum, char value) {
+            std::vector<char> data(PAGE_SIZE);
+            ASSERT_EQ(handle.readPage(pageNum, data.data()), success) << "Reading page " << pageNum
+                                                                      << " should not fail.";
+            ASSERT_EQ(data[0], value) << "Page " << pageNum << " has the wrong content.";
+            ASSERT_EQ(data[PAGE_SIZE - 1], value) << "Page " << pageNum << " has the wrong content.";
+        }
+    };
+
+    TEST_F (PFM_Pool_Test, hits_and_misses_are_counted) {
+        // Functions Tested:
+        // 1. A page appended through the pool is cached, and reading it is a hit
+        // 2. After the pool is reallocated, the first read of a page is a miss and the next one a hit
+        // 3. collectCacheCounterValues
+
+        unsigned hits, misses;
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 3, pageValue(3)));
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hits, misses), success);
+        EXPECT_EQ(hits, 1) << "An appended page should be cached.";
+        EXPECT_EQ(misses, 0);
+
+        ASSERT_EQ(pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES), success) << "Resizing the pool should not fail.";
+        // Out of order, so read-ahead stays out of it.
+        const unsigned order[] = {40, 7, 22, 3, 59, 13};
+        for (unsigned pageNum : order) ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, pageNum, pageValue(pageNum)));
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hits, misses), success);
+        EXPECT_EQ(hits, 1);
+        EXPECT_EQ(misses, 6) << "An emptied pool should miss every page once.";
+
+        for (unsigned pageNum : order) ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, pageNum, pageValue(pageNum)));
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hits, misses), success);
+        EXPECT_EQ(hits, 7) << "Pages read once should stay cached.";
+        EXPECT_EQ(misses, 6);
+    }
+
+    TEST_F (PFM_Pool_Test, dirty_frames_are_written_back_on_eviction) {
+        // Functions Tested:
+        // 1. writePage only changes the cached frame
+        // 2. Reading more pages than the pool holds evicts the dirty frames, which are written back first
+        // 3. The written pages read back after they were evicted
+
+        ASSERT_EQ(pfm.setBufferPoolSize(BPM_MIN_POOL_FRAMES), success) << "Resizing the pool should not fail.";
+        ASSERT_EQ(fileHandle.setAccessPattern(PeterDB::PFM_ACCESS_RANDOM), success);
+        for (unsigned i = 0; i < BPM_MIN_POOL_FRAMES; i++) {
+            ASSERT_EQ(fileHandle.writePage(i, page('w').data()), success) << "Writing a page should not fail.";
+        }
+        EXPECT_EQ(onDisk(0), pageValue(0)) << "A written page should stay in its frame until it is evicted.";
+
+        for (unsigned i = numPages; i-- > BPM_MIN_POOL_FRAMES;) {
+            ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, i, pageValue(i)));
+        }
+        for (unsigned i = 0; i < BPM_MIN_POOL_FRAMES; i++) {
+            EXPECT_EQ(onDisk(i), 'w') << "Evicting page " << i << " should have written it back.";
+        }
+        for (unsigned i = 0; i < BPM_MIN_POOL_FRAMES; i++) ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, i, 'w'));
+    }
+
+    TEST_F (PFM_Pool_Test, dirty_frames_are_written_back_on_the_last_close) {
+        // Functions Tested:
+        // 1. Closing one of two handles of a file writes nothing back
+        // 2. Closing the last handle and evicting the file from the file cache writes the dirty frames back
+
+        PeterDB::FileHandle other;
+        ASSERT_EQ(pfm.openFile(fileName, other), success) << "Opening a second handle should not fail.";
+        ASSERT_EQ(fileHandle.writePage(5, page('x').data()), success) << "Writing a page should not fail.";
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the first handle should not fail.";
+        ASSERT_NO_FATAL_FAILURE(evictClosedFiles());
+        EXPECT_EQ(onDisk(5), pageValue(5)) << "The file is still open, so its frames should stay in the pool.";
+        ASSERT_NO_FATAL_FAILURE(readPage(other, 5, 'x'));
+
+        ASSERT_EQ(pfm.closeFile(other), success) << "Closing the last handle should not fail.";
+        ASSERT_NO_FATAL_FAILURE(evictClosedFiles());
+        EXPECT_EQ(onDisk(5), 'x') << "The last close should write the dirty page back.";
+    }
+
+    TEST_F (PFM_Pool_Test, handles_of_one_inode_share_frames) {
+        // Functions Tested:
+        // 1. A handle opened through a hard link registers the same file in the pool
+        // 2. A page written through one handle is a hit, with the new content, through the other
+
+        std::string linkName = fileName + "_link";
+        remove(linkName.c_str());
+        ASSERT_EQ(link(fileName.c_str(), linkName.c_str()), 0) << "Linking the file should not fail.";
+        PeterDB::FileHandle linked;
+        ASSERT_EQ(pfm.openFile(linkName, linked), success) << "Opening the file through its link should not fail.";
+
+        ASSERT_EQ(fileHandle.writePage(9, page('s').data()), success) << "Writing a page should not fail.";
+        ASSERT_NO_FATAL_FAILURE(readPage(linked, 9, 's'));
+        unsigned hits, misses;
+        ASSERT_EQ(linked.collectCacheCounterValues(hits, misses), success);
+        EXPECT_EQ(hits, 1) << "The page written through the other handle should already be cached.";
+        EXPECT_EQ(misses, 0);
+        EXPECT_EQ(onDisk(9), pageValue(9)) << "The shared frame should not have been written back.";
+
+        ASSERT_EQ(linked.appendPage(page('a').data()), success) << "Appending through the link should not fail.";
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages + 1) << "Both handles should see the appended page.";
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, numPages, 'a'));
+
+        ASSERT_EQ(pfm.closeFile(linked), success);
+        remove(linkName.c_str());
+    }
+
+    TEST_F (PFM_Pool_Test, frame_pinned_across_the_close_of_its_file) {
+        // Functions Tested:
+        // 1. A guard keeps its page readable after the file is closed and evicted from the file cache
+        // 2. Releasing it afterwards discards the frame, and the change made under a write pin with it
+        // 3. The reopened file reads its pages from disk, and the pool has no pinned frame left
+
+        PeterDB::PageGuard reader;
+        PeterDB::WritePageGuard writer;
+        ASSERT_EQ(fileHandle.pinPage(11, reader), success) << "Pinning a page should not fail.";
+        ASSERT_EQ(fileHandle.pinPageForWrite(12, writer), success) << "Pinning a page for write should not fail.";
+        memset(writer.data(), 'p', PAGE_SIZE);
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_NO_FATAL_FAILURE(evictClosedFiles());
+
+        EXPECT_EQ(reader.data()[0], pageValue(11)) << "A pinned frame should outlive the file.";
+        EXPECT_EQ(writer.data()[PAGE_SIZE - 1], 'p');
+        reader.release();
+        writer.release();
+        EXPECT_EQ(onDisk(12), pageValue(12)) << "A change still pinned when the file went away is discarded.";
+
+        ASSERT_EQ(pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES), success)
+                                    << "Resizing the pool should not fail, so no frame is still pinned.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Reopening the file should not fail.";
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 11, pageValue(11)));
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 12, pageValue(12)));
+    }
+
+    TEST_F (PFM_Pool_Test, guards_unpin_on_release_move_and_reassignment) {
+        // Functions Tested:
+        // 1. PageGuard pins its page until release(), and a second release() does nothing
+        // 2. Moving a guard hands the pin over; the guard moved from holds nothing
+        // 3. Move-assigning to a guard, or pinning another page through it, unpins what it held
+        // 4. A guard going out of scope unpins its page
+
+        PeterDB::PageGuard first;
+        ASSERT_EQ(fileHandle.pinPage(3, first), success) << "Pinning a page should not fail.";
+        EXPECT_TRUE(first.isPinned());
+        EXPECT_EQ(first.getPageNum(), 3);
+        EXPECT_EQ(first.data()[0], pageValue(3));
+        EXPECT_TRUE(pinned()) << "The guard should hold its pin.";
+        first.release();
+        EXPECT_FALSE(first.isPinned());
+        first.release();
+        EXPECT_FALSE(pinned()) << "release() should unpin the page.";
+
+        ASSERT_EQ(fileHandle.pinPage(4, first), success);
+        PeterDB::PageGuard second(std::move(first));
+        EXPECT_FALSE(first.isPinned()) << "A guard moved from should hold nothing.";
+        EXPECT_EQ(second.getPageNum(), 4);
+        EXPECT_EQ(second.data()[0], pageValue(4));
+        first.release();
+        EXPECT_TRUE(pinned()) << "Releasing the guard moved from should not unpin the page.";
+
+        PeterDB::PageGuard third;
+        ASSERT_EQ(fileHandle.pinPage(5, third), success);
+        second = std::move(third);
+        EXPECT_EQ(second.getPageNum(), 5);
+        EXPECT_EQ(second.data()[0], pageValue(5));
+        ASSERT_EQ(fileHandle.pinPage(6, second), success) << "Pinning another page through a guard should not fail.";
+        EXPECT_EQ(second.data()[0], pageValue(6));
+        second.release();
+        EXPECT_FALSE(pinned()) << "Every page the guards held before should have been unpinned.";
+
+        {
+            PeterDB::PageGuard scoped;
+            ASSERT_EQ(fileHandle.pinPage(7, scoped), success);
+            EXPECT_TRUE(pinned());
+        }
+        EXPECT_FALSE(pinned()) << "A destroyed guard should unpin its page.";
+    }
+
+    TEST_F (PFM_Pool_Test, write_guards_mark_the_frame_dirty_on_release) {
+        // Functions Tested:
+        // 1. A page changed through a WritePageGuard is written back by flush() once the guard is released
+        // 2. The dirty mark travels with a moved WritePageGuard and is set once, by the guard holding the pin
+        // 3. pinPageForWrite counts a write; a read pin changes nothing on disk
+
+        unsigned reads, writes, appends;
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends), success);
+        unsigned writesBefore = writes;
+
+        PeterDB::WritePageGuard writer;
+        ASSERT_EQ(fileHandle.pinPageForWrite(10, writer), success) << "Pinning a page for write should not fail.";
+        memset(writer.data(), 'd', PAGE_SIZE);
+        ASSERT_EQ(fileHandle.flush(), success) << "Flushing the file should not fail.";
+        EXPECT_EQ(onDisk(10), pageValue(10)) << "A page still pinned for write should not be written back.";
+        writer.release();
+        ASSERT_EQ(fileHandle.flush(), success);
+        EXPECT_EQ(onDisk(10), 'd') << "Releasing the guard should mark the page dirty.";
+
+        PeterDB::WritePageGuard moved;
+        ASSERT_EQ(fileHandle.pinPageForWrite(11, writer), success);
+        moved = std::move(writer);
+        memset(moved.data(), 'e', PAGE_SIZE);
+        writer.release();
+        ASSERT_EQ(fileHandle.flush(), success);
+        EXPECT_EQ(onDisk(11), pageValue(11)) << "The guard moved from should not release the pin.";
+        moved.release();
+        ASSERT_EQ(fileHandle.flush(), success);
+        EXPECT_EQ(onDisk(11), 'e') << "The moved guard should mark the page dirty on release.";
+
+        PeterDB::PageGuard reader;
+        ASSERT_EQ(fileHandle.pinPage(12, reader), success);
+        reader.release();
+        ASSERT_EQ(fileHandle.flush(), success);
+        EXPECT_EQ(onDisk(12), pageValue(12));
+
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends), success);
+        EXPECT_EQ(writes - writesBefore, 2) << "Each pin for write should count as one page write.";
+        EXPECT_FALSE(pinned());
+    }
+
+    TEST_F (PFM_Pool_Test, read_ahead_follows_sequential_access_only) {
+        // Functions Tested:
+        // 1. Two pages read in order start read-ahead with a window of PFM_READ_AHEAD_MIN pages
+        // 2. A sequential scan keeps requesting ahead up to the last page, so it mostly hits the cache
+        // 3. Random access requests nothing, and the next sequential run starts over with the smallest window
+
+        ASSERT_EQ(pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES), success) << "Emptying the pool should not fail.";
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 0, pageValue(0)));
+        EXPECT_EQ(fileHandle.prefetchPageCounter, 0) << "One page is not a sequential run yet.";
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 1, pageValue(1)));
+        EXPECT_EQ(fileHandle.prefetchPageCounter, PFM_READ_AHEAD_MIN);
+
+        for (unsigned i = 2; i < numPages; i++) ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, i, pageValue(i)));
+        EXPECT_EQ(fileHandle.prefetchPageCounter, numPages - 2) << "Every page after the first two should be "
+                                                                   "requested ahead, and only once.";
+        unsigned hits, misses;
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hits, misses), success);
+        EXPECT_EQ(hits + misses, numPages);
+        EXPECT_LT(misses, numPages / 2) << "Read-ahead should have loaded most pages before they were read.";
+
+        unsigned requested = fileHandle.prefetchPageCounter;
+        const unsigned order[] = {40, 10, 50, 20, 60};
+        for (unsigned pageNum : order) ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, pageNum, pageValue(pageNum)));
+        EXPECT_EQ(fileHandle.prefetchPageCounter, requested) << "Random access should not read ahead.";
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 30, pageValue(30)));
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, 31, pageValue(31)));
+        EXPECT_EQ(fileHandle.prefetchPageCounter, requested + PFM_READ_AHEAD_MIN)
+                                    << "A new sequential run should start with the smallest window.";
+    }
+
+    TEST_F (PFM_Pool_Test, vectored_io_stays_coherent_with_cached_frames) {
+        // Functions Tested:
+        // 1. readPages returns a dirty cached page rather than the older one on disk
+        // 2. writePages updates cached frames, and a dirty frame it overwrites is not written back over it
+        // 3. appendPages adds pages that readPage and readPages see
+        // 4. Ranges reaching past the last page, and empty ranges, are rejected
+
+        ASSERT_EQ(fileHandle.writePage(5, page('c').data()), success) << "Writing a page should not fail.";
+        std::vector<char> data(4 * PAGE_SIZE);
+        ASSERT_EQ(fileHandle.readPages(4, 4, data.data()), success) << "Reading a range should not fail.";
+        for (unsigned i = 0; i < 4; i++) {
+            char value = i == 1 ? 'c' : pageValue(4 + i);
+            EXPECT_EQ(data[(size_t) i * PAGE_SIZE], value) << "Page " << 4 + i << " of the range is wrong.";
+        }
+        EXPECT_EQ(onDisk(5), pageValue(5)) << "readPages should not write the dirty page back.";
+
+        PeterDB::PageGuard cached;
+        ASSERT_EQ(fileHandle.pinPage(20, cached), success);
+        cached.release();
+        ASSERT_EQ(fileHandle.writePage(21, page('o').data()), success);
+        std::vector<char> written(3 * PAGE_SIZE, 'v');
+        ASSERT_EQ(fileHandle.writePages(19, 3, written.data()), success) << "Writing a range should not fail.";
+        for (unsigned i = 19; i < 22; i++) {
+            ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, i, 'v'));
+            EXPECT_EQ(onDisk(i), 'v') << "writePages should write page " << i << " through.";
+        }
+        ASSERT_EQ(fileHandle.flush(), success) << "Flushing the file should not fail.";
+        EXPECT_EQ(onDisk(21), 'v') << "The overwritten dirty frame should not be written back.";
+
+        std::vector<char> appended(3 * PAGE_SIZE);
+        for (unsigned i = 0; i < 3; i++) memset(&appended[(size_t) i * PAGE_SIZE], 'x' + i, PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPages(3, appended.data()), success) << "Appending a range should not fail.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages + 3);
+        ASSERT_NO_FATAL_FAILURE(readPage(fileHandle, numPages + 1, 'y'));
+        ASSERT_EQ(fileHandle.readPages(numPages - 1, 4, data.data()), success);
+        EXPECT_EQ(data[0], pageValue(numPages - 1));
+        EXPECT_EQ(data[3 * PAGE_SIZE], 'z');
+
+        EXPECT_NE(fileHandle.readPages(numPages + 1, 3, data.data()), success) << "A range past the end should fail.";
+        EXPECT_NE(fileHandle.writePages(numPages + 2, 2, written.data()), success);
+        EXPECT_NE(fileHandle.readPages(0, 0, data.data()), success) << "An empty range should fail.";
+        EXPECT_NE(fileHandle.appendPages(0, appended.data()), success);
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages + 3) << "Failed calls should not change the file.";
+    }
+
+    TEST_F (PFM_Pool_Test, sync_writes_back_dirty_pages_in_shared_cycles) {
+        // Functions Tested:
+        // 1. FileHandle::flush, i.e. BufferPoolManager::sync, writes every dirty page back before it returns
+        // 2. Concurrent sync() callers are served by fewer flusher cycles than there are calls
+        // 3. collectFlushCounterValues
+
+        for (unsigned i = 0; i < 10; i++) {
+            ASSERT_EQ(fileHandle.writePage(i, page('y').data()), success) << "Writing a page should not fail.";
+        }
+        EXPECT_EQ(onDisk(0), pageValue(0)) << "Nothing should be written back in the background.";
+        ASSERT_EQ(fileHandle.flush(), success) << "Flushing the file should not fail.";
+        for (unsigned i = 0; i < 10; i++) EXPECT_EQ(onDisk(i), 'y') << "Page " << i << " should be on disk.";
+
+        PeterDB::BufferPoolManager &bpm = pfm.bufferPool();
+        unsigned syncsBefore, cyclesBefore, syncs, cycles;
+        ASSERT_EQ(bpm.collectFlushCounterValues(syncsBefore, cyclesBefore), success);
+        const unsigned numThreads = 8, syncsPerThread = 20;
+        std::vector<std::thread> threads;
+        std::vector<unsigned> failures(numThreads, 0);
+        for (unsigned t = 0; t < numThreads; t++) {
+            threads.emplace_back([this, t, &failures] {
+                for (unsigned i = 0; i < syncsPerThread; i++) {
+                    std::vector<char> data = page((char) ('a' + i));
+                    if (fileHandle.writePage(20 + t, data.data()) != success || fileHandle.flush() != success ||
+                        onDisk(20 + t) != data[0]) {
+                        failures[t]++;
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+        for (unsigned t = 0; t < numThreads; t++) {
+            EXPECT_EQ(failures[t], 0) << "Every flush should return with the page written before it on disk.";
+        }
+        ASSERT_EQ(bpm.collectFlushCounterValues(syncs, cycles), success);
+        EXPECT_EQ(syncs - syncsBefore, numThreads * syncsPerThread);
+        EXPECT_LT(cycles - cyclesBefore, syncs - syncsBefore) << "Concurrent syncs should share flusher cycles.";
+    }
+
+    TEST_F (PFM_Pool_Test, appends_reserve_extents_trimmed_on_the_last_close) {
+        // Functions Tested:
+        // 1. Appends reserve space a whole extent at a time, counted by collectCounterValues
+        // 2. getReservedPages, reported as reservedPageCount, shrinks as appends use up the extent
+        // 3. setExtentSize changes the size of the next extent
+        // 4. The unused part of the last extent is released when the evicted file is closed for the last time
+
+        unsigned reads, writes, appends, extents, reserved;
+        const unsigned extentPages = BPM_EXTENT_SIZE / PAGE_SIZE;
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends, extents, reserved), success);
+        if (extents == 0) GTEST_SKIP() << "The file system does not preallocate.";
+        EXPECT_EQ(extents, 1) << "The pages of the fixture should fit in one extent.";
+        EXPECT_EQ(reserved, extentPages - numPages);
+
+        std::vector<char> data((size_t) (extentPages - numPages) * PAGE_SIZE, 'e');
+        ASSERT_EQ(fileHandle.appendPages(extentPages - numPages, data.data()), success);
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends, extents, reserved), success);
+        EXPECT_EQ(extents, 1) << "Filling the extent should not reserve another.";
+        EXPECT_EQ(reserved, 0);
+        ASSERT_EQ(fileHandle.appendPage(page('e').data()), success);
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends, extents, reserved), success);
+        EXPECT_EQ(extents, 2) << "The page past the extent should reserve the next one.";
+        EXPECT_EQ(reserved, extentPages - 1);
+
+        // The pages appended next need one more extent of the smaller size.
+        const unsigned smallExtentPages = 16;
+        ASSERT_EQ(pfm.setExtentSize(smallExtentPages * PAGE_SIZE), success);
+        data.assign((size_t) extentPages * PAGE_SIZE, 'e');
+        ASSERT_EQ(fileHandle.appendPages(extentPages, data.data()), success);
+        ASSERT_EQ(fileHandle.collectCounterValues(reads, writes, appends, extents, reserved), success);
+        EXPECT_EQ(extents, 3);
+        EXPECT_EQ(reserved, smallExtentPages - 1);
+        const unsigned totalPages = 2 * extentPages + 1;
+        ASSERT_EQ(fileHandle.getNumberOfPages(), totalPages);
+
+        struct stat st{};
+        ASSERT_EQ(stat(fileName.c_str(), &st), 0);
+        EXPECT_EQ(st.st_size, (off_t) (totalPages + 1) * PAGE_SIZE) << "Reserved space should not change the size.";
+        EXPECT_GE((off_t) st.st_blocks * 512, (off_t) (totalPages + smallExtentPages) * PAGE_SIZE)
+                                    << "The reserved pages should be allocated.";
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_NO_FATAL_FAILURE(evictClosedFiles());
+        ASSERT_EQ(stat(fileName.c_str(), &st), 0);
+        EXPECT_EQ(st.st_size, (off_t) (totalPages + 1) * PAGE_SIZE);
+        EXPECT_LE((off_t) st.st_blocks * 512, st.st_size) << "The unused reservation should be released.";
+    }
+
+} // namespace PeterDBTesting
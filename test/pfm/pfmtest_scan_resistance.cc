@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "src/include/pfm.h"
+#include "src/include/bpm.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class PFM_Scan_Resistance_Test : public PFM_File_Test {
+    public:
+        void SetUp() override {
+            PFM_File_Test::SetUp();
+            remove(indexFileName.c_str());
+            ASSERT_EQ(pfm.setBufferPoolSize(poolFrames), success) << "Resizing the buffer pool should not fail.";
+        }
+
+        void TearDown() override {
+            ASSERT_EQ(pfm.setBufferPoolSize(BPM_DEFAULT_FRAMES), success) << "Restoring the pool should not fail.";
+            remove(fileName.c_str());
+            remove(indexFileName.c_str());
+        }
+
+    protected:
+        std::string indexFileName = "pfm_test_index_file";
+        const unsigned poolFrames = 256;
+        const unsigned tablePages = 2048;
+        const unsigned indexPages = 64;         // the hot inner nodes an index nested loop join keeps probing
+        const unsigned pagesPerProbe = 8;       // every index page is probed once per 512 scanned pages
+
+        void createPages(const std::string &name, unsigned numPages) {
+            PeterDB::FileHandle fileHandle;
+            ASSERT_EQ(pfm.createFile(name), success) << "Creating the file should not fail: " << name;
+            ASSERT_EQ(pfm.openFile(name, fileHandle), success) << "Opening the file should not fail: " << name;
+            char page[PAGE_SIZE];
+            for (unsigned i = 0; i < numPages; i++) {
+                memset(page, (int) (i % 96 + 30), PAGE_SIZE);
+                ASSERT_EQ(fileHandle.appendPage(page), success) << "Appending a page should not fail.";
+            }
+            ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        }
+    };
+
+    TEST_F (PFM_Scan_Resistance_Test, scan_keeps_index_pages_cached) {
+        // Functions Tested:
+        // 1. Table scan through the default access pattern, which switches to a scan ring
+        // 2. Concurrent random probes of a small index file
+        // 3. Buffer pool hit/miss counters of the index
+
+        createPages(fileName, tablePages);
+        createPages(indexFileName, indexPages);
+
+        PeterDB::FileHandle tableHandle, indexHandle;
+        ASSERT_EQ(pfm.openFile(fileName, tableHandle), success) << "Opening the table should not fail.";
+        ASSERT_EQ(pfm.openFile(indexFileName, indexHandle), success) << "Opening the index should not fail.";
+        ASSERT_EQ(indexHandle.setAccessPattern(PeterDB::PFM_ACCESS_RANDOM), success);
+
+        // Warm up the index, then count only the probes made while the scan runs.
+        char page[PAGE_SIZE];
+        for (unsigned i = 0; i < indexPages; i++) {
+            ASSERT_EQ(indexHandle.readPage(i, page), success) << "Reading an index page should not fail.";
+        }
+        indexHandle.cacheHitCounter = 0;
+        indexHandle.cacheMissCounter = 0;
+
+        std::atomic<unsigned> scannedPages(0);
+        std::atomic<bool> scanFailed(false);
+        std::thread scanner([&] {
+            char buffer[PAGE_SIZE];
+            for (unsigned pass = 0; pass < 2; pass++) {
+                for (unsigned i = 0; i < tablePages; i++) {
+                    if (tableHandle.readPage(i, buffer) != success || buffer[0] != (char) (i % 96 + 30)) {
+                        scanFailed = true;
+                    }
+                    scannedPages++;
+                }
+            }
+        });
+
+        // The probes follow the scan's progress, like an INLJoin probing the index once per outer tuple batch.
+        std::mt19937 random(7);
+        unsigned numProbes = 2 * tablePages / pagesPerProbe;
+        for (unsigned probe = 0; probe < numProbes; probe++) {
+            while (scannedPages < probe * pagesPerProbe) std::this_thread::yield();
+            PeterDB::PageNum pageNum = random() % indexPages;
+            ASSERT_EQ(indexHandle.readPage(pageNum, page), success) << "Probing the index should not fail.";
+            ASSERT_EQ(page[0], (char) (pageNum % 96 + 30)) << "The index page should be intact.";
+        }
+        scanner.join();
+        ASSERT_FALSE(scanFailed) << "The scan should read every table page intact.";
+
+        unsigned hitCount, missCount;
+        ASSERT_EQ(indexHandle.collectCacheCounterValues(hitCount, missCount), success);
+        EXPECT_EQ(hitCount + missCount, numProbes) << "Every probe should be counted.";
+        EXPECT_GE(hitCount * 100, numProbes * 95) << "The scan should not evict the index pages: " << hitCount
+                                                  << " hits, " << missCount << " misses.";
+
+        ASSERT_EQ(pfm.closeFile(tableHandle), success) << "Closing the table should not fail.";
+        ASSERT_EQ(pfm.closeFile(indexHandle), success) << "Closing the index should not fail.";
+    }
+
+} // namespace PeterDBTesting
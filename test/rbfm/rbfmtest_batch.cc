@@ -0,0 +1,132 @@
+#include <set>
+
+#include "src/include/rbfm.h"
+#include "test/utils/rbfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class RBFM_Batch_Test : public RBFM_Employee_Test {
+    protected:
+        // The tuple readRecord would return for a record of this name.
+        std::vector<char> tupleOf(const std::string &name) {
+            std::vector<char> tuple(name.size() + 64);
+            size_t recordSize;
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.size(), name, 25, 177.8, 6200,
+                          tuple.data(), recordSize);
+            tuple.resize(recordSize);
+            return tuple;
+        }
+
+        void insertNames(const std::vector<std::string> &names, std::vector<PeterDB::RID> &rids) {
+            std::vector<std::vector<char> > tuples;
+            std::vector<const void *> batch;
+            for (const std::string &name : names) tuples.push_back(tupleOf(name));
+            for (const std::vector<char> &tuple : tuples) batch.push_back(tuple.data());
+            ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, batch, rids), success)
+                                        << "Inserting a batch should not fail.";
+            ASSERT_EQ(rids.size(), names.size()) << "Every record of the batch should get a RID.";
+        }
+    };
+
+    TEST_F(RBFM_Batch_Test, batch_continues_the_last_page) {
+        // Functions tested
+        // 1. insertRecords into a file whose last page has room fills that page first
+        // 2. The records inserted before the batch are left as they were
+
+        std::vector<PeterDB::RID> before;
+        for (unsigned i = 0; i < 5; i++) {
+            PeterDB::RID rid;
+            ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, "single" + std::to_string(i)));
+            before.push_back(rid);
+        }
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1);
+
+        std::vector<std::string> names;
+        for (unsigned i = 0; i < 20; i++) names.push_back("batch" + std::to_string(i));
+        std::vector<PeterDB::RID> rids;
+        ASSERT_NO_FATAL_FAILURE(insertNames(names, rids));
+        EXPECT_EQ(fileHandle.getNumberOfPages(), 1) << "A batch that fits the last page should not add pages.";
+
+        std::set<std::pair<unsigned, unsigned> > used;
+        for (const PeterDB::RID &rid : before) used.insert(std::make_pair(rid.pageNum, rid.slotNum));
+        for (const PeterDB::RID &rid : rids) {
+            EXPECT_EQ(rid.pageNum, 0) << "The batch should continue the last page.";
+            EXPECT_TRUE(used.insert(std::make_pair(rid.pageNum, rid.slotNum)).second) << "Slots should not be reused.";
+        }
+        for (unsigned i = 0; i < before.size(); i++) {
+            ASSERT_NO_FATAL_FAILURE(readRecord(recordDescriptor, before[i], "single" + std::to_string(i)));
+        }
+        for (unsigned i = 0; i < rids.size(); i++) {
+            ASSERT_NO_FATAL_FAILURE(readRecord(recordDescriptor, rids[i], names[i]));
+        }
+    }
+
+    TEST_F(RBFM_Batch_Test, batch_spans_more_than_batch_pages) {
+        // Functions tested
+        // 1. insertRecords of a batch filling more pages than it keeps in memory at once
+        // 2. Records are placed in order, two per page, across the pages written in between
+        // 3. Every record reads back after the file is reopened
+
+        const unsigned numPages = 2 * RBFM_BATCH_PAGES + 5;
+        std::vector<std::string> names;
+        for (unsigned i = 0; i < 2 * numPages; i++) {
+            // Two records of this name length fill a page.
+            names.push_back(std::to_string(i) + std::string(1800, (char) ('a' + i % 26)));
+        }
+        std::vector<PeterDB::RID> rids;
+        ASSERT_NO_FATAL_FAILURE(insertNames(names, rids));
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages);
+        for (unsigned i = 0; i < rids.size(); i++) {
+            EXPECT_EQ(rids[i].pageNum, i / 2) << "Record " << i << " should be on page " << i / 2 << ".";
+        }
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages);
+        for (unsigned i = 0; i < rids.size(); i++) {
+            ASSERT_NO_FATAL_FAILURE(readRecord(recordDescriptor, rids[i], names[i]));
+        }
+    }
+
+    TEST_F(RBFM_Batch_Test, read_records_in_the_order_given) {
+        // Functions tested
+        // 1. readRecords of RIDs out of page order, with duplicates and RIDs of moved records
+        // 2. Every tuple comes back at the position of its RID
+
+        std::vector<PeterDB::RID> rids;
+        std::vector<std::string> names;
+        for (unsigned i = 0; i < 300; i++) {
+            PeterDB::RID rid;
+            names.push_back("employee" + std::to_string(i));
+            ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, names[i]));
+            rids.push_back(rid);
+        }
+        ASSERT_GT(fileHandle.getNumberOfPages(), 2);
+        // The pages are full, so these records move and leave tombstones behind.
+        for (unsigned i = 0; i < rids.size(); i += 10) {
+            names[i] = std::string(1500, (char) ('a' + i % 26));
+            ASSERT_NO_FATAL_FAILURE(updateRecord(recordDescriptor, rids[i], names[i]));
+        }
+
+        std::vector<unsigned> order;
+        for (unsigned i = rids.size(); i-- > 0;) order.push_back(i);
+        for (unsigned i = 0; i < rids.size(); i += 7) order.push_back(i);
+        order.insert(order.begin(), {20, 5, 20, 20, 5});
+        std::vector<PeterDB::RID> requested;
+        for (unsigned i : order) requested.push_back(rids[i]);
+
+        std::vector<char> data;
+        std::vector<size_t> offsets;
+        ASSERT_EQ(rbfm.readRecords(fileHandle, recordDescriptor, requested, data, offsets), success)
+                                    << "Reading a batch of records should not fail.";
+        ASSERT_EQ(offsets.size(), requested.size() + 1);
+        EXPECT_EQ(offsets.back(), data.size());
+        for (unsigned i = 0; i < order.size(); i++) {
+            std::vector<char> tuple = tupleOf(names[order[i]]);
+            ASSERT_EQ(offsets[i + 1] - offsets[i], tuple.size()) << "Tuple " << i << " has the wrong length.";
+            EXPECT_EQ(memcmp(data.data() + offsets[i], tuple.data(), tuple.size()), 0)
+                                        << "Tuple " << i << " should be record " << order[i] << ".";
+        }
+    }
+
+} // namespace PeterDBTesting
@@ -0,0 +1,190 @@
+#include <set>
+#include <fstream>
+
+#include "src/include/rbfm.h"
+#include "src/include/bpm.h"
+#include "src/include/fsm.h"
+#include "test/utils/rbfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class RBFM_FSM_Test : public RBFM_Employee_Test {
+    public:
+        void TearDown() override {
+            RBFM_Employee_Test::TearDown();
+            remove(savedMapName.c_str());
+        }
+
+    protected:
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        std::string mapName = PeterDB::FreeSpaceMap::fileNameOf(fileName);
+        std::string savedMapName = mapName + ".saved";
+        const unsigned numPages = 12;
+
+        std::vector<PeterDB::RID> rids;
+        std::vector<std::string> names;                 // the name stored at every RID, empty once deleted
+
+        // Two records of this name length fill a page, and leave too little room for a third.
+        static std::string nameOf(unsigned i) {
+            return std::to_string(i) + std::string(1800, (char) ('a' + i % 26));
+        }
+
+        void insertName(const std::string &name, PeterDB::RID &rid) {
+            ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, name));
+            for (unsigned j = 0; j < rids.size(); j++) {
+                if (rids[j].pageNum == rid.pageNum && rids[j].slotNum == rid.slotNum) names[j].clear();
+            }
+            rids.push_back(rid);
+            names.push_back(name);
+        }
+
+        // Fill numPages pages, two records each.
+        void fillFile() {
+            for (unsigned i = 0; i < 2 * numPages; i++) {
+                PeterDB::RID rid;
+                ASSERT_NO_FATAL_FAILURE(insertName(nameOf(i), rid));
+            }
+            ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "Every page should hold two records.";
+        }
+
+        void deleteRecord(unsigned i) {
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                        << "Deleting a record should not fail.";
+            names[i].clear();
+        }
+
+        void reopen() {
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        }
+
+        void checkRecords() {
+            for (unsigned i = 0; i < rids.size(); i++) {
+                if (!names[i].empty()) {
+                    ASSERT_NO_FATAL_FAILURE(readRecord(recordDescriptor, rids[i], names[i]));
+                }
+            }
+        }
+
+        // The map of the closed file as it is now, written back from the buffer pool first.
+        void saveMap() {
+            ASSERT_EQ(pfm.bufferPool().flushAll(), success);
+            std::ifstream in(mapName, std::ios::binary);
+            std::ofstream out(savedMapName, std::ios::binary | std::ios::trunc);
+            ASSERT_TRUE(in.is_open() && out.is_open()) << "Copying the map should not fail.";
+            out << in.rdbuf();
+        }
+
+        // Put a saved map back in place of the current one. It gets a new inode, so the file cache does not
+        // hand out the current map instead.
+        void restoreMap() {
+            ASSERT_EQ(rename(savedMapName.c_str(), mapName.c_str()), 0) << "Restoring the map should not fail.";
+        }
+    };
+
+    TEST_F(RBFM_FSM_Test, missing_map_is_rebuilt) {
+        // Functions tested
+        // 1. A data file whose map is gone gets a map rebuilt from its pages
+        // 2. The rebuilt map knows the room deletes freed
+
+        ASSERT_NO_FATAL_FAILURE(fillFile());
+        ASSERT_NO_FATAL_FAILURE(deleteRecord(3));
+        ASSERT_NO_FATAL_FAILURE(deleteRecord(16));
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_TRUE(fileExists(mapName)) << "Changing the file should have written its map.";
+        ASSERT_EQ(pfm.destroyFile(mapName), success);
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+
+        PeterDB::RID first, second;
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(100), first));
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(101), second));
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages) << "The freed room should be used before appending.";
+        std::set<unsigned> pages = {first.pageNum, second.pageNum};
+        EXPECT_EQ(pages, std::set<unsigned>({rids[3].pageNum, rids[16].pageNum}));
+        EXPECT_TRUE(fileExists(mapName)) << "The map should be written again.";
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+    TEST_F(RBFM_FSM_Test, map_not_closed_cleanly_is_rebuilt) {
+        // Functions tested
+        // 1. A map whose header says it was left open is not trusted, even with the right page count
+        // 2. The rebuilt map knows the room deletes freed since the map was saved
+
+        ASSERT_NO_FATAL_FAILURE(fillFile());
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(saveMap());
+
+        // The saved map says every page is full; clear its clean flag, the fourth word of the header in the
+        // first data page of the map file.
+        unsigned clean = 0;
+        std::fstream map(savedMapName, std::ios::in | std::ios::out | std::ios::binary);
+        map.seekp(PeterDB::BufferPoolManager::pageOffset(0, PAGE_SIZE) + 3 * sizeof(unsigned));
+        map.write(reinterpret_cast<const char *>(&clean), sizeof(unsigned));
+        map.close();
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(deleteRecord(7));
+        ASSERT_NO_FATAL_FAILURE(reopen());
+        ASSERT_NO_FATAL_FAILURE(restoreMap());
+        ASSERT_NO_FATAL_FAILURE(reopen());
+
+        PeterDB::RID rid;
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(100), rid));
+        EXPECT_EQ(rid.pageNum, rids[7].pageNum) << "The rebuilt map should find the freed room.";
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages);
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+    TEST_F(RBFM_FSM_Test, stale_entry_is_corrected_on_insert) {
+        // Functions tested
+        // 1. A clean map promising room a page no longer has is trusted, since it is only a hint
+        // 2. The insert finds the page full, corrects its entry and places the record elsewhere
+        // 3. The records of the full page are left as they were
+
+        ASSERT_NO_FATAL_FAILURE(fillFile());
+        ASSERT_NO_FATAL_FAILURE(deleteRecord(5));
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(saveMap());
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        PeterDB::RID rid;
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(100), rid));
+        ASSERT_EQ(rid.pageNum, rids[5].pageNum) << "The map should find the freed room.";
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(restoreMap());
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(101), rid));
+        EXPECT_EQ(rid.pageNum, numPages) << "With every page full, the record should go to a new page.";
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(102), rid));
+        EXPECT_EQ(rid.pageNum, numPages);
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages + 1);
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+    TEST_F(RBFM_FSM_Test, full_file_reuses_deleted_space) {
+        // Functions tested
+        // 1. Inserts into a file whose pages are all full go to the pages deletes made room in
+        // 2. The file grows only once that room is used up
+
+        ASSERT_NO_FATAL_FAILURE(fillFile());
+        std::set<unsigned> freed;
+        for (unsigned i = 1; i < 2 * numPages; i += 3) {
+            ASSERT_NO_FATAL_FAILURE(deleteRecord(i));
+            freed.insert(rids[i].pageNum);
+        }
+        ASSERT_NO_FATAL_FAILURE(reopen());
+
+        unsigned deletes = (2 * numPages + 1) / 3;
+        for (unsigned i = 0; i < deletes; i++) {
+            PeterDB::RID rid;
+            ASSERT_NO_FATAL_FAILURE(insertName(nameOf(100 + i), rid));
+            EXPECT_TRUE(freed.count(rid.pageNum)) << "Record " << i << " should reuse freed room.";
+        }
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages) << "The file should not grow while room is left.";
+        PeterDB::RID rid;
+        ASSERT_NO_FATAL_FAILURE(insertName(nameOf(200), rid));
+        EXPECT_EQ(fileHandle.getNumberOfPages(), numPages + 1) << "A full file should grow.";
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+} // namespace PeterDBTesting
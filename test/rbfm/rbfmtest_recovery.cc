@@ -0,0 +1,216 @@
+#include <fstream>
+
+#include "src/include/rbfm.h"
+#include "src/include/bpm.h"
+#include "src/include/wal.h"
+#include "src/include/recovery.h"
+#include "test/utils/rbfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class RBFM_Recovery_Test : public RBFM_Employee_Test {
+    public:
+        void SetUp() override {
+            remove(logFileName.c_str());
+            RBFM_Employee_Test::SetUp();
+            // Nothing is written back but what the changes themselves write through, so the pages on disk
+            // miss most of them.
+            pfm.bufferPool().setFlushInterval(0);
+            log.setCheckpointInterval(0);
+            ASSERT_EQ(recovery.restart(logFileName), success) << "Opening the log should not fail.";
+        }
+
+        void TearDown() override {
+            ASSERT_EQ(log.close(), success) << "Closing the log should not fail.";
+            pfm.bufferPool().setFlushInterval(BPM_FLUSH_INTERVAL_MS);
+            log.setCheckpointInterval(WAL_CHECKPOINT_INTERVAL);
+            RBFM_Employee_Test::TearDown();
+            remove(logFileName.c_str());
+        }
+
+    protected:
+        std::string logFileName = "rbfm_test_log";
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        PeterDB::LogManager &log = PeterDB::LogManager::instance();
+        PeterDB::RecoveryManager &recovery = PeterDB::RecoveryManager::instance();
+
+        std::vector<PeterDB::RID> rids;
+        std::vector<std::string> names;                 // the committed name of every RID
+        std::vector<bool> deleted;
+        std::vector<bool> reused;                       // deleted, and the slot taken by a later insert
+
+        static std::string nameOf(unsigned i) {
+            return "employee" + std::to_string(i);
+        }
+
+        void insertRecords(unsigned count) {
+            for (unsigned i = 0; i < count; i++) {
+                PeterDB::RID rid;
+                std::string name = nameOf((unsigned) rids.size());
+                ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, name));
+                for (unsigned j = 0; j < rids.size(); j++) {
+                    if (deleted[j] && rids[j].pageNum == rid.pageNum && rids[j].slotNum == rid.slotNum) {
+                        reused[j] = true;
+                    }
+                }
+                rids.push_back(rid);
+                names.push_back(name);
+                deleted.push_back(false);
+                reused.push_back(false);
+            }
+        }
+
+        // Shrink some records in place, move others away with long names, and delete a few.
+        void changeRecords(unsigned first) {
+            for (unsigned i = first; i < rids.size(); i += 5) {
+                names[i] = i % 2 == 0 ? std::string(1, 'a' + i % 26) : std::string(1500, 'a' + i % 26);
+                ASSERT_NO_FATAL_FAILURE(updateRecord(recordDescriptor, rids[i], names[i]));
+            }
+            for (unsigned i = first + 3; i < rids.size(); i += 9) {
+                ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                            << "Deleting a record should not fail.";
+                deleted[i] = true;
+            }
+        }
+
+        static void copyFile(const std::string &from, const std::string &to) {
+            std::ifstream in(from, std::ios::binary);
+            std::ofstream out(to, std::ios::binary | std::ios::trunc);
+            ASSERT_TRUE(in.is_open() && out.is_open()) << "Copying " << from << " should not fail.";
+            out << in.rdbuf();
+        }
+
+        // Every change so far was committed synchronously, so the log already holds it. The data file and the
+        // log are taken as they are on disk now, without the dirty frames of the buffer pool, then put back
+        // once the process has shut down as if it had crashed there.
+        void crash() {
+            ASSERT_NO_FATAL_FAILURE(copyFile(fileName, fileName + ".crash"));
+            ASSERT_NO_FATAL_FAILURE(copyFile(logFileName, logFileName + ".crash"));
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+            ASSERT_EQ(log.close(), success);
+            ASSERT_EQ(rbfm.destroyFile(fileName), success);
+            ASSERT_EQ(rename((fileName + ".crash").c_str(), fileName.c_str()), 0);
+            ASSERT_EQ(rename((logFileName + ".crash").c_str(), logFileName.c_str()), 0);
+        }
+
+        void checkRecords() {
+            for (unsigned i = 0; i < rids.size(); i++) {
+                if (reused[i]) continue;
+                if (deleted[i]) {
+                    EXPECT_NE(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Record " << i << " was deleted.";
+                } else {
+                    ASSERT_NO_FATAL_FAILURE(readRecord(recordDescriptor, rids[i], names[i]))
+                                        << "Record " << i << " should be recovered.";
+                }
+            }
+        }
+    };
+
+    TEST_F(RBFM_Recovery_Test, restart_redoes_committed_changes) {
+        // Functions tested
+        // 1. Logged inserts, updates, moves and deletes missing from the data file are redone by restart
+        // 2. Every committed record reads back afterwards
+        // 3. A second restart redoes nothing
+
+        ASSERT_NO_FATAL_FAILURE(insertRecords(600));
+        ASSERT_NO_FATAL_FAILURE(changeRecords(0));
+        ASSERT_NO_FATAL_FAILURE(crash());
+
+        ASSERT_EQ(recovery.restart(logFileName), success) << "Restarting should not fail.";
+        unsigned records, redone, skipped, pages;
+        ASSERT_EQ(recovery.collectCounterValues(records, redone, skipped, pages), success);
+        EXPECT_GT(redone, 0) << "The changes missing from the data file should be redone.";
+        EXPECT_EQ(redone + skipped, records);
+        EXPECT_GT(pages, 0);
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+
+        // The first restart ended with a checkpoint after its redone pages were synced.
+        ASSERT_EQ(log.close(), success);
+        ASSERT_EQ(recovery.restart(logFileName), success) << "Restarting again should not fail.";
+        ASSERT_EQ(recovery.collectCounterValues(records, redone, skipped, pages), success);
+        EXPECT_EQ(records, 0) << "Nothing should be left to replay.";
+        EXPECT_EQ(redone, 0) << "A second restart should redo nothing.";
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+    TEST_F(RBFM_Recovery_Test, restart_starts_at_the_checkpoint_redo_lsn) {
+        // Functions tested
+        // 1. A checkpoint whose redo LSN is earlier than the checkpoint record itself
+        // 2. Restart replays the log from that redo LSN on, not from the start of the log
+        // 3. Changes before the redo LSN, already on disk, and after it, only in the log, all read back
+
+        ASSERT_NO_FATAL_FAILURE(insertRecords(300));
+        ASSERT_NO_FATAL_FAILURE(changeRecords(0));
+        ASSERT_EQ(fileHandle.flush(), success) << "Writing back the pages should not fail.";
+        PeterDB::LSN redoLsn = log.getEndLsn();
+        unsigned recordsAtRedo, commits, syncs;
+        ASSERT_EQ(log.collectCounterValues(recordsAtRedo, commits, syncs), success);
+
+        // These changes precede the checkpoint but are not on disk, so redo has to start before it.
+        ASSERT_NO_FATAL_FAILURE(insertRecords(200));
+        ASSERT_NO_FATAL_FAILURE(changeRecords(300));
+        ASSERT_EQ(log.checkpoint(redoLsn), success) << "Taking a checkpoint should not fail.";
+        unsigned checkpoints;
+        PeterDB::LSN checkpointLsn, checkpointRedoLsn;
+        ASSERT_EQ(log.collectCheckpointCounterValues(checkpoints, checkpointLsn, checkpointRedoLsn), success);
+        EXPECT_EQ(checkpointRedoLsn, redoLsn);
+        EXPECT_GT(checkpointLsn, redoLsn);
+        ASSERT_NO_FATAL_FAILURE(insertRecords(100));
+        unsigned recordsAtCrash;
+        ASSERT_EQ(log.collectCounterValues(recordsAtCrash, commits, syncs), success);
+        ASSERT_NO_FATAL_FAILURE(crash());
+
+        ASSERT_EQ(recovery.restart(logFileName), success) << "Restarting should not fail.";
+        unsigned records, redone, skipped, pages;
+        ASSERT_EQ(recovery.collectCounterValues(records, redone, skipped, pages), success);
+        // Every record appended since the redo LSN is a page change, but for the checkpoint.
+        EXPECT_EQ(records, recordsAtCrash - recordsAtRedo - 1) << "Redo should start at the checkpoint's redo LSN.";
+        EXPECT_GT(redone, 0);
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+    }
+
+    TEST_F(RBFM_Recovery_Test, restart_skips_the_records_of_a_destroyed_file) {
+        // Functions tested
+        // 1. destroyFile of a logged file, then createFile of the same name and one insert into it
+        // 2. Restart redoes the insert, but none of the changes to the destroyed file
+        // 3. A scan of the new file returns the one record
+
+        ASSERT_NO_FATAL_FAILURE(insertRecords(400));
+        ASSERT_GT(fileHandle.getNumberOfPages(), 1);
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_EQ(rbfm.destroyFile(fileName), success) << "Destroying the file should not fail.";
+        ASSERT_EQ(rbfm.createFile(fileName), success) << "Creating the file again should not fail.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        rids.clear();
+        names.clear();
+        deleted.clear();
+        reused.clear();
+        ASSERT_NO_FATAL_FAILURE(insertRecords(1));
+        ASSERT_NO_FATAL_FAILURE(crash());
+
+        ASSERT_EQ(recovery.restart(logFileName), success) << "Restarting should not fail.";
+        unsigned records, redone, skipped, pages;
+        ASSERT_EQ(recovery.collectCounterValues(records, redone, skipped, pages), success);
+        EXPECT_EQ(pages, 1) << "Only the page of the new file should be changed.";
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        EXPECT_EQ(fileHandle.getNumberOfPages(), 1) << "The pages of the destroyed file should not come back.";
+        ASSERT_NO_FATAL_FAILURE(checkRecords());
+        PeterDB::RBFM_ScanIterator iterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"EmpName"}, iterator), success);
+        PeterDB::RID rid;
+        unsigned count = 0;
+        while (iterator.getNextRecord(rid, outBuffer) != RBFM_EOF) count++;
+        iterator.close();
+        EXPECT_EQ(count, 1) << "Only the record inserted after the file was created again should be found.";
+    }
+
+} // namespace PeterDBTesting
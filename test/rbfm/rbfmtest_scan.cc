@@ -0,0 +1,350 @@
+#include <set>
+
+#include "src/include/rbfm.h"
+#include "test/utils/rbfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class RBFM_Scan_Test : public RBFM_Employee_Test {
+    protected:
+        std::vector<PeterDB::RID> insertedRids;
+        const unsigned numRecords = 2000;
+
+        // Employee i: name "emp" + i, age i % 100 (NULL every 7th), height i / 2, salary 1000 + i.
+        static std::string nameOf(unsigned i) {
+            return "emp" + std::to_string(i);
+        }
+
+        static bool ageIsNull(unsigned i) {
+            return i % 7 == 0;
+        }
+
+        void prepareEmployee(unsigned i, const std::string &name, size_t &recordSize) {
+            nullsIndicator[0] = ageIsNull(i) ? 0x40 : 0;
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) (i % 100),
+                          (float) i / 2, (int) (1000 + i), inBuffer, recordSize);
+        }
+
+        void insertEmployees() {
+            for (unsigned i = 0; i < numRecords; i++) {
+                size_t recordSize;
+                PeterDB::RID rid;
+                prepareEmployee(i, nameOf(i), recordSize);
+                ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                            << "Inserting a record should succeed.";
+                insertedRids.push_back(rid);
+            }
+        }
+
+        // Scan with one condition and return the salaries of the records found, which identify them, and the
+        // number of pages the scan did not read.
+        std::set<int> scanSalaries(const std::string &attribute, PeterDB::CompOp compOp, const void *value,
+                                   unsigned *skippedPages = nullptr) {
+            std::set<int> salaries;
+            PeterDB::RBFM_ScanIterator iterator;
+            EXPECT_EQ(rbfm.scan(fileHandle, recordDescriptor, attribute, compOp, value, {"Salary"}, iterator),
+                      success) << "Starting a scan should succeed.";
+            PeterDB::RID rid;
+            while (iterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+                EXPECT_EQ(*(unsigned char *) outBuffer, 0) << "The projected salary should not be NULL.";
+                int salary;
+                memcpy(&salary, (char *) outBuffer + 1, sizeof(int));
+                EXPECT_TRUE(salaries.insert(salary).second) << "A record should be returned once: " << salary;
+            }
+            if (skippedPages != nullptr) *skippedPages = iterator.getSkippedPages();
+            EXPECT_EQ(iterator.close(), success) << "Closing the scan should succeed.";
+            return salaries;
+        }
+
+        template<typename Predicate>
+        std::set<int> expectedSalaries(Predicate predicate) {
+            std::set<int> salaries;
+            for (unsigned i = 0; i < numRecords; i++) {
+                if (predicate(i)) salaries.insert((int) (1000 + i));
+            }
+            return salaries;
+        }
+    };
+
+    TEST_F(RBFM_Scan_Test, scan_with_a_condition_on_each_type) {
+        // Functions tested
+        // 1. Scan with every operator on an Int, a Real and a VarChar attribute
+        // 2. NULL fields never qualify
+        // 3. Projection to a single attribute
+
+        ASSERT_NO_FATAL_FAILURE(insertEmployees());
+
+        int age = 42;
+        EXPECT_EQ(scanSalaries("Age", PeterDB::EQ_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 == 42; }));
+        EXPECT_EQ(scanSalaries("Age", PeterDB::LT_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 < 42; }));
+        EXPECT_EQ(scanSalaries("Age", PeterDB::LE_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 <= 42; }));
+        EXPECT_EQ(scanSalaries("Age", PeterDB::GT_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 > 42; }));
+        EXPECT_EQ(scanSalaries("Age", PeterDB::GE_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 >= 42; }));
+        EXPECT_EQ(scanSalaries("Age", PeterDB::NE_OP, &age),
+                  expectedSalaries([](unsigned i) { return !ageIsNull(i) && i % 100 != 42; }));
+
+        float height = 321.5;
+        EXPECT_EQ(scanSalaries("Height", PeterDB::GE_OP, &height),
+                  expectedSalaries([](unsigned i) { return (float) i / 2 >= 321.5; }));
+        EXPECT_EQ(scanSalaries("Height", PeterDB::EQ_OP, &height),
+                  expectedSalaries([](unsigned i) { return i == 643; }));
+
+        std::string name = "emp15";
+        std::vector<char> value(sizeof(unsigned) + name.length());
+        unsigned length = name.length();
+        memcpy(value.data(), &length, sizeof(unsigned));
+        memcpy(value.data() + sizeof(unsigned), name.data(), length);
+        EXPECT_EQ(scanSalaries("EmpName", PeterDB::EQ_OP, value.data()),
+                  expectedSalaries([](unsigned i) { return i == 15; }));
+        EXPECT_EQ(scanSalaries("EmpName", PeterDB::LT_OP, value.data()),
+                  expectedSalaries([&name](unsigned i) { return nameOf(i) < name; }));
+        EXPECT_EQ(scanSalaries("EmpName", PeterDB::GE_OP, value.data()),
+                  expectedSalaries([&name](unsigned i) { return nameOf(i) >= name; }));
+
+        EXPECT_EQ(scanSalaries("", PeterDB::NO_OP, nullptr).size(), numRecords);
+
+        PeterDB::RBFM_ScanIterator iterator;
+        EXPECT_NE(rbfm.scan(fileHandle, recordDescriptor, "Weight", PeterDB::EQ_OP, &age, {"Salary"}, iterator),
+                  success) << "A scan on an unknown attribute should fail.";
+        EXPECT_NE(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::EQ_OP, &age, {"Weight"}, iterator),
+                  success) << "A scan projecting an unknown attribute should fail.";
+    }
+
+    TEST_F(RBFM_Scan_Test, scan_with_conjunctive_conditions) {
+        // Functions tested
+        // 1. Scan with several conditions, all of which must hold
+        // 2. Conditions listed least selective first, which the scan reorders as it goes
+        // 3. Conditions that no record satisfies together
+
+        ASSERT_NO_FATAL_FAILURE(insertEmployees());
+
+        int minAge = 30, maxSalary = 2500;
+        float minHeight = 100;
+        std::vector<PeterDB::AttributeCondition> conditions = {
+                {"Height", PeterDB::GE_OP, &minHeight},
+                {"Age",    PeterDB::GT_OP, &minAge},
+                {"Salary", PeterDB::LT_OP, &maxSalary}};
+        std::set<int> expected = expectedSalaries([](unsigned i) {
+            return (float) i / 2 >= 100 && !ageIsNull(i) && i % 100 > 30 && 1000 + i < 2500;
+        });
+
+        PeterDB::RBFM_ScanIterator iterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, conditions, {"Salary", "Age"}, iterator), success)
+                                    << "Starting a scan should succeed.";
+        PeterDB::RID rid;
+        std::set<int> salaries;
+        while (iterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            ASSERT_EQ(*(unsigned char *) outBuffer, 0) << "Neither projected field should be NULL.";
+            int salary, age;
+            memcpy(&salary, (char *) outBuffer + 1, sizeof(int));
+            memcpy(&age, (char *) outBuffer + 1 + sizeof(int), sizeof(int));
+            EXPECT_EQ((unsigned) age, (unsigned) (salary - 1000) % 100) << "The fields should be of one record.";
+            EXPECT_TRUE(salaries.insert(salary).second) << "A record should be returned once: " << salary;
+        }
+        ASSERT_EQ(iterator.close(), success) << "Closing the scan should succeed.";
+        EXPECT_EQ(salaries, expected);
+
+        int highSalary = 2800;
+        conditions.push_back({"Salary", PeterDB::GT_OP, &highSalary});
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, conditions, {"Salary"}, iterator), success)
+                                    << "Starting a scan should succeed.";
+        EXPECT_EQ(iterator.getNextRecord(rid, outBuffer), RBFM_EOF) << "No record should satisfy every condition.";
+        ASSERT_EQ(iterator.close(), success) << "Closing the scan should succeed.";
+
+        conditions.push_back({"Bonus", PeterDB::GT_OP, &highSalary});
+        EXPECT_NE(rbfm.scan(fileHandle, recordDescriptor, conditions, {"Salary"}, iterator), success)
+                                    << "A scan with a condition on an unknown attribute should fail.";
+    }
+
+    TEST_F(RBFM_Scan_Test, scan_in_column_batches) {
+        // Functions tested
+        // 1. getNextBatch returns the rows getNextRecord does, in the same order, in columns
+        // 2. NULLs in the null bitmaps of Int, Real and VarChar columns
+        // 3. Batches smaller than the result
+        // 4. A batch of capacity 0 is filled as one of the default capacity
+
+        ASSERT_NO_FATAL_FAILURE(insertEmployees());
+        int minAge = 20;
+        std::vector<PeterDB::AttributeCondition> conditions = {{"Age", PeterDB::GE_OP, &minAge}};
+        std::vector<std::string> attributes = {"Age", "EmpName", "Height"};
+        // Make some names NULL, and move one record by making its name long.
+        for (unsigned i = 3; i < numRecords; i += 50) {
+            size_t recordSize;
+            nullsIndicator[0] = 0x80;
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, 0, "", (int) (i % 100), (float) i / 2,
+                          (int) (1000 + i), inBuffer, recordSize);
+            ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, insertedRids[i]), success)
+                                        << "Updating a record should succeed.";
+        }
+        size_t recordSize;
+        prepareEmployee(21, std::string(2000, 'y'), recordSize);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, insertedRids[21]), success)
+                                    << "Updating a record should succeed.";
+
+        PeterDB::RBFM_ScanIterator rows, batches, defaults;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, conditions, attributes, defaults), success);
+        PeterDB::RecordBatch batch;
+        batch.capacity = 0;
+        EXPECT_EQ(defaults.getNextBatch(batch), success) << "A batch of capacity 0 should not end the scan.";
+        EXPECT_EQ(batch.capacity, RBFM_SCAN_BATCH_ROWS);
+        EXPECT_EQ(batch.rows, RBFM_SCAN_BATCH_ROWS);
+        ASSERT_EQ(defaults.close(), success);
+
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, conditions, attributes, rows), success);
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, conditions, attributes, batches), success);
+        batch.capacity = 100;
+        unsigned total = 0;
+        while (batches.getNextBatch(batch) != RBFM_EOF) {
+            ASSERT_LE(batch.rows, batch.capacity) << "A batch should not exceed its capacity.";
+            ASSERT_EQ(batch.rids.size(), batch.rows);
+            ASSERT_EQ(batch.columns.size(), attributes.size());
+            const PeterDB::ColumnVector &ages = batch.columns[0], &names = batch.columns[1],
+                    &heights = batch.columns[2];
+            ASSERT_EQ(ages.ints.size(), batch.rows);
+            ASSERT_EQ(names.offsets.size(), batch.rows + 1);
+            ASSERT_EQ(heights.reals.size(), batch.rows);
+
+            for (unsigned r = 0; r < batch.rows; r++) {
+                PeterDB::RID rid;
+                ASSERT_EQ(rows.getNextRecord(rid, outBuffer), success) << "Both scans should find the same rows.";
+                EXPECT_EQ(batch.rids[r].pageNum, rid.pageNum);
+                EXPECT_EQ(batch.rids[r].slotNum, rid.slotNum);
+
+                const char *out = (const char *) outBuffer;
+                bool nameIsNull = out[0] & 0x40;
+                int age;
+                memcpy(&age, out + 1, sizeof(int));
+                EXPECT_EQ(ages.ints[r], age);
+                EXPECT_FALSE(ages.nulls[r / 8] & (0x80 >> (r % 8))) << "No age found should be NULL.";
+                EXPECT_EQ((bool) (names.nulls[r / 8] & (0x80 >> (r % 8))), nameIsNull);
+                std::string name;
+                unsigned offset = 1 + sizeof(int);
+                if (!nameIsNull) {
+                    unsigned length;
+                    memcpy(&length, out + offset, sizeof(unsigned));
+                    name.assign(out + offset + sizeof(unsigned), length);
+                    offset += sizeof(unsigned) + length;
+                }
+                EXPECT_EQ(std::string(names.bytes.data() + names.offsets[r], names.offsets[r + 1] - names.offsets[r]),
+                          name);
+                float height;
+                memcpy(&height, out + offset, sizeof(float));
+                EXPECT_EQ(heights.reals[r], height);
+                total++;
+            }
+        }
+        PeterDB::RID rid;
+        EXPECT_EQ(rows.getNextRecord(rid, outBuffer), RBFM_EOF) << "Both scans should find the same rows.";
+        // The records given a NULL name were given an age too.
+        EXPECT_EQ(total, expectedSalaries([](unsigned i) {
+            return (!ageIsNull(i) || i % 50 == 3) && i % 100 >= 20;
+        }).size());
+        ASSERT_EQ(rows.close(), success);
+        ASSERT_EQ(batches.close(), success);
+    }
+
+    TEST_F(RBFM_Scan_Test, scan_skips_pages_through_zone_maps) {
+        // Functions tested
+        // 1. A scan does not read the pages whose salaries, which grow along the file, all fail its condition
+        // 2. An update widens the zone of its page
+        // 3. After deletes, the first scan tightens the zones it reads and the next one skips more
+        // 4. The zones outlive closing the file
+
+        ASSERT_NO_FATAL_FAILURE(insertEmployees());
+        unsigned numPages = fileHandle.getNumberOfPages();
+        std::set<unsigned> firstPages;
+        for (unsigned i = 0; i < 100; i++) {
+            firstPages.insert(insertedRids[i].pageNum);
+        }
+        ASSERT_GT(numPages, firstPages.size() + 5) << "The records should fill many pages.";
+
+        unsigned skipped;
+        int salary = 1100;
+        EXPECT_EQ(scanSalaries("Salary", PeterDB::LT_OP, &salary, &skipped),
+                  expectedSalaries([](unsigned i) { return i < 100; }));
+        EXPECT_EQ(skipped, numPages - firstPages.size()) << "Only the pages of the first records should be read.";
+        float height = 20000;
+        EXPECT_TRUE(scanSalaries("Height", PeterDB::GT_OP, &height, &skipped).empty());
+        EXPECT_EQ(skipped, numPages) << "No page has a height that large.";
+        EXPECT_EQ(scanSalaries("EmpName", PeterDB::NO_OP, nullptr, &skipped).size(), numRecords);
+        EXPECT_EQ(skipped, 0) << "A scan without conditions should read every page.";
+
+        // Record 1500 gets a salary below 1100, its page's zone has to include it.
+        size_t recordSize;
+        nullsIndicator[0] = 0;
+        prepareRecord((int) recordDescriptor.size(), nullsIndicator, 7, nameOf(1500), 0, 750, 500, inBuffer,
+                      recordSize);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, insertedRids[1500]), success)
+                                    << "Updating a record should succeed.";
+        std::set<int> expected = expectedSalaries([](unsigned i) { return i < 100; });
+        expected.insert(500);
+        EXPECT_EQ(scanSalaries("Salary", PeterDB::LT_OP, &salary), expected);
+
+        for (unsigned i = 0; i < 100; i++) {
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, insertedRids[i]), success)
+                                        << "Deleting a record should succeed.";
+        }
+        EXPECT_EQ(scanSalaries("Salary", PeterDB::LT_OP, &salary), std::set<int>{500});
+        EXPECT_EQ(scanSalaries("Salary", PeterDB::LT_OP, &salary, &skipped), std::set<int>{500});
+        EXPECT_EQ(skipped, numPages - 1) << "Only the page of the updated record should be read.";
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+        EXPECT_EQ(scanSalaries("Salary", PeterDB::LT_OP, &salary, &skipped), std::set<int>{500});
+        EXPECT_EQ(skipped, numPages - 1) << "The zones should be kept when the file is closed.";
+    }
+
+    TEST_F(RBFM_Scan_Test, scan_returns_moved_records_under_their_rid) {
+        // Functions tested
+        // 1. Update records so they no longer fit their page and move
+        // 2. Delete records
+        // 3. Scan returns every remaining record once, under its original RID, in the projected order
+
+        ASSERT_NO_FATAL_FAILURE(insertEmployees());
+        std::string longName(1500, 'x');
+        std::set<unsigned> moved, deleted;
+        for (unsigned i = 0; i < numRecords; i += 97) {
+            size_t recordSize;
+            prepareEmployee(i, longName, recordSize);
+            ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, insertedRids[i]), success)
+                                        << "Updating a record should succeed.";
+            moved.insert(i);
+        }
+        for (unsigned i = 5; i < numRecords; i += 11) {
+            if (moved.count(i) > 0) continue;
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, insertedRids[i]), success)
+                                        << "Deleting a record should succeed.";
+            deleted.insert(i);
+        }
+
+        PeterDB::RBFM_ScanIterator iterator;
+        int salary = 1000;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Salary", PeterDB::GE_OP, &salary, {"Salary", "EmpName"},
+                            iterator), success) << "Starting a scan should succeed.";
+        PeterDB::RID rid;
+        unsigned found = 0;
+        while (iterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            int value;
+            memcpy(&value, (char *) outBuffer + 1, sizeof(int));
+            unsigned i = value - 1000;
+            ASSERT_LT(i, numRecords) << "The salary should be one that was inserted.";
+            ASSERT_EQ(deleted.count(i), 0) << "A deleted record should not be returned.";
+            EXPECT_EQ(rid.pageNum, insertedRids[i].pageNum) << "A record should keep its RID.";
+            EXPECT_EQ(rid.slotNum, insertedRids[i].slotNum) << "A record should keep its RID.";
+
+            unsigned length;
+            memcpy(&length, (char *) outBuffer + 1 + sizeof(int), sizeof(unsigned));
+            std::string name((char *) outBuffer + 1 + sizeof(int) + sizeof(unsigned), length);
+            EXPECT_EQ(name, moved.count(i) > 0 ? longName : nameOf(i)) << "The projected name should be current.";
+            found++;
+        }
+        ASSERT_EQ(iterator.close(), success) << "Closing the scan should succeed.";
+        EXPECT_EQ(found, numRecords - deleted.size()) << "Every remaining record should be returned once.";
+    }
+
+} // namespace PeterDBTesting
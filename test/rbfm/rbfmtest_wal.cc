@@ -0,0 +1,249 @@
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "src/include/rbfm.h"
+#include "src/include/bpm.h"
+#include "src/include/wal.h"
+#include "test/utils/rbfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    class RBFM_WAL_Test : public RBFM_Employee_Test {
+    public:
+        void SetUp() override {
+            remove(logFileName.c_str());
+            RBFM_Employee_Test::SetUp();
+        }
+
+        void TearDown() override {
+            ASSERT_EQ(log.close(), success) << "Closing the log should not fail.";
+            pfm.bufferPool().setFlushInterval(BPM_FLUSH_INTERVAL_MS);
+            RBFM_Employee_Test::TearDown();
+            remove(logFileName.c_str());
+        }
+
+    protected:
+        std::string logFileName = "rbfm_test_log";
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        PeterDB::LogManager &log = PeterDB::LogManager::instance();
+
+        // Log count records about pages of a file that need not exist and make them durable.
+        void appendRecords(unsigned count, std::vector<PeterDB::LSN> &lsns) {
+            for (unsigned i = 0; i < count; i++) {
+                PeterDB::LSN lsn;
+                std::string payload(10 + i, (char) ('a' + i % 26));
+                ASSERT_EQ(log.append(PeterDB::WAL_RECORD_INSERT, "wal_test_data", i, (unsigned short) i,
+                                     payload.data(), (unsigned) payload.size(), lsn), success)
+                                            << "Appending a log record should not fail.";
+                lsns.push_back(lsn);
+            }
+            ASSERT_EQ(log.sync(), success) << "Forcing the log should not fail.";
+        }
+
+        // Records of the log from its first one on, and where the valid ones stop.
+        static unsigned countRecords(const std::string &logFileName, PeterDB::LSN &end) {
+            PeterDB::LogReader reader;
+            EXPECT_EQ(reader.open(logFileName), success) << "Opening the log should not fail.";
+            EXPECT_EQ(reader.load(WAL_HEADER_SIZE), success) << "Loading the log should not fail.";
+            unsigned count = 0;
+            PeterDB::LogRecordHeader header{};
+            while (reader.next(header) != nullptr) count++;
+            end = reader.getEndLsn();
+            return count;
+        }
+
+        static void writeAt(const std::string &fileName, off_t offset, const void *data, size_t length) {
+            int fd = open(fileName.c_str(), O_WRONLY);
+            ASSERT_GE(fd, 0) << "Opening the log for writing should not fail.";
+            ASSERT_EQ(pwrite(fd, data, length, offset), (ssize_t) length) << "Writing into the log should not fail.";
+            close(fd);
+        }
+    };
+
+    TEST_F(RBFM_WAL_Test, torn_and_corrupt_tails_are_cut_off) {
+        // Functions tested
+        // 1. LogReader stops at a torn record and at one failing its checksum
+        // 2. LogManager::open truncates the log there and appends after the last valid record
+
+        ASSERT_EQ(log.open(logFileName), success) << "Opening the log should not fail.";
+        std::vector<PeterDB::LSN> lsns;
+        ASSERT_NO_FATAL_FAILURE(appendRecords(8, lsns));
+        PeterDB::LSN end = log.getEndLsn();
+        ASSERT_EQ(log.close(), success);
+
+        // Each file name is logged once, ahead of the first record about it.
+        PeterDB::LSN validEnd;
+        ASSERT_EQ(countRecords(logFileName, validEnd), 9);
+        EXPECT_EQ(validEnd, end);
+
+        // A torn record: a header promising more bytes than were written.
+        PeterDB::LogRecordHeader torn{1000, 0, end, PeterDB::WAL_RECORD_DELETE, 0, 0, 0, 0};
+        ASSERT_NO_FATAL_FAILURE(writeAt(logFileName, (off_t) end, &torn, sizeof(torn)));
+        ASSERT_EQ(countRecords(logFileName, validEnd), 9) << "A torn record should not be read.";
+        EXPECT_EQ(validEnd, end);
+
+        ASSERT_EQ(log.open(logFileName), success) << "Reopening the log should not fail.";
+        EXPECT_EQ(getFileSize(logFileName), (std::streamoff) end) << "The torn record should be cut off.";
+        EXPECT_EQ(log.getEndLsn(), end) << "New records should follow the last valid one.";
+        lsns.clear();
+        ASSERT_NO_FATAL_FAILURE(appendRecords(2, lsns));
+        EXPECT_EQ(lsns[0], end);
+        end = log.getEndLsn();
+        ASSERT_EQ(log.close(), success);
+        ASSERT_EQ(countRecords(logFileName, validEnd), 11);
+        EXPECT_EQ(validEnd, end);
+
+        // A flipped payload byte in the last record.
+        char flipped = 0x7f;
+        ASSERT_NO_FATAL_FAILURE(writeAt(logFileName, (off_t) (end - 1), &flipped, 1));
+        ASSERT_EQ(countRecords(logFileName, validEnd), 10) << "A record failing its checksum should not be read.";
+        EXPECT_EQ(validEnd, lsns[1]);
+
+        ASSERT_EQ(log.open(logFileName), success) << "Reopening the log should not fail.";
+        EXPECT_EQ(getFileSize(logFileName), (std::streamoff) lsns[1]) << "The corrupt record should be cut off.";
+        EXPECT_EQ(log.getEndLsn(), lsns[1]);
+    }
+
+    TEST_F(RBFM_WAL_Test, pages_are_written_after_their_log_records) {
+        // Functions tested
+        // 1. Inserts, updates and deletes with asynchronous commits stamp their pages with LSNs
+        // 2. A flushed page is never ahead of the durable log
+
+        pfm.bufferPool().setFlushInterval(0);
+        ASSERT_EQ(log.open(logFileName, false), success) << "Opening the log should not fail.";
+        std::vector<PeterDB::RID> rids;
+        for (unsigned i = 0; i < 500; i++) {
+            PeterDB::RID rid;
+            ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, "employee" + std::to_string(i)));
+            rids.push_back(rid);
+        }
+        for (unsigned i = 0; i < rids.size(); i += 7) {
+            ASSERT_NO_FATAL_FAILURE(updateRecord(recordDescriptor, rids[i], std::string(100, 'u')));
+        }
+        for (unsigned i = 3; i < rids.size(); i += 11) {
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                        << "Deleting a record should not fail.";
+        }
+        ASSERT_EQ(pfm.bufferPool().flushAll(), success) << "Flushing the buffer pool should not fail.";
+
+        // A record is durable when it starts before the durable LSN, and a page LSN is where its last record
+        // starts.
+        PeterDB::LSN durableLsn = log.getDurableLsn();
+        unsigned numPages = fileHandle.getNumberOfPages();
+        ASSERT_GT(numPages, 1);
+        int fd = open(fileName.c_str(), O_RDONLY);
+        ASSERT_GE(fd, 0);
+        std::vector<char> page(PAGE_SIZE);
+        for (unsigned pageNum = 0; pageNum < numPages; pageNum++) {
+            ASSERT_EQ(pread(fd, page.data(), PAGE_SIZE, PeterDB::BufferPoolManager::pageOffset(pageNum, PAGE_SIZE)),
+                      PAGE_SIZE);
+            PeterDB::LSN pageLsn = rbfm.getPageLsn(page.data(), PAGE_SIZE);
+            EXPECT_NE(pageLsn, 0) << "Page " << pageNum << " should carry the LSN of its last change.";
+            EXPECT_LT(pageLsn, durableLsn) << "Page " << pageNum << " was written ahead of its log record.";
+        }
+        close(fd);
+    }
+
+    TEST_F(RBFM_WAL_Test, commits_are_grouped) {
+        // Functions tested
+        // 1. Synchronous commits return only once their record is durable
+        // 2. Concurrent commits share fsyncs
+        // 3. Asynchronous commits do not wait, and become durable on their own
+
+        ASSERT_EQ(log.open(logFileName), success) << "Opening the log should not fail.";
+        const unsigned numThreads = 8, commitsPerThread = 100;
+        unsigned records, commits, syncs;
+        ASSERT_EQ(log.collectCounterValues(records, commits, syncs), success);
+        unsigned commitsBefore = commits, syncsBefore = syncs;
+
+        std::vector<std::thread> threads;
+        std::vector<unsigned> failures(numThreads, 0);
+        for (unsigned t = 0; t < numThreads; t++) {
+            threads.emplace_back([this, t, &failures] {
+                for (unsigned i = 0; i < commitsPerThread; i++) {
+                    PeterDB::LSN lsn;
+                    int value = (int) (t * commitsPerThread + i);
+                    if (log.append(PeterDB::WAL_RECORD_INSERT, "wal_test_data", t, (unsigned short) i, &value,
+                                   sizeof(value), lsn) != 0 || log.commit(lsn) != 0 || log.getDurableLsn() <= lsn) {
+                        failures[t]++;
+                    }
+                }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+        for (unsigned t = 0; t < numThreads; t++) {
+            EXPECT_EQ(failures[t], 0) << "Every commit should return with its record durable.";
+        }
+        ASSERT_EQ(log.collectCounterValues(records, commits, syncs), success);
+        EXPECT_EQ(commits - commitsBefore, numThreads * commitsPerThread);
+        EXPECT_LT(syncs - syncsBefore, commits - commitsBefore) << "Concurrent commits should share fsyncs.";
+
+        // Synchronous inserts commit one by one.
+        PeterDB::RID rid;
+        ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, "sync"));
+        unsigned syncCommits;
+        ASSERT_EQ(log.collectCounterValues(records, syncCommits, syncs), success);
+        EXPECT_EQ(syncCommits, commits + 1) << "A synchronous insert should commit.";
+        ASSERT_EQ(log.close(), success);
+
+        // Asynchronous inserts return without a commit; the log writer makes them durable within its interval.
+        ASSERT_EQ(log.open(logFileName, false), success) << "Reopening the log should not fail.";
+        ASSERT_EQ(log.collectCounterValues(records, commits, syncs), success);
+        for (unsigned i = 0; i < 20; i++) {
+            ASSERT_NO_FATAL_FAILURE(insertRecord(recordDescriptor, rid, "async" + std::to_string(i)));
+        }
+        unsigned asyncCommits;
+        ASSERT_EQ(log.collectCounterValues(records, asyncCommits, syncs), success);
+        EXPECT_EQ(asyncCommits, commits) << "Asynchronous inserts should not commit.";
+        PeterDB::LSN end = log.getEndLsn();
+        for (unsigned wait = 0; wait < 100 && log.getDurableLsn() < end; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAL_FLUSH_INTERVAL_MS));
+        }
+        EXPECT_EQ(log.getDurableLsn(), end) << "Asynchronous commits should become durable on their own.";
+    }
+
+    TEST_F(RBFM_WAL_Test, checkpoints_give_back_the_log_before_the_redo_lsn) {
+        // Functions tested
+        // 1. A durable checkpoint frees the disk space of the log before its redo LSN
+        // 2. The log keeps its size and its LSNs, and the records from the redo LSN on still read back
+        // 3. The log reopens after the checkpoint and appends where it stopped
+
+        ASSERT_EQ(log.open(logFileName), success) << "Opening the log should not fail.";
+        std::vector<PeterDB::LSN> lsns;
+        ASSERT_NO_FATAL_FAILURE(appendRecords(2000, lsns));
+        PeterDB::LSN redoLsn = log.getEndLsn();
+        ASSERT_NO_FATAL_FAILURE(appendRecords(10, lsns));
+        ASSERT_EQ(log.checkpoint(redoLsn), success) << "Taking a checkpoint should not fail.";
+        PeterDB::LSN end = log.getEndLsn();
+
+        struct stat st{};
+        ASSERT_EQ(stat(logFileName.c_str(), &st), 0);
+        EXPECT_EQ((PeterDB::LSN) st.st_size, end) << "The log should keep its size.";
+        EXPECT_LT((PeterDB::LSN) st.st_blocks * 512, redoLsn / 2)
+                                    << "The log before the redo LSN should no longer take disk space.";
+
+        ASSERT_EQ(log.close(), success);
+        ASSERT_EQ(log.open(logFileName), success) << "Reopening the log should not fail.";
+        EXPECT_EQ(log.getEndLsn(), end) << "The log should append where it stopped.";
+        unsigned checkpoints;
+        PeterDB::LSN checkpointLsn, checkpointRedoLsn;
+        ASSERT_EQ(log.collectCheckpointCounterValues(checkpoints, checkpointLsn, checkpointRedoLsn), success);
+        EXPECT_EQ(checkpointRedoLsn, redoLsn);
+
+        PeterDB::LogReader reader;
+        ASSERT_EQ(reader.open(logFileName), success);
+        ASSERT_EQ(reader.load(redoLsn), success) << "Loading the log from the redo LSN should not fail.";
+        PeterDB::LogRecordHeader header{};
+        for (unsigned i = 0; i < 10; i++) {
+            ASSERT_NE(reader.next(header), nullptr);
+            EXPECT_EQ(header.lsn, lsns[2000 + i]) << "Record " << i << " after the redo LSN should read back.";
+        }
+        ASSERT_NE(reader.next(header), nullptr);
+        EXPECT_EQ(header.type, PeterDB::WAL_CHECKPOINT);
+        EXPECT_EQ(reader.next(header), nullptr);
+    }
+
+} // namespace PeterDBTesting
@@ -958,6 +958,23 @@ namespace PeterDBTesting {
 
     };
 
+    // An empty file of employee records, with a buffer for one record each way. A file left behind by another
+    // test is destroyed first, since its pages may carry LSNs of another log and its free-space map is stale.
+    class RBFM_Employee_Test : public RBFM_Test {
+    public:
+        void SetUp() override {
+            rbfm.destroyFile(fileName);
+            RBFM_Test::SetUp();
+            createRecordDescriptor(recordDescriptor);
+            nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+            inBuffer = malloc(PAGE_SIZE);
+            outBuffer = malloc(PAGE_SIZE);
+        }
+
+    protected:
+        std::vector<PeterDB::Attribute> recordDescriptor;
+    };
+
 } // namespace PeterDBTesting
 
 #endif // RBFM_TEST_UTILS_H
\ No newline at end of file